@@ -305,6 +305,50 @@ for ( ret = 0 ; !ret && !(condition) ; ) {			\
 	DRM_LOCK();						\
 }
 
+/*
+ * Poll condition for up to usec_timeout microseconds on behalf of the
+ * legacy DMA engines, which have no command completion interrupt.  The
+ * first DRM_DMA_SPIN_USECS are spent busy-waiting; after that the thread
+ * sleeps on queue a tick at a time, dropping the device lock if it holds
+ * it, and interrupt handlers can end the sleep early with DRM_WAKEUP().
+ * ret is 0 once condition holds and -EBUSY on timeout.
+ *
+ * Only meant for waits on buffer ages, which retire at frame granularity.
+ * Ring space waits sit inside BEGIN_RING and keep their microsecond spin,
+ * since a tick of latency there costs far more than the spin.
+ */
+#define DRM_DMA_SPIN_USECS	20
+
+#define DRM_DMA_WAIT_ON(ret, dev, queue, usec_timeout, condition)	\
+do {									\
+	int __spin, __ticks;						\
+									\
+	ret = -EBUSY;							\
+	for (__spin = 0; __spin < (usec_timeout); __spin++) {		\
+		if (condition) {					\
+			ret = 0;					\
+			break;						\
+		}							\
+		if (__spin == DRM_DMA_SPIN_USECS)			\
+			break;						\
+		DRM_UDELAY(1);						\
+	}								\
+	__ticks = howmany((usec_timeout) - __spin, tick);		\
+	while (ret != 0) {						\
+		if (condition) {					\
+			ret = 0;					\
+			break;						\
+		}							\
+		if (__ticks-- <= 0)					\
+			break;						\
+		if (mtx_owned(&(dev)->dev_lock))			\
+			mtx_sleep(&(queue), &(dev)->dev_lock, 0,	\
+			    "drmdma", 1);				\
+		else							\
+			pause("drmdma", 1);				\
+	}								\
+} while (0)
+
 #define DRM_ERROR(fmt, ...) \
 	printf("error: [" DRM_NAME ":pid%d:%s] *ERROR* " fmt,		\
 	    DRM_CURRENTPID, __func__ , ##__VA_ARGS__)
@@ -551,6 +595,7 @@ struct drm_driver_info {
 	int	(*unload)(struct drm_device *);
 	void	(*reclaim_buffers_locked)(struct drm_device *,
 					  struct drm_file *file_priv);
+	void	(*free_buffer)(struct drm_device *, drm_buf_t *buf);
 	int	(*dma_ioctl)(struct drm_device *dev, void *data,
 			     struct drm_file *file_priv);
 	void	(*dma_ready)(struct drm_device *);
@@ -571,6 +616,9 @@ struct drm_driver_info {
 	u32	(*get_vblank_counter)(struct drm_device *dev, int crtc);
 	int	(*enable_vblank)(struct drm_device *dev, int crtc);
 	void	(*disable_vblank)(struct drm_device *dev, int crtc);
+	int	(*sysctl_init)(struct drm_device *dev,
+			       struct sysctl_ctx_list *ctx,
+			       struct sysctl_oid *top);
 
 	drm_pci_id_list_t *id_entry;	/* PCI ID, name, and chipset private */
 
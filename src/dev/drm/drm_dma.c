@@ -98,6 +98,9 @@ void drm_free_buffer(struct drm_device *dev, drm_buf_t *buf)
 	buf->pending  = 0;
 	buf->file_priv= NULL;
 	buf->used     = 0;
+
+	if (dev->driver->free_buffer != NULL)
+		dev->driver->free_buffer(dev, buf);
 }
 
 void drm_reclaim_buffers(struct drm_device *dev, struct drm_file *file_priv)
@@ -108,6 +111,7 @@ void drm_reclaim_buffers(struct drm_device *dev, struct drm_file *file_priv)
 	if (!dma)
 		return;
 
+	DRM_SPINLOCK(&dev->dma_lock);
 	for (i = 0; i < dma->buf_count; i++) {
 		if (dma->buflist[i]->file_priv == file_priv) {
 			switch (dma->buflist[i]->list) {
@@ -123,6 +127,7 @@ void drm_reclaim_buffers(struct drm_device *dev, struct drm_file *file_priv)
 			}
 		}
 	}
+	DRM_SPINUNLOCK(&dev->dma_lock);
 }
 
 /* Call into the driver-specific DMA handler */
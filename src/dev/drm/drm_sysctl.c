@@ -108,6 +108,9 @@ int drm_sysctl_init(struct drm_device *dev)
 	    CTLFLAG_RW, &drm_debug_flag, sizeof(drm_debug_flag),
 	    "Enable debugging output");
 
+	if (dev->driver->sysctl_init != NULL)
+		dev->driver->sysctl_init(dev, &info->ctx, top);
+
 	return 0;
 }
 
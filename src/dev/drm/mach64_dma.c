@@ -973,6 +973,7 @@ static int mach64_do_dma_init(struct drm_device * dev, drm_mach64_init_t * init)
 
 	memset(dev_priv, 0, sizeof(drm_mach64_private_t));
 
+	dev_priv->dev = dev;
 	dev_priv->is_pci = init->is_pci;
 
 	dev_priv->fb_bpp = init->fb_bpp;
@@ -1585,7 +1586,7 @@ struct drm_buf *mach64_freelist_get(drm_mach64_private_t *dev_priv)
 	drm_mach64_descriptor_ring_t *ring = &dev_priv->ring;
 	drm_mach64_freelist_t *entry;
 	struct list_head *ptr;
-	int t;
+	int t, ret;
 
 	if (list_empty(&dev_priv->free_list)) {
 		if (list_empty(&dev_priv->pending)) {
@@ -1599,16 +1600,13 @@ struct drm_buf *mach64_freelist_get(drm_mach64_private_t *dev_priv)
 			return NULL;
 		}
 
-		for (t = 0; t < dev_priv->usec_timeout; t++) {
-			int ret;
-
-			ret = mach64_do_reclaim_completed(dev_priv);
-			if (ret == 0)
-				goto _freelist_entry_found;
-			if (ret < 0)
+		DRM_DMA_WAIT_ON(ret, dev_priv->dev, dev_priv->dma_queue,
+		    dev_priv->usec_timeout,
+		    (t = mach64_do_reclaim_completed(dev_priv)) <= 0);
+		if (ret == 0) {
+			if (t < 0)
 				return NULL;
-
-			DRM_UDELAY(1);
+			goto _freelist_entry_found;
 		}
 		mach64_dump_ring_info(dev_priv);
 		DRM_ERROR
@@ -76,6 +76,7 @@ typedef struct drm_mach64_descriptor_ring {
 } drm_mach64_descriptor_ring_t;
 
 typedef struct drm_mach64_private {
+	struct drm_device *dev;
 	drm_mach64_sarea_t *sarea_priv;
 
 	int is_pci;
@@ -89,6 +90,7 @@ typedef struct drm_mach64_private {
 	struct list_head free_list;	/* Free-list head */
 	struct list_head placeholders;	/* Placeholder list for buffers held by clients */
 	struct list_head pending;	/* Buffers pending completion */
+	wait_queue_head_t dma_queue;	/* Ring space and buffer waiters */
 
 	u32 frame_ofs[MACH64_MAX_QUEUED_FRAMES];	/* dword ring offsets of most recent frame swaps */
 
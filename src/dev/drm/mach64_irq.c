@@ -66,6 +66,8 @@ irqreturn_t mach64_driver_irq_handler(DRM_IRQ_ARGS)
 
 		atomic_inc(&dev_priv->vbl_received);
 		drm_handle_vblank(dev, 0);
+		/* No DMA completion interrupt; let buffer waiters recheck. */
+		DRM_WAKEUP(&dev_priv->dma_queue);
 		return IRQ_HANDLED;
 	}
 	return IRQ_NONE;
@@ -39,6 +39,9 @@ __FBSDID("$FreeBSD$");
 
 #define R128_FIFO_DEBUG		0
 
+static int r128_freelist_init(struct drm_device * dev);
+static void r128_freelist_cleanup(drm_r128_private_t * dev_priv);
+
 /* CCE microcode (from ATI) */
 static u32 r128_cce_microcode[] = {
 	0, 276838400, 0, 268449792, 2, 142, 2, 145, 0, 1076765731, 0,
@@ -361,6 +364,10 @@ static int r128_do_init_cce(struct drm_device * dev, drm_r128_init_t * init)
 
 	memset(dev_priv, 0, sizeof(drm_r128_private_t));
 
+	dev_priv->dev = dev;
+	INIT_LIST_HEAD(&dev_priv->free_list);
+	INIT_LIST_HEAD(&dev_priv->pending);
+
 	dev_priv->is_pci = init->is_pci;
 
 	if (dev_priv->is_pci && !dev->sg) {
@@ -585,6 +592,9 @@ static int r128_do_init_cce(struct drm_device * dev, drm_r128_init_t * init)
 
 	r128_do_engine_reset(dev);
 
+	/* Failure is not fatal here, r128_freelist_get() will retry. */
+	r128_freelist_init(dev);
+
 	return 0;
 }
 
@@ -619,6 +629,8 @@ int r128_do_cleanup_cce(struct drm_device * dev)
 					DRM_ERROR("failed to cleanup PCI GART!\n");
 		}
 
+		r128_freelist_cleanup(dev_priv);
+
 		drm_free(dev->dev_private, sizeof(drm_r128_private_t),
 			 DRM_MEM_DRIVER);
 		dev->dev_private = NULL;
@@ -758,7 +770,22 @@ int r128_fullscreen(struct drm_device *dev, void *data, struct drm_file *file_pr
 #define R128_BUFFER_USED	0xffffffff
 #define R128_BUFFER_FREE	0
 
-#if 0
+static void r128_freelist_cleanup(drm_r128_private_t * dev_priv)
+{
+	if (dev_priv->freelist != NULL)
+		drm_free(dev_priv->freelist,
+			 dev_priv->freelist_count * sizeof(drm_r128_freelist_t),
+			 DRM_MEM_DRIVER);
+	dev_priv->freelist = NULL;
+	dev_priv->freelist_count = 0;
+	INIT_LIST_HEAD(&dev_priv->free_list);
+	INIT_LIST_HEAD(&dev_priv->pending);
+}
+
+/* Build one list entry per DMA buffer.  Unowned buffers go on free_list,
+ * discarded ones on pending, and buffers owned by a client stay off both
+ * lists until they are discarded or their owner closes the device.
+ */
 static int r128_freelist_init(struct drm_device * dev)
 {
 	struct drm_device_dma *dma = dev->dma;
@@ -768,79 +795,131 @@ static int r128_freelist_init(struct drm_device * dev)
 	drm_r128_freelist_t *entry;
 	int i;
 
-	dev_priv->head = drm_alloc(sizeof(drm_r128_freelist_t), DRM_MEM_DRIVER);
-	if (dev_priv->head == NULL)
-		return -ENOMEM;
+	r128_freelist_cleanup(dev_priv);
+
+	if (dma == NULL || dma->buf_count == 0)
+		return 0;
 
-	memset(dev_priv->head, 0, sizeof(drm_r128_freelist_t));
-	dev_priv->head->age = R128_BUFFER_USED;
+	dev_priv->freelist = drm_calloc(dma->buf_count,
+					sizeof(drm_r128_freelist_t),
+					DRM_MEM_DRIVER);
+	if (dev_priv->freelist == NULL)
+		return -ENOMEM;
+	dev_priv->freelist_count = dma->buf_count;
 
 	for (i = 0; i < dma->buf_count; i++) {
 		buf = dma->buflist[i];
 		buf_priv = buf->dev_private;
 
-		entry = drm_alloc(sizeof(drm_r128_freelist_t), DRM_MEM_DRIVER);
-		if (!entry)
-			return -ENOMEM;
-
-		entry->age = R128_BUFFER_FREE;
+		entry = &dev_priv->freelist[i];
 		entry->buf = buf;
-		entry->prev = dev_priv->head;
-		entry->next = dev_priv->head->next;
-		if (!entry->next)
-			dev_priv->tail = entry;
-
-		buf_priv->discard = 0;
-		buf_priv->dispatched = 0;
+		INIT_LIST_HEAD(&entry->list);
 		buf_priv->list_entry = entry;
 
-		dev_priv->head->next = entry;
-
-		if (dev_priv->head->next)
-			dev_priv->head->next->prev = entry;
+		if (buf->pending)
+			list_add_tail(&entry->list, &dev_priv->pending);
+		else if (buf->file_priv == NULL)
+			list_add_tail(&entry->list, &dev_priv->free_list);
 	}
 
 	return 0;
+}
+
+/* Queue a discarded buffer behind the others waiting on the CCE.  Ages
+ * are handed out in dispatch order, so the list stays sorted.
+ */
+void r128_freelist_pending(struct drm_device * dev, struct drm_buf * buf)
+{
+	drm_r128_private_t *dev_priv = dev->dev_private;
+	drm_r128_buf_priv_t *buf_priv = buf->dev_private;
+	drm_r128_freelist_t *entry = buf_priv->list_entry;
 
+	DRM_SPINLOCK(&dev->dma_lock);
+	if (entry != NULL && dev_priv->freelist_count == dev->dma->buf_count) {
+		list_del_init(&entry->list);
+		list_add_tail(&entry->list, &dev_priv->pending);
+	}
+	DRM_SPINUNLOCK(&dev->dma_lock);
+}
+
+/* Called with dma_lock held whenever the core drops a client's ownership
+ * of a buffer, from DRM_FREE_BUFS or when the client closes.  Buffers
+ * already handed to the CCE stay on pending until they retire.
+ */
+void r128_free_buffer(struct drm_device * dev, struct drm_buf * buf)
+{
+	drm_r128_private_t *dev_priv = dev->dev_private;
+	drm_r128_buf_priv_t *buf_priv = buf->dev_private;
+	drm_r128_freelist_t *entry;
+
+	DRM_SPINLOCK_ASSERT(&dev->dma_lock);
+	if (dev_priv == NULL || buf_priv == NULL ||
+	    dev_priv->freelist_count != dev->dma->buf_count)
+		return;
+
+	entry = buf_priv->list_entry;
+	if (entry != NULL && list_empty(&entry->list))
+		list_add_tail(&entry->list, &dev_priv->free_list);
 }
-#endif
 
 static struct drm_buf *r128_freelist_get(struct drm_device * dev)
 {
 	struct drm_device_dma *dma = dev->dma;
 	drm_r128_private_t *dev_priv = dev->dev_private;
+	drm_r128_freelist_t *entry;
 	drm_r128_buf_priv_t *buf_priv;
 	struct drm_buf *buf;
-	int i, t;
+	int ret;
 
-	/* FIXME: Optimize -- use freelist code */
+	DRM_SPINLOCK(&dev->dma_lock);
+	/* Buffers may have been added since the CCE was initialized. */
+	if (dev_priv->freelist_count != dma->buf_count &&
+	    r128_freelist_init(dev) != 0) {
+		DRM_SPINUNLOCK(&dev->dma_lock);
+		return NULL;
+	}
 
-	for (i = 0; i < dma->buf_count; i++) {
-		buf = dma->buflist[i];
-		buf_priv = buf->dev_private;
-		if (buf->file_priv == 0)
-			return buf;
-	}
-
-	for (t = 0; t < dev_priv->usec_timeout; t++) {
-		u32 done_age = R128_READ(R128_LAST_DISPATCH_REG);
-
-		for (i = 0; i < dma->buf_count; i++) {
-			buf = dma->buflist[i];
-			buf_priv = buf->dev_private;
-			if (buf->pending && buf_priv->age <= done_age) {
-				/* The buffer has been processed, so it
-				 * can now be used.
-				 */
-				buf->pending = 0;
-				return buf;
-			}
-		}
-		DRM_UDELAY(1);
+	if (!list_empty(&dev_priv->free_list)) {
+		entry = list_entry(dev_priv->free_list.next,
+				   drm_r128_freelist_t, list);
+		list_del_init(&entry->list);
+		DRM_SPINUNLOCK(&dev->dma_lock);
+		return entry->buf;
 	}
 
-	DRM_DEBUG("returning NULL!\n");
-	return NULL;
+	if (list_empty(&dev_priv->pending)) {
+		DRM_SPINUNLOCK(&dev->dma_lock);
+		DRM_DEBUG("returning NULL!\n");
+		return NULL;
+	}
+
+	/* The oldest discarded buffer is the first one the CCE will retire,
+	 * so that is the only age worth waiting on.
+	 */
+	entry = list_entry(dev_priv->pending.next, drm_r128_freelist_t, list);
+	buf = entry->buf;
+	buf_priv = buf->dev_private;
+	DRM_SPINUNLOCK(&dev->dma_lock);
+
+	DRM_DMA_WAIT_ON(ret, dev, dev_priv->dma_queue, dev_priv->usec_timeout,
+	    buf_priv->age <= R128_READ(R128_LAST_DISPATCH_REG));
+	if (ret != 0) {
+		DRM_DEBUG("returning NULL!\n");
+		return NULL;
+	}
+
+	/* Someone else may have claimed the buffer while we slept. */
+	DRM_SPINLOCK(&dev->dma_lock);
+	if (list_empty(&entry->list)) {
+		DRM_SPINUNLOCK(&dev->dma_lock);
+		return NULL;
+	}
+
+	/* The buffer has been processed, so it can now be used. */
+	list_del_init(&entry->list);
+	buf->pending = 0;
+	DRM_SPINUNLOCK(&dev->dma_lock);
+	return buf;
 }
 
 void r128_freelist_reset(struct drm_device * dev)
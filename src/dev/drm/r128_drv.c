@@ -63,6 +63,7 @@ static void r128_configure(struct drm_device *dev)
 	dev->driver->irq_uninstall	= r128_driver_irq_uninstall;
 	dev->driver->irq_handler	= r128_driver_irq_handler;
 	dev->driver->dma_ioctl		= r128_cce_buffers;
+	dev->driver->free_buffer	= r128_free_buffer;
 
 	dev->driver->ioctls		= r128_ioctls;
 	dev->driver->max_ioctl		= r128_max_ioctl;
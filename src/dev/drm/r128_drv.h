@@ -59,10 +59,8 @@ __FBSDID("$FreeBSD$");
 #define GET_RING_HEAD(dev_priv)		R128_READ( R128_PM4_BUFFER_DL_RPTR )
 
 typedef struct drm_r128_freelist {
-	unsigned int age;
+	struct list_head list;	/* free_list or pending, empty while owned */
 	struct drm_buf *buf;
-	struct drm_r128_freelist *next;
-	struct drm_r128_freelist *prev;
 } drm_r128_freelist_t;
 
 typedef struct drm_r128_ring_buffer {
@@ -79,6 +77,7 @@ typedef struct drm_r128_ring_buffer {
 } drm_r128_ring_buffer_t;
 
 typedef struct drm_r128_private {
+	struct drm_device *dev;
 	drm_r128_ring_buffer_t ring;
 	drm_r128_sarea_t *sarea_priv;
 
@@ -86,8 +85,11 @@ typedef struct drm_r128_private {
 	int cce_fifo_size;
 	int cce_running;
 
-	drm_r128_freelist_t *head;
-	drm_r128_freelist_t *tail;
+	struct list_head free_list;	/* buffers nobody owns */
+	struct list_head pending;	/* discarded buffers, oldest age first */
+	drm_r128_freelist_t *freelist;	/* one entry per DMA buffer */
+	int freelist_count;
+	wait_queue_head_t dma_queue;	/* ring space and buffer waiters */
 
 	int usec_timeout;
 	int is_pci;
@@ -148,6 +150,9 @@ extern int r128_fullscreen(struct drm_device *dev, void *data, struct drm_file *
 extern int r128_cce_buffers(struct drm_device *dev, void *data, struct drm_file *file_priv);
 
 extern void r128_freelist_reset(struct drm_device * dev);
+extern void r128_freelist_pending(struct drm_device * dev,
+				  struct drm_buf * buf);
+extern void r128_free_buffer(struct drm_device * dev, struct drm_buf * buf);
 
 extern int r128_wait_ring(drm_r128_private_t * dev_priv, int n);
 
@@ -61,6 +61,8 @@ irqreturn_t r128_driver_irq_handler(DRM_IRQ_ARGS)
 		R128_WRITE(R128_GEN_INT_STATUS, R128_CRTC_VBLANK_INT_AK);
 		atomic_inc(&dev_priv->vbl_received);
 		drm_handle_vblank(dev, 0);
+		/* No CCE completion interrupt; let buffer waiters recheck. */
+		DRM_WAKEUP(&dev_priv->dma_queue);
 		return IRQ_HANDLED;
 	}
 	return IRQ_NONE;
@@ -628,6 +628,7 @@ static void r128_cce_dispatch_vertex(struct drm_device * dev, struct drm_buf * b
 		ADVANCE_RING();
 
 		buf->pending = 1;
+		r128_freelist_pending(dev, buf);
 		buf->used = 0;
 		/* FIXME: Check dispatched field */
 		buf_priv->dispatched = 0;
@@ -686,6 +687,7 @@ static void r128_cce_dispatch_indirect(struct drm_device * dev,
 		ADVANCE_RING();
 
 		buf->pending = 1;
+		r128_freelist_pending(dev, buf);
 		buf->used = 0;
 		/* FIXME: Check dispatched field */
 		buf_priv->dispatched = 0;
@@ -768,6 +770,7 @@ static void r128_cce_dispatch_indices(struct drm_device * dev,
 		ADVANCE_RING();
 
 		buf->pending = 1;
+		r128_freelist_pending(dev, buf);
 		/* FIXME: Check dispatched field */
 		buf_priv->dispatched = 0;
 	}
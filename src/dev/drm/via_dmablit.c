@@ -41,16 +41,18 @@ __FBSDID("$FreeBSD$");
 #include "dev/drm/via_drv.h"
 #include "dev/drm/via_dmablit.h"
 
+#include <sys/sbuf.h>
+
 #define VIA_PGDN(x)	(((unsigned long)(x)) & ~PAGE_MASK)
 #define VIA_PGOFF(x)	(((unsigned long)(x)) & PAGE_MASK)
 #define VIA_PFN(x)	((unsigned long)(x) >> PAGE_SHIFT)
 
-typedef struct _drm_via_descriptor {
+struct _drm_via_descriptor {
 	uint32_t mem_addr;
 	uint32_t dev_addr;
 	uint32_t size;
 	uint32_t next;
-} drm_via_descriptor_t;
+};
 
 static void via_dmablit_timer(void *arg);
 
@@ -155,35 +157,103 @@ via_map_blit_for_device(const drm_via_dmablit_t *xfer,
 }
 
 
+/*
+ * Unwire pages wired by via_wire_user_pages().
+ */
+static void
+via_unwire_user_pages(vm_page_t *pages, unsigned long num_pages)
+{
+	vm_page_t page;
+	unsigned long i;
+
+	for (i=0; i < num_pages; ++i) {
+		page = pages[i];
+		vm_page_lock(page);
+		vm_page_unwire(page, PQ_INACTIVE);
+		vm_page_unlock(page);
+	}
+}
+
+
+/*
+ * Drop a reference to a registered user buffer, unwiring its pages when
+ * the last one goes away.
+ */
+static void
+via_blit_reg_put(struct drm_device *dev, drm_via_blit_reg_t *reg)
+{
+	drm_via_private_t *dev_priv = (drm_via_private_t *)dev->dev_private;
+
+	mtx_lock(&dev_priv->blit_cache_lock);
+	if (--reg->refcount > 0) {
+		mtx_unlock(&dev_priv->blit_cache_lock);
+		return;
+	}
+	mtx_unlock(&dev_priv->blit_cache_lock);
+
+	via_unwire_user_pages(reg->pages, reg->num_pages);
+	vmspace_free(reg->vmspace);
+	free(reg->pages, DRM_MEM_DRIVER);
+
+	mtx_lock(&dev_priv->blit_cache_lock);
+	dev_priv->blit_reg_pages -= reg->num_pages;
+	mtx_unlock(&dev_priv->blit_cache_lock);
+	free(reg, DRM_MEM_DRIVER);
+}
+
+
+/*
+ * Return descriptor pages to the per-device cache, freeing those that
+ * don't fit.
+ */
+static void
+via_free_desc_pages(struct drm_device *dev, drm_via_sg_info_t *vsg)
+{
+	drm_via_private_t *dev_priv = (drm_via_private_t *)dev->dev_private;
+	int i;
+
+	mtx_lock(&dev_priv->blit_cache_lock);
+	for (i=0; i<vsg->num_desc_pages &&
+	    dev_priv->blit_desc_cached < VIA_DESC_CACHE_PAGES; ++i) {
+		if (vsg->desc_pages[i] == NULL)
+			continue;
+		dev_priv->blit_desc_cache[dev_priv->blit_desc_cached++] =
+		    vsg->desc_pages[i];
+		vsg->desc_pages[i] = NULL;
+	}
+	mtx_unlock(&dev_priv->blit_cache_lock);
+
+	for (i=0; i<vsg->num_desc_pages; ++i) {
+		if (vsg->desc_pages[i] != NULL)
+		    free(vsg->desc_pages[i], DRM_MEM_PAGES);
+	}
+	free(vsg->desc_pages, DRM_MEM_DRIVER);
+}
+
+
 /*
  * Function that frees up all resources for a blit. It is usable even if the
  * blit info has only been partially built as long as the status enum is consistent
  * with the actual status of the used resources.
  */
 static void
-via_free_sg_info(drm_via_sg_info_t *vsg)
+via_free_sg_info(struct drm_device *dev, drm_via_sg_info_t *vsg)
 {
-	vm_page_t page;
-	int i;
 
 	switch(vsg->state) {
 	case dr_via_device_mapped:
 		via_unmap_blit_from_device(vsg);
 	case dr_via_desc_pages_alloc:
-		for (i=0; i<vsg->num_desc_pages; ++i) {
-			if (vsg->desc_pages[i] != NULL)
-			    free(vsg->desc_pages[i], DRM_MEM_PAGES);
-		}
-		free(vsg->desc_pages, DRM_MEM_DRIVER);
+		via_free_desc_pages(dev, vsg);
 	case dr_via_pages_locked:
-		for (i=0; i < vsg->num_pages; ++i) {
-			page = vsg->pages[i];
-			vm_page_lock(page);
-			vm_page_unwire(page, PQ_INACTIVE);
-			vm_page_unlock(page);
-		}
+		if (vsg->reg == NULL)
+			via_unwire_user_pages(vsg->pages, vsg->num_pages);
 	case dr_via_pages_alloc:
-		free(vsg->pages, DRM_MEM_DRIVER);
+		if (vsg->reg != NULL) {
+			via_blit_reg_put(dev, vsg->reg);
+			vsg->reg = NULL;
+		} else
+			free(vsg->pages, DRM_MEM_DRIVER);
 	default:
 		vsg->state = dr_via_sg_init;
 	}
@@ -215,41 +285,148 @@ via_fire_dmablit(struct drm_device *dev, drm_via_sg_info_t *vsg, int engine)
 
 
 /*
- * Obtain a page pointer array and lock all pages into system memory. A segmentation violation will
- * occur here if the calling user does not have access to the submitted address.
+ * Fault in and wire the user pages backing a range of the current process.
  */
 static int
-via_lock_all_dma_pages(drm_via_sg_info_t *vsg,  drm_via_dmablit_t *xfer)
+via_wire_user_pages(vm_offset_t addr, unsigned long num_pages,
+    vm_page_t *pages)
 {
-	unsigned long first_pfn = VIA_PFN(xfer->mem_addr);
 #if __FreeBSD_version < 1300035
 	vm_page_t m;
-	int i;
+	unsigned long i;
 #endif
 
-	vsg->num_pages = VIA_PFN(xfer->mem_addr +
-	    (xfer->num_lines * xfer->mem_stride -1)) - first_pfn + 1;
-
-	if (NULL == (vsg->pages = malloc(sizeof(vm_page_t) * vsg->num_pages,
-	    DRM_MEM_DRIVER, M_NOWAIT)))
-		return -ENOMEM;
-
-	vsg->state = dr_via_pages_alloc;
-
 	if (vm_fault_quick_hold_pages(&curproc->p_vmspace->vm_map,
-	    (vm_offset_t)xfer->mem_addr, vsg->num_pages * PAGE_SIZE,
-	    VM_PROT_READ | VM_PROT_WRITE, vsg->pages, vsg->num_pages) < 0)
+	    addr, num_pages * PAGE_SIZE,
+	    VM_PROT_READ | VM_PROT_WRITE, pages, num_pages) < 0)
 		return -EACCES;
 
 #if __FreeBSD_version < 1300035
-	for (i = 0; i < vsg->num_pages; i++) {
-		m = vsg->pages[i];
+	for (i = 0; i < num_pages; i++) {
+		m = pages[i];
 		vm_page_lock(m);
 		vm_page_wire(m);
 		vm_page_unhold(m);
 		vm_page_unlock(m);
 	}
 #endif
+	return 0;
+}
+
+
+/*
+ * Check that a registered page is still the one mapped at va. When the
+ * blit writes system memory the mapping must also be writable: after a
+ * fork() the page is shared copy-on-write and mapped read-only, and
+ * DMA into it would be seen by the other process.
+ */
+static int
+via_check_user_page(pmap_t pmap, vm_offset_t va, vm_page_t expected,
+    int write)
+{
+	vm_page_t m;
+
+	if (!write)
+		return (pmap_extract(pmap, va) == VM_PAGE_TO_PHYS(expected));
+
+	m = pmap_extract_and_hold(pmap, va, VM_PROT_WRITE);
+	if (m == NULL)
+		return 0;
+#if __FreeBSD_version < 1300035
+	vm_page_lock(m);
+	vm_page_unhold(m);
+	vm_page_unlock(m);
+#else
+	vm_page_unwire(m, PQ_ACTIVE);
+#endif
+	return (m == expected);
+}
+
+
+/*
+ * Look for a buffer registered by this file that covers the whole blit and
+ * is still mapped at the same place in the current process. On success the
+ * blit borrows the buffer's wired pages and holds a reference to it.
+ */
+static int
+via_lookup_blit_reg(struct drm_device *dev, drm_via_sg_info_t *vsg,
+    unsigned long first_pfn, int write, struct drm_file *file_priv)
+{
+	drm_via_private_t *dev_priv = (drm_via_private_t *)dev->dev_private;
+	drm_via_file_private_t *file_via = file_priv->driver_priv;
+	struct vmspace *vm = curproc->p_vmspace;
+	drm_via_blit_reg_t *reg;
+	unsigned long i;
+
+	mtx_lock(&dev_priv->blit_cache_lock);
+	LIST_FOREACH(reg, &file_via->blit_regs, link) {
+		if (reg->vmspace == vm &&
+		    first_pfn >= reg->first_pfn &&
+		    first_pfn + vsg->num_pages <=
+		    reg->first_pfn + reg->num_pages)
+			break;
+	}
+	if (reg == NULL) {
+		mtx_unlock(&dev_priv->blit_cache_lock);
+		return 0;
+	}
+	reg->refcount++;
+	mtx_unlock(&dev_priv->blit_cache_lock);
+
+	vsg->reg = reg;
+	vsg->pages = reg->pages + (first_pfn - reg->first_pfn);
+	vsg->state = dr_via_pages_alloc;
+
+	/*
+	 * The user may have unmapped or replaced the buffer since it was
+	 * registered; only trust the wired pages while they are still the
+	 * ones mapped at that address. Otherwise fall back to faulting the
+	 * range in, which also breaks copy-on-write sharing.
+	 */
+	for (i = 0; i < vsg->num_pages; i++) {
+		if (!via_check_user_page(vmspace_pmap(vm),
+		    (first_pfn + i) << PAGE_SHIFT, vsg->pages[i], write)) {
+			via_free_sg_info(dev, vsg);
+			return 0;
+		}
+	}
+
+	vsg->state = dr_via_pages_locked;
+	return 1;
+}
+
+
+/*
+ * Obtain a page pointer array and lock all pages into system memory. A segmentation violation will
+ * occur here if the calling user does not have access to the submitted address.
+ */
+static int
+via_lock_all_dma_pages(struct drm_device *dev, drm_via_sg_info_t *vsg,
+    drm_via_dmablit_t *xfer, struct drm_file *file_priv)
+{
+	unsigned long first_pfn = VIA_PFN(xfer->mem_addr);
+	int ret;
+
+	vsg->num_pages = VIA_PFN(xfer->mem_addr +
+	    (xfer->num_lines * xfer->mem_stride -1)) - first_pfn + 1;
+
+	if (via_lookup_blit_reg(dev, vsg, first_pfn, !xfer->to_fb,
+	    file_priv)) {
+		DRM_DEBUG("DMA pages found in registered buffer\n");
+		return 0;
+	}
+
+	if (NULL == (vsg->pages = malloc(sizeof(vm_page_t) * vsg->num_pages,
+	    DRM_MEM_DRIVER, M_NOWAIT)))
+		return -ENOMEM;
+
+	vsg->state = dr_via_pages_alloc;
+
+	ret = via_wire_user_pages((vm_offset_t)xfer->mem_addr,
+	    vsg->num_pages, vsg->pages);
+	if (ret != 0)
+		return ret;
+
 	vsg->state = dr_via_pages_locked;
 
 	DRM_DEBUG("DMA pages locked\n");
@@ -264,8 +441,9 @@ via_lock_all_dma_pages(drm_via_sg_info_t *vsg,  drm_via_dmablit_t *xfer)
  * quite large for some blits, and pages don't need to be contingous.
  */
 static int
-via_alloc_desc_pages(drm_via_sg_info_t *vsg)
+via_alloc_desc_pages(struct drm_device *dev, drm_via_sg_info_t *vsg)
 {
+	drm_via_private_t *dev_priv = (drm_via_private_t *)dev->dev_private;
 	int i;
 
 	vsg->descriptors_per_page = PAGE_SIZE / sizeof(drm_via_descriptor_t);
@@ -277,7 +455,16 @@ via_alloc_desc_pages(drm_via_sg_info_t *vsg)
 		return -ENOMEM;
 
 	vsg->state = dr_via_desc_pages_alloc;
-	for (i = 0; i < vsg->num_desc_pages; ++i) {
+
+	mtx_lock(&dev_priv->blit_cache_lock);
+	for (i = 0; i < vsg->num_desc_pages &&
+	    dev_priv->blit_desc_cached > 0; ++i)
+		vsg->desc_pages[i] =
+		    dev_priv->blit_desc_cache[--dev_priv->blit_desc_cached];
+	mtx_unlock(&dev_priv->blit_cache_lock);
+	vsg->desc_cached = i;
+
+	for (; i < vsg->num_desc_pages; ++i) {
 		if (NULL == (vsg->desc_pages[i] =
 		    (drm_via_descriptor_t *)malloc(PAGE_SIZE, DRM_MEM_PAGES,
 		    M_NOWAIT | M_ZERO)))
@@ -319,6 +506,9 @@ via_dmablit_handler(struct drm_device *dev, int engine, int from_irq)
 {
 	drm_via_private_t *dev_priv = (drm_via_private_t *)dev->dev_private;
 	drm_via_blitq_t *blitq = dev_priv->blit_queues + engine;
+	drm_via_sg_info_t *vsg;
+	struct timeval now;
+	uint64_t latency;
 	int cur;
 	int done_transfer;
 	uint32_t status = 0;
@@ -335,8 +525,22 @@ via_dmablit_handler(struct drm_device *dev, int engine, int from_irq)
 	cur = blitq->cur;
 	if (done_transfer) {
 
-		blitq->blits[cur]->aborted = blitq->aborting;
+		vsg = blitq->blits[cur];
+		vsg->aborted = blitq->aborting;
 		blitq->done_blit_handle++;
+
+		microuptime(&now);
+		timevalsub(&now, &vsg->submitted);
+		latency = (uint64_t)now.tv_sec * 1000000 + now.tv_usec;
+		if (vsg->aborted) {
+			blitq->blits_aborted++;
+		} else {
+			blitq->blits_completed++;
+			blitq->bytes_completed += vsg->bytes;
+			blitq->latency_us += latency;
+			if (latency > blitq->max_latency_us)
+				blitq->max_latency_us = latency;
+		}
 		DRM_WAKEUP(&blitq->blit_queue[cur]);
 
 		cur++;
@@ -513,7 +717,7 @@ via_dmablit_workqueue(void *arg, int pending)
 
 		DRM_WAKEUP(&blitq->busy_queue);
 
-		via_free_sg_info(cur_sg);
+		via_free_sg_info(dev, cur_sg);
 		free(cur_sg, DRM_MEM_DRIVER);
 
 		mtx_lock(&blitq->blit_lock);
@@ -545,6 +749,15 @@ via_init_dmablit(struct drm_device *dev)
 		blitq->num_outstanding = 0;
 		blitq->is_active = 0;
 		blitq->aborting = 0;
+		blitq->blits_submitted = 0;
+		blitq->blits_completed = 0;
+		blitq->blits_aborted = 0;
+		blitq->bytes_completed = 0;
+		blitq->latency_us = 0;
+		blitq->max_latency_us = 0;
+		blitq->desc_cache_hits = 0;
+		blitq->desc_cache_misses = 0;
+		blitq->reg_hits = 0;
 		mtx_init(&blitq->blit_lock, "via_blit_lk", NULL, MTX_DEF);
 		for (j=0; j<VIA_NUM_BLIT_SLOTS; ++j) {
 			DRM_INIT_WAITQUEUE(blitq->blit_queue + j);
@@ -561,11 +774,12 @@ via_init_dmablit(struct drm_device *dev)
  */
 static int
 via_build_sg_info(struct drm_device *dev, drm_via_sg_info_t *vsg,
-    drm_via_dmablit_t *xfer)
+    drm_via_dmablit_t *xfer, struct drm_file *file_priv)
 {
 	int ret = 0;
 
 	vsg->bounce_buffer = NULL;
+	vsg->reg = NULL;
 
 	vsg->state = dr_via_sg_init;
 
@@ -638,19 +852,20 @@ via_build_sg_info(struct drm_device *dev, drm_via_sg_info_t *vsg,
 	}
 #endif
 
-	if (0 != (ret = via_lock_all_dma_pages(vsg, xfer))) {
+	if (0 != (ret = via_lock_all_dma_pages(dev, vsg, xfer, file_priv))) {
 		DRM_ERROR("Could not lock DMA pages.\n");
-		via_free_sg_info(vsg);
+		via_free_sg_info(dev, vsg);
 		return ret;
 	}
 
 	via_map_blit_for_device(xfer, vsg, 0);
-	if (0 != (ret = via_alloc_desc_pages(vsg))) {
+	if (0 != (ret = via_alloc_desc_pages(dev, vsg))) {
 		DRM_ERROR("Could not allocate DMA descriptor pages.\n");
-		via_free_sg_info(vsg);
+		via_free_sg_info(dev, vsg);
 		return ret;
 	}
 	via_map_blit_for_device(xfer, vsg, 1);
+	vsg->bytes = (unsigned long)xfer->num_lines * xfer->line_length;
 
 	return 0;
 }
@@ -705,7 +920,8 @@ via_dmablit_release_slot(drm_via_blitq_t *blitq)
  * Grab a free slot. Build blit info and queue a blit.
  */
 static int
-via_dmablit(struct drm_device *dev, drm_via_dmablit_t *xfer)
+via_dmablit(struct drm_device *dev, drm_via_dmablit_t *xfer,
+    struct drm_file *file_priv)
 {
 	drm_via_private_t *dev_priv = (drm_via_private_t *)dev->dev_private;
 	drm_via_sg_info_t *vsg;
@@ -728,13 +944,20 @@ via_dmablit(struct drm_device *dev, drm_via_dmablit_t *xfer)
 		via_dmablit_release_slot(blitq);
 		return -ENOMEM;
 	}
-	if (0 != (ret = via_build_sg_info(dev, vsg, xfer))) {
+	if (0 != (ret = via_build_sg_info(dev, vsg, xfer, file_priv))) {
 		via_dmablit_release_slot(blitq);
 		free(vsg, DRM_MEM_DRIVER);
 		return ret;
 	}
 	mtx_lock(&blitq->blit_lock);
 
+	microuptime(&vsg->submitted);
+	blitq->blits_submitted++;
+	blitq->desc_cache_hits += vsg->desc_cached;
+	blitq->desc_cache_misses += vsg->num_desc_pages - vsg->desc_cached;
+	if (vsg->reg != NULL)
+		blitq->reg_hits++;
+
 	blitq->blits[blitq->head++] = vsg;
 	if (blitq->head >= VIA_NUM_BLIT_SLOTS)
 		blitq->head = 0;
@@ -788,7 +1011,288 @@ via_dma_blit( struct drm_device *dev, void *data, struct drm_file *file_priv )
 	drm_via_dmablit_t *xfer = data;
 	int err;
 
-	err = via_dmablit(dev, xfer);
+	err = via_dmablit(dev, xfer, file_priv);
 
 	return err;
 }
+
+
+/*
+ * Release the buffers registered by a file. Blits still using a buffer
+ * keep it wired until they are done.
+ */
+static void
+via_release_blit_regs(struct drm_device *dev, struct drm_file *file_priv)
+{
+	drm_via_private_t *dev_priv = (drm_via_private_t *)dev->dev_private;
+	drm_via_file_private_t *file_via = file_priv->driver_priv;
+	drm_via_blit_reg_t *reg;
+
+	for (;;) {
+		mtx_lock(&dev_priv->blit_cache_lock);
+		reg = LIST_FIRST(&file_via->blit_regs);
+		if (reg == NULL) {
+			mtx_unlock(&dev_priv->blit_cache_lock);
+			return;
+		}
+		LIST_REMOVE(reg, link);
+		file_via->blit_num_regs--;
+		mtx_unlock(&dev_priv->blit_cache_lock);
+
+		via_blit_reg_put(dev, reg);
+	}
+}
+
+
+/*
+ * Wire a user buffer for later blits. A file may register at most
+ * VIA_MAX_BLIT_REGS buffers, and the pages wired by all registrations on
+ * the device are charged against VIA_MAX_BLIT_REG_PAGES before wiring.
+ */
+static int
+via_blit_register(struct drm_device *dev, drm_via_blit_register_t *args,
+    struct drm_file *file_priv)
+{
+	drm_via_private_t *dev_priv = (drm_via_private_t *)dev->dev_private;
+	drm_via_file_private_t *file_via = file_priv->driver_priv;
+	drm_via_blit_reg_t *reg;
+	unsigned long num_pages;
+	int ret;
+
+	if (args->size == 0 || args->size > VIA_MAX_BLIT_REG_SIZE)
+		return -EINVAL;
+
+	num_pages = VIA_PFN(args->mem_addr + args->size - 1) -
+	    VIA_PFN(args->mem_addr) + 1;
+
+	mtx_lock(&dev_priv->blit_cache_lock);
+	if (file_via->blit_num_regs >= VIA_MAX_BLIT_REGS) {
+		mtx_unlock(&dev_priv->blit_cache_lock);
+		return -ENOSPC;
+	}
+	if (dev_priv->blit_reg_pages + num_pages > VIA_MAX_BLIT_REG_PAGES) {
+		mtx_unlock(&dev_priv->blit_cache_lock);
+		return -ENOMEM;
+	}
+	/* Reserve both now so that racing registrations cannot overshoot. */
+	file_via->blit_num_regs++;
+	dev_priv->blit_reg_pages += num_pages;
+	mtx_unlock(&dev_priv->blit_cache_lock);
+
+	ret = -ENOMEM;
+	if (NULL == (reg = malloc(sizeof(*reg), DRM_MEM_DRIVER,
+	    M_NOWAIT | M_ZERO)))
+		goto out_unreserve;
+
+	/* Hold the vmspace so it cannot be freed and reused at the same
+	 * address while we compare against it. */
+	if (NULL == (reg->vmspace = vmspace_acquire_ref(curproc))) {
+		ret = -ESRCH;
+		goto out_free;
+	}
+	reg->first_pfn = VIA_PFN(args->mem_addr);
+	reg->num_pages = num_pages;
+	reg->refcount = 1;
+
+	if (NULL == (reg->pages = malloc(sizeof(vm_page_t) * reg->num_pages,
+	    DRM_MEM_DRIVER, M_NOWAIT)))
+		goto out_vmspace;
+
+	ret = via_wire_user_pages((vm_offset_t)VIA_PGDN(args->mem_addr),
+	    reg->num_pages, reg->pages);
+	if (ret != 0) {
+		free(reg->pages, DRM_MEM_DRIVER);
+		goto out_vmspace;
+	}
+
+	mtx_lock(&dev_priv->blit_cache_lock);
+	if (++dev_priv->blit_reg_handle == 0)
+		++dev_priv->blit_reg_handle;
+	reg->handle = dev_priv->blit_reg_handle;
+	LIST_INSERT_HEAD(&file_via->blit_regs, reg, link);
+	mtx_unlock(&dev_priv->blit_cache_lock);
+
+	args->handle = reg->handle;
+	DRM_DEBUG("Registered %lu pages for DMA blits, handle %u\n",
+	    reg->num_pages, reg->handle);
+
+	return 0;
+
+out_vmspace:
+	vmspace_free(reg->vmspace);
+out_free:
+	free(reg, DRM_MEM_DRIVER);
+out_unreserve:
+	mtx_lock(&dev_priv->blit_cache_lock);
+	file_via->blit_num_regs--;
+	dev_priv->blit_reg_pages -= num_pages;
+	mtx_unlock(&dev_priv->blit_cache_lock);
+	return ret;
+}
+
+
+static int
+via_blit_unregister(struct drm_device *dev, uint32_t handle,
+    struct drm_file *file_priv)
+{
+	drm_via_private_t *dev_priv = (drm_via_private_t *)dev->dev_private;
+	drm_via_file_private_t *file_via = file_priv->driver_priv;
+	drm_via_blit_reg_t *reg;
+
+	mtx_lock(&dev_priv->blit_cache_lock);
+	LIST_FOREACH(reg, &file_via->blit_regs, link) {
+		if (reg->handle == handle)
+			break;
+	}
+	if (reg == NULL) {
+		mtx_unlock(&dev_priv->blit_cache_lock);
+		return -EINVAL;
+	}
+	LIST_REMOVE(reg, link);
+	file_via->blit_num_regs--;
+	mtx_unlock(&dev_priv->blit_cache_lock);
+
+	via_blit_reg_put(dev, reg);
+
+	return 0;
+}
+
+
+/*
+ * Register a user buffer for repeated DMA blits, or drop such a
+ * registration.
+ */
+int
+via_dma_blit_register(struct drm_device *dev, void *data,
+    struct drm_file *file_priv)
+{
+	drm_via_blit_register_t *args = data;
+
+	switch (args->func) {
+	case VIA_BLIT_REGISTER:
+		return via_blit_register(dev, args, file_priv);
+	case VIA_BLIT_UNREGISTER:
+		return via_blit_unregister(dev, args->handle, file_priv);
+	}
+
+	return -EINVAL;
+}
+
+
+int
+via_dmablit_open(struct drm_device *dev, struct drm_file *file_priv)
+{
+	drm_via_file_private_t *file_via;
+
+	file_via = malloc(sizeof(*file_via), DRM_MEM_FILES, M_NOWAIT | M_ZERO);
+	if (file_via == NULL)
+		return -ENOMEM;
+	LIST_INIT(&file_via->blit_regs);
+	file_priv->driver_priv = file_via;
+
+	return 0;
+}
+
+
+void
+via_dmablit_preclose(struct drm_device *dev, struct drm_file *file_priv)
+{
+
+	if (dev->dev_private != NULL)
+		via_release_blit_regs(dev, file_priv);
+}
+
+
+void
+via_dmablit_postclose(struct drm_device *dev, struct drm_file *file_priv)
+{
+
+	free(file_priv->driver_priv, DRM_MEM_FILES);
+	file_priv->driver_priv = NULL;
+}
+
+
+/*
+ * Set up and tear down the per-device descriptor page cache and the count
+ * of pages wired by buffer registrations. Unlike the blit queues these
+ * live as long as the driver is loaded; the registrations themselves
+ * belong to the files and go away when they are closed.
+ */
+void
+via_dmablit_load(struct drm_device *dev)
+{
+	drm_via_private_t *dev_priv = (drm_via_private_t *)dev->dev_private;
+
+	mtx_init(&dev_priv->blit_cache_lock, "via_blit_cache", NULL, MTX_DEF);
+	dev_priv->blit_desc_cached = 0;
+	dev_priv->blit_reg_pages = 0;
+	dev_priv->blit_reg_handle = 0;
+}
+
+
+void
+via_dmablit_unload(struct drm_device *dev)
+{
+	drm_via_private_t *dev_priv = (drm_via_private_t *)dev->dev_private;
+
+	while (dev_priv->blit_desc_cached > 0)
+		free(dev_priv->blit_desc_cache[--dev_priv->blit_desc_cached],
+		    DRM_MEM_PAGES);
+	mtx_destroy(&dev_priv->blit_cache_lock);
+}
+
+
+static int
+via_dmablit_stats(SYSCTL_HANDLER_ARGS)
+{
+	struct drm_device *dev = arg1;
+	drm_via_private_t *dev_priv;
+	drm_via_blitq_t *blitq;
+	struct sbuf sb;
+	int error, i;
+
+	sbuf_new(&sb, NULL, 512, SBUF_FIXEDLEN);
+	sbuf_printf(&sb, "\neng submitted completed aborted bytes"
+	    " avg_us max_us desc_hit desc_miss reg_hit\n");
+
+	DRM_LOCK();
+	dev_priv = dev->dev_private;
+	for (i = 0; dev_priv != NULL && i < VIA_NUM_BLIT_ENGINES; i++) {
+		blitq = dev_priv->blit_queues + i;
+		sbuf_printf(&sb, "%3d %9lu %9lu %7lu %lu %ju %ju %lu %lu %lu\n",
+		    i, blitq->blits_submitted, blitq->blits_completed,
+		    blitq->blits_aborted, blitq->bytes_completed,
+		    (uintmax_t)(blitq->blits_completed != 0 ?
+		    blitq->latency_us / blitq->blits_completed : 0),
+		    (uintmax_t)blitq->max_latency_us,
+		    blitq->desc_cache_hits, blitq->desc_cache_misses,
+		    blitq->reg_hits);
+	}
+	if (dev_priv != NULL)
+		sbuf_printf(&sb, "registered pages %lu/%lu\n",
+		    dev_priv->blit_reg_pages,
+		    (unsigned long)VIA_MAX_BLIT_REG_PAGES);
+	DRM_UNLOCK();
+
+	sbuf_finish(&sb);
+	error = SYSCTL_OUT(req, sbuf_data(&sb), sbuf_len(&sb) + 1);
+	sbuf_delete(&sb);
+
+	return error;
+}
+
+
+int
+via_dmablit_sysctl_init(struct drm_device *dev, struct sysctl_ctx_list *ctx,
+    struct sysctl_oid *top)
+{
+	struct sysctl_oid *oid;
+
+	oid = SYSCTL_ADD_PROC(ctx, SYSCTL_CHILDREN(top), OID_AUTO, "blit",
+	    CTLTYPE_STRING | CTLFLAG_RD, dev, 0, via_dmablit_stats, "A",
+	    "PCI DMA blit statistics");
+	if (oid == NULL)
+		return -ENOMEM;
+
+	return 0;
+}
@@ -36,12 +36,37 @@ __FBSDID("$FreeBSD$");
 #define VIA_NUM_BLIT_ENGINES 2
 #define VIA_NUM_BLIT_SLOTS 8
 
-struct _drm_via_descriptor;
+/*
+ * Descriptor pages kept around per device for reuse by later blits, and
+ * limits on persistently registered user buffers: how many one file may
+ * have, how large each may be, and how many pages all of them together
+ * may keep wired.
+ */
+#define VIA_DESC_CACHE_PAGES 64
+#define VIA_MAX_BLIT_REGS 16
+#define VIA_MAX_BLIT_REG_SIZE (2048*2048*4)
+#define VIA_MAX_BLIT_REG_PAGES (4 * VIA_MAX_BLIT_REG_SIZE / PAGE_SIZE)
+
+typedef struct _drm_via_descriptor drm_via_descriptor_t;
+
+/*
+ * A user buffer registered with DRM_VIA_BLIT_REGISTER. Its pages stay
+ * wired until the last blit using it is done and it has been unregistered.
+ */
+typedef struct _drm_via_blit_reg {
+	LIST_ENTRY(_drm_via_blit_reg) link;
+	struct vmspace *vmspace;
+	unsigned long first_pfn;
+	unsigned long num_pages;
+	vm_page_t *pages;
+	uint32_t handle;
+	int refcount;
+} drm_via_blit_reg_t;
 
 typedef struct _drm_via_sg_info {
 	vm_page_t *pages;
 	unsigned long num_pages;
-	struct _drm_via_descriptor **desc_pages;
+	drm_via_descriptor_t **desc_pages;
 	int num_desc_pages;
 	int num_desc;
 	unsigned char *bounce_buffer;
@@ -49,6 +74,10 @@ typedef struct _drm_via_sg_info {
 	uint32_t free_on_sequence;
         unsigned int descriptors_per_page;
 	int aborted;
+	drm_via_blit_reg_t *reg;
+	int desc_cached;
+	unsigned long bytes;
+	struct timeval submitted;
 	enum {
 	        dr_via_device_mapped,
 		dr_via_desc_pages_alloc,
@@ -76,6 +105,17 @@ typedef struct _drm_via_blitq {
 	wait_queue_head_t busy_queue;
 	struct task wq;
 	struct callout poll_timer;
+
+	/* Statistics, protected by blit_lock. */
+	unsigned long blits_submitted;
+	unsigned long blits_completed;
+	unsigned long blits_aborted;
+	unsigned long bytes_completed;
+	uint64_t latency_us;
+	uint64_t max_latency_us;
+	unsigned long desc_cache_hits;
+	unsigned long desc_cache_misses;
+	unsigned long reg_hits;
 } drm_via_blitq_t;
 
 
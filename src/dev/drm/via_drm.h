@@ -81,6 +81,7 @@ __FBSDID("$FreeBSD$");
 #define DRM_VIA_WAIT_IRQ        0x0d
 #define DRM_VIA_DMA_BLIT        0x0e
 #define DRM_VIA_BLIT_SYNC       0x0f
+#define DRM_VIA_BLIT_REGISTER   0x10
 
 #define DRM_IOCTL_VIA_ALLOCMEM	  DRM_IOWR(DRM_COMMAND_BASE + DRM_VIA_ALLOCMEM, drm_via_mem_t)
 #define DRM_IOCTL_VIA_FREEMEM	  DRM_IOW( DRM_COMMAND_BASE + DRM_VIA_FREEMEM, drm_via_mem_t)
@@ -97,6 +98,8 @@ __FBSDID("$FreeBSD$");
 #define DRM_IOCTL_VIA_WAIT_IRQ    DRM_IOWR( DRM_COMMAND_BASE + DRM_VIA_WAIT_IRQ, drm_via_irqwait_t)
 #define DRM_IOCTL_VIA_DMA_BLIT    DRM_IOW(DRM_COMMAND_BASE + DRM_VIA_DMA_BLIT, drm_via_dmablit_t)
 #define DRM_IOCTL_VIA_BLIT_SYNC   DRM_IOW(DRM_COMMAND_BASE + DRM_VIA_BLIT_SYNC, drm_via_blitsync_t)
+#define DRM_IOCTL_VIA_BLIT_REGISTER DRM_IOWR(DRM_COMMAND_BASE + DRM_VIA_BLIT_REGISTER, \
+					    drm_via_blit_register_t)
 
 /* Indices into buf.Setup where various bits of state are mirrored per
  * context and per buffer.  These can be fired at the card as a unit,
@@ -276,4 +279,20 @@ typedef struct drm_via_dmablit {
 	drm_via_blitsync_t sync;
 } drm_via_dmablit_t;
 
+/*
+ * Keep a user buffer wired for DMA blits until it is unregistered or the
+ * file is closed. Blits whose system memory lies entirely within a
+ * registered buffer reuse its pages instead of wiring them again.
+ */
+
+typedef struct drm_via_blit_register {
+	enum {
+		VIA_BLIT_REGISTER = 0x01,
+		VIA_BLIT_UNREGISTER = 0x02
+	} func;
+	unsigned char *mem_addr;
+	u32 size;
+	u32 handle;
+} drm_via_blit_register_t;
+
 #endif				/* _VIA_DRM_H_ */
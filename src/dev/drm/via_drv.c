@@ -50,6 +50,9 @@ static void via_configure(struct drm_device *dev)
 	dev->driver->buf_priv_size	= sizeof(drm_via_private_t);
 	dev->driver->load		= via_driver_load;
 	dev->driver->unload		= via_driver_unload;
+	dev->driver->open		= via_dmablit_open;
+	dev->driver->preclose		= via_dmablit_preclose;
+	dev->driver->postclose		= via_dmablit_postclose;
 	dev->driver->lastclose		= via_lastclose;
 	dev->driver->get_vblank_counter	= via_get_vblank_counter;
 	dev->driver->enable_vblank	= via_enable_vblank;
@@ -59,6 +62,7 @@ static void via_configure(struct drm_device *dev)
 	dev->driver->irq_uninstall	= via_driver_irq_uninstall;
 	dev->driver->irq_handler	= via_driver_irq_handler;
 	dev->driver->dma_quiescent	= via_driver_dma_quiescent;
+	dev->driver->sysctl_init	= via_dmablit_sysctl_init;
 
 	dev->driver->ioctls		= via_ioctls;
 	dev->driver->max_ioctl		= via_max_ioctl;
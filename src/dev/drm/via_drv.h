@@ -36,8 +36,8 @@ __FBSDID("$FreeBSD$");
 #define DRIVER_DATE		"20070202"
 
 #define DRIVER_MAJOR		2
-#define DRIVER_MINOR		11
-#define DRIVER_PATCHLEVEL	1
+#define DRIVER_MINOR		12
+#define DRIVER_PATCHLEVEL	0
 
 #include "dev/drm/via_verifier.h"
 
@@ -98,9 +98,22 @@ typedef struct drm_via_private {
 	unsigned long vram_offset;
 	unsigned long agp_offset;
 	drm_via_blitq_t blit_queues[VIA_NUM_BLIT_ENGINES];
+	struct mtx blit_cache_lock;
+	drm_via_descriptor_t *blit_desc_cache[VIA_DESC_CACHE_PAGES];
+	int blit_desc_cached;
+	unsigned long blit_reg_pages;
+	uint32_t blit_reg_handle;
 	uint32_t dma_diff;
 } drm_via_private_t;
 
+/*
+ * Per open file: the user buffers it registered for DMA blits.
+ */
+typedef struct drm_via_file_private {
+	LIST_HEAD(, _drm_via_blit_reg) blit_regs;
+	int blit_num_regs;
+} drm_via_file_private_t;
+
 enum via_family {
   VIA_OTHER = 0,     /* Baseline */
   VIA_PRO_GROUP_A,   /* Another video engine and DMA commands */
@@ -127,6 +140,8 @@ extern int via_decoder_futex(struct drm_device *dev, void *data, struct drm_file
 extern int via_wait_irq(struct drm_device *dev, void *data, struct drm_file *file_priv);
 extern int via_dma_blit_sync( struct drm_device *dev, void *data, struct drm_file *file_priv );
 extern int via_dma_blit( struct drm_device *dev, void *data, struct drm_file *file_priv );
+extern int via_dma_blit_register(struct drm_device *dev, void *data,
+				 struct drm_file *file_priv);
 
 extern int via_driver_load(struct drm_device *dev, unsigned long chipset);
 extern int via_driver_unload(struct drm_device *dev);
@@ -157,5 +172,16 @@ extern void via_lastclose(struct drm_device *dev);
 
 extern void via_dmablit_handler(struct drm_device *dev, int engine, int from_irq);
 extern void via_init_dmablit(struct drm_device *dev);
+extern void via_dmablit_load(struct drm_device *dev);
+extern void via_dmablit_unload(struct drm_device *dev);
+extern int via_dmablit_open(struct drm_device *dev,
+			    struct drm_file *file_priv);
+extern void via_dmablit_preclose(struct drm_device *dev,
+				 struct drm_file *file_priv);
+extern void via_dmablit_postclose(struct drm_device *dev,
+				  struct drm_file *file_priv);
+extern int via_dmablit_sysctl_init(struct drm_device *dev,
+				   struct sysctl_ctx_list *ctx,
+				   struct sysctl_oid *top);
 
 #endif
@@ -100,7 +100,7 @@ int via_driver_load(struct drm_device *dev, unsigned long chipset)
 	drm_via_private_t *dev_priv;
 	int ret = 0;
 
-	dev_priv = drm_alloc(sizeof(drm_via_private_t), DRM_MEM_DRIVER);
+	dev_priv = drm_calloc(1, sizeof(drm_via_private_t), DRM_MEM_DRIVER);
 	if (dev_priv == NULL)
 		return -ENOMEM;
 
@@ -121,6 +121,8 @@ int via_driver_load(struct drm_device *dev, unsigned long chipset)
 		return ret;
 	}
 
+	via_dmablit_load(dev);
+
 	return 0;
 }
 
@@ -128,6 +130,7 @@ int via_driver_unload(struct drm_device *dev)
 {
 	drm_via_private_t *dev_priv = dev->dev_private;
 
+	via_dmablit_unload(dev);
 	drm_sman_takedown(&dev_priv->sman);
 
 	drm_free(dev_priv, sizeof(drm_via_private_t), DRM_MEM_DRIVER);
@@ -233,9 +233,29 @@ static hz_init_t init_table3[] = {
 	{0x00, check_number_texunits}
 };
 
-static hazard_t table1[256];
-static hazard_t table2[256];
-static hazard_t table3[256];
+/*
+ * Hazard classification of the 256 registers reachable through one
+ * HALCYON_HEADER2 parameter type. Registers that need no checking at all
+ * are also recorded in a bitmap, so that runs of them can be skipped
+ * without going through investigate_hazard().
+ */
+typedef struct {
+	hazard_t hz[256];
+	uint32_t plain[256 / 32];
+} hz_table_t;
+
+#define hz_plain(table, reg) \
+	((table)->plain[(reg) >> 5] & (1U << ((reg) & 31)))
+
+static hz_table_t table1;
+static hz_table_t table2;
+static hz_table_t table3;
+
+/*
+ * Number of dwords per vertex for the vertex format bits 7-14 of a
+ * primitive list B command, without and with multitexturing.
+ */
+static unsigned char vertex_dwords[2][256];
 
 static __inline__ int
 eat_words(const uint32_t ** buf, const uint32_t * buf_end, unsigned num_words)
@@ -557,23 +577,8 @@ via_check_prim_list(uint32_t const **buffer, const uint32_t * buf_end,
 			break;
 		}
 
-		dw_count = 0;
-		if (bcmd & (1 << 7))
-			dw_count += (cur_seq->multitex) ? 2 : 1;
-		if (bcmd & (1 << 8))
-			dw_count += (cur_seq->multitex) ? 2 : 1;
-		if (bcmd & (1 << 9))
-			dw_count++;
-		if (bcmd & (1 << 10))
-			dw_count++;
-		if (bcmd & (1 << 11))
-			dw_count++;
-		if (bcmd & (1 << 12))
-			dw_count++;
-		if (bcmd & (1 << 13))
-			dw_count++;
-		if (bcmd & (1 << 14))
-			dw_count++;
+		dw_count = vertex_dwords[cur_seq->multitex ? 1 : 0]
+		    [(bcmd >> 7) & 0xFF];
 
 		while (buf < buf_end) {
 			if (*buf == a_fire) {
@@ -625,9 +630,8 @@ via_check_header2(uint32_t const **buffer, const uint32_t * buf_end,
 {
 	uint32_t cmd;
 	int hz_mode;
-	hazard_t hz;
 	const uint32_t *buf = *buffer;
-	const hazard_t *hz_table;
+	const hz_table_t *hz_table;
 
 	if ((buf_end - buf) < 2) {
 		DRM_ERROR
@@ -644,18 +648,18 @@ via_check_header2(uint32_t const **buffer, const uint32_t * buf_end,
 		*buffer = buf;
 		return state_command;
 	case HC_ParaType_NotTex:
-		hz_table = table1;
+		hz_table = &table1;
 		break;
 	case HC_ParaType_Tex:
 		hc_state->texture = 0;
-		hz_table = table2;
+		hz_table = &table2;
 		break;
 	case (HC_ParaType_Tex | (HC_SubType_Tex1 << 8)):
 		hc_state->texture = 1;
-		hz_table = table2;
+		hz_table = &table2;
 		break;
 	case (HC_ParaType_Tex | (HC_SubType_TexGeneral << 8)):
-		hz_table = table3;
+		hz_table = &table3;
 		break;
 	case HC_ParaType_Auto:
 		if (eat_words(&buf, buf_end, 2))
@@ -692,16 +696,26 @@ via_check_header2(uint32_t const **buffer, const uint32_t * buf_end,
 
 	while (buf < buf_end) {
 		cmd = *buf++;
-		if ((hz = hz_table[cmd >> 24])) {
-			if ((hz_mode = investigate_hazard(cmd, hz, hc_state))) {
-				if (hz_mode == 1) {
-					buf--;
-					break;
-				}
+		if (hz_plain(hz_table, cmd >> 24)) {
+			/*
+			 * A plain register ends any unfinished address
+			 * sequence. After that, the rest of a run of plain
+			 * registers can be skipped in one go.
+			 */
+			if (hc_state->unfinished &&
+			    finish_current_sequence(hc_state))
 				return state_error;
+			while (buf < buf_end && hz_plain(hz_table, *buf >> 24))
+				buf++;
+			continue;
+		}
+		hz_mode = investigate_hazard(cmd, hz_table->hz[cmd >> 24],
+		    hc_state);
+		if (hz_mode) {
+			if (hz_mode == 1) {
+				buf--;
+				break;
 			}
-		} else if (hc_state->unfinished &&
-			   finish_current_sequence(hc_state)) {
 			return state_error;
 		}
 	}
@@ -1091,25 +1105,50 @@ via_parse_command_stream(struct drm_device * dev, const uint32_t * buf,
 }
 
 static void
-setup_hazard_table(hz_init_t init_table[], hazard_t table[], int size)
+setup_hazard_table(hz_init_t init_table[], hz_table_t *table, int size)
 {
+	unsigned int code;
 	int i;
 
 	for (i = 0; i < 256; ++i) {
-		table[i] = forbidden_command;
+		table->hz[i] = forbidden_command;
+	}
+	for (i = 0; i < 256 / 32; ++i) {
+		table->plain[i] = 0;
 	}
 
 	for (i = 0; i < size; ++i) {
-		table[init_table[i].code] = init_table[i].hz;
+		code = init_table[i].code;
+		table->hz[code] = init_table[i].hz;
+		if (init_table[i].hz == no_check)
+			table->plain[code >> 5] |= 1U << (code & 31);
+	}
+}
+
+static void
+setup_vertex_dwords(void)
+{
+	unsigned int fmt, bit;
+
+	for (fmt = 0; fmt < 256; ++fmt) {
+		vertex_dwords[0][fmt] = vertex_dwords[1][fmt] = 0;
+		for (bit = 0; bit < 8; ++bit) {
+			if (!(fmt & (1 << bit)))
+				continue;
+			/* Bits 7 and 8 are texture coordinates. */
+			vertex_dwords[0][fmt] += 1;
+			vertex_dwords[1][fmt] += (bit < 2) ? 2 : 1;
+		}
 	}
 }
 
 void via_init_command_verifier(void)
 {
-	setup_hazard_table(init_table1, table1,
+	setup_hazard_table(init_table1, &table1,
 			   sizeof(init_table1) / sizeof(hz_init_t));
-	setup_hazard_table(init_table2, table2,
+	setup_hazard_table(init_table2, &table2,
 			   sizeof(init_table2) / sizeof(hz_init_t));
-	setup_hazard_table(init_table3, table3,
+	setup_hazard_table(init_table3, &table3,
 			   sizeof(init_table3) / sizeof(hz_init_t));
+	setup_vertex_dwords();
 }
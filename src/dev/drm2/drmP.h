@@ -49,6 +49,7 @@ __FBSDID("$FreeBSD$");
 #include <sys/module.h>
 #include <sys/systm.h>
 #include <sys/conf.h>
+#include <sys/counter.h>
 #include <sys/sglist.h>
 #include <sys/stat.h>
 #include <sys/priv.h>
@@ -102,6 +103,7 @@ __FBSDID("$FreeBSD$");
 #include <dev/drm2/drm_atomic.h>
 #include <dev/drm2/drm_linux_list.h>
 #include <dev/drm2/drm_gem_names.h>
+#include <dev/drm2/drm_trace.h>
 
 #include <dev/drm2/drm_os_freebsd.h>
 
@@ -304,6 +306,28 @@ struct drm_ioctl_desc {
 	unsigned int cmd_drv;
 };
 
+/*
+ * Per-ioctl latency histograms, collected by drm_ioctl() when enabled
+ * through hw.dri.N.ioctl_hist.enable. Each CPU accumulates into its own
+ * slot; bucket b counts calls that took [2^(b-1), 2^b) cycles as read by
+ * get_cyclecount(), bucket 0 those that took none, and the last bucket
+ * everything longer.
+ */
+#define	DRM_IOCTL_HIST_BUCKETS	32
+/* Every ioctl number: the core KMS ioctls sit above DRM_COMMAND_END. */
+#define	DRM_IOCTL_HIST_NR	256
+
+struct drm_ioctl_hist_pcpu {
+	uint64_t	cycles[DRM_IOCTL_HIST_NR];
+	uint32_t	count[DRM_IOCTL_HIST_NR][DRM_IOCTL_HIST_BUCKETS];
+} __aligned(CACHE_LINE_SIZE);
+
+struct drm_ioctl_hist {
+	volatile u_int	enabled;
+	/* allocated on first enable, freed with the device */
+	struct drm_ioctl_hist_pcpu *pcpu;
+};
+
 /**
  * Creates a driver or general drm_ioctl_desc array entry for the given
  * ioctl, for use by drm_ioctl().
@@ -976,12 +1000,18 @@ struct drm_device {
 	/*@{ */
 	struct mtx count_lock;		/**< For inuse, drm_device::open_count, drm_device::buf_use */
 	struct sx dev_struct_lock;	/**< For others */
+	/**
+	 * Serializes the ioctls not marked DRM_UNLOCKED with each other
+	 * and with drm_open()/drm_release() of this device.  Taken after
+	 * drm_global_mutex.
+	 */
+	struct sx ioctl_lock;
 	/*@} */
 
 	/** \name Usage Counters */
 	/*@{ */
 	int open_count;			/**< Outstanding files open */
-	atomic_t ioctl_count;		/**< Outstanding IOCTLs pending */
+	counter_u64_t ioctl_count;	/**< Outstanding IOCTLs pending */
 	atomic_t vma_count;		/**< Outstanding vma areas open */
 	int buf_use;			/**< Buffers in use -- cannot alloc */
 	atomic_t buf_alloc;		/**< Buffer allocation in progress */
@@ -992,6 +1022,7 @@ struct drm_device {
 	unsigned long counters;
 	enum drm_stat_type types[15];
 	atomic_t counts[15];
+	counter_u64_t ioctl_stat;	/**< _DRM_STAT_IOCTLS, kept per-CPU */
 	/*@} */
 
 	struct list_head filelist;
@@ -1043,6 +1074,7 @@ struct drm_device {
 
 	atomic_t *_vblank_count;        /**< number of VBLANK interrupts (driver must alloc the right number of counters) */
 	struct timeval *_vblank_time;   /**< timestamp of current vblank_count (drivers must alloc right number of fields) */
+	atomic_t *_vblank_seq;          /**< per-crtc seqcount, odd while _vblank_count/_vblank_time are being updated */
 	struct mtx vblank_time_lock;    /**< Protects vblank count and time updates during vblank enable/disable */
 	struct mtx vbl_lock;
 	atomic_t *vblank_refcount;      /* number of users of vblank interruptsper crtc */
@@ -1057,9 +1089,12 @@ struct drm_device {
 	u32 max_vblank_count;           /**< size of vblank counter register */
 
 	/**
-	 * List of events
+	 * Per-crtc lists of pending vblank events, sorted by target
+	 * sequence, and their statistics.  Protected by event_lock.
 	 */
-	struct list_head vblank_event_list;
+	struct list_head *vblank_event_list;
+	u_int *vblank_event_pending;	/* number of events queued per crtc */
+	u_long *vblank_event_delivered;	/* number of events sent per crtc */
 	struct mtx event_lock;
 
 	/*@} */
@@ -1122,6 +1157,9 @@ struct drm_device {
 	struct drm_sysctl_info *sysctl;
 	int		  sysctl_node_idx;
 
+	struct drm_trace  trace;	/* Command submission trace */
+	struct drm_ioctl_hist ioctl_hist; /* Per-ioctl latency histograms */
+
 	void		  *drm_ttm_bdev;
 
 	void *sysctl_private;
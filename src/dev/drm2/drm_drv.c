@@ -50,6 +50,7 @@
 __FBSDID("$FreeBSD$");
 
 #include <sys/sysent.h>
+#include <machine/cpu.h>
 
 #include <dev/drm2/drmP.h>
 #include <dev/drm2/drm_core.h>
@@ -70,8 +71,8 @@ static struct drm_ioctl_desc drm_ioctls[] = {
 	DRM_IOCTL_DEF(DRM_IOCTL_SET_VERSION, drm_setversion, DRM_MASTER),
 
 	DRM_IOCTL_DEF(DRM_IOCTL_SET_UNIQUE, drm_setunique, DRM_AUTH|DRM_MASTER|DRM_ROOT_ONLY),
-	DRM_IOCTL_DEF(DRM_IOCTL_BLOCK, drm_noop, DRM_AUTH|DRM_MASTER|DRM_ROOT_ONLY),
-	DRM_IOCTL_DEF(DRM_IOCTL_UNBLOCK, drm_noop, DRM_AUTH|DRM_MASTER|DRM_ROOT_ONLY),
+	DRM_IOCTL_DEF(DRM_IOCTL_BLOCK, drm_noop, DRM_AUTH|DRM_MASTER|DRM_ROOT_ONLY|DRM_UNLOCKED),
+	DRM_IOCTL_DEF(DRM_IOCTL_UNBLOCK, drm_noop, DRM_AUTH|DRM_MASTER|DRM_ROOT_ONLY|DRM_UNLOCKED),
 	DRM_IOCTL_DEF(DRM_IOCTL_AUTH_MAGIC, drm_authmagic, DRM_AUTH|DRM_MASTER),
 
 	DRM_IOCTL_DEF(DRM_IOCTL_ADD_MAP, drm_addmap_ioctl, DRM_AUTH|DRM_MASTER|DRM_ROOT_ONLY),
@@ -91,13 +92,13 @@ static struct drm_ioctl_desc drm_ioctls[] = {
 	DRM_IOCTL_DEF(DRM_IOCTL_NEW_CTX, drm_newctx, DRM_AUTH|DRM_MASTER|DRM_ROOT_ONLY),
 	DRM_IOCTL_DEF(DRM_IOCTL_RES_CTX, drm_resctx, DRM_AUTH),
 
-	DRM_IOCTL_DEF(DRM_IOCTL_ADD_DRAW, drm_noop, DRM_AUTH|DRM_MASTER|DRM_ROOT_ONLY),
-	DRM_IOCTL_DEF(DRM_IOCTL_RM_DRAW, drm_noop, DRM_AUTH|DRM_MASTER|DRM_ROOT_ONLY),
+	DRM_IOCTL_DEF(DRM_IOCTL_ADD_DRAW, drm_noop, DRM_AUTH|DRM_MASTER|DRM_ROOT_ONLY|DRM_UNLOCKED),
+	DRM_IOCTL_DEF(DRM_IOCTL_RM_DRAW, drm_noop, DRM_AUTH|DRM_MASTER|DRM_ROOT_ONLY|DRM_UNLOCKED),
 
 	DRM_IOCTL_DEF(DRM_IOCTL_LOCK, drm_lock, DRM_AUTH),
 	DRM_IOCTL_DEF(DRM_IOCTL_UNLOCK, drm_unlock, DRM_AUTH),
 
-	DRM_IOCTL_DEF(DRM_IOCTL_FINISH, drm_noop, DRM_AUTH),
+	DRM_IOCTL_DEF(DRM_IOCTL_FINISH, drm_noop, DRM_AUTH|DRM_UNLOCKED),
 
 	DRM_IOCTL_DEF(DRM_IOCTL_ADD_BUFS, drm_addbufs, DRM_AUTH|DRM_MASTER|DRM_ROOT_ONLY),
 	DRM_IOCTL_DEF(DRM_IOCTL_MARK_BUFS, drm_markbufs, DRM_AUTH|DRM_MASTER|DRM_ROOT_ONLY),
@@ -127,7 +128,7 @@ static struct drm_ioctl_desc drm_ioctls[] = {
 
 	DRM_IOCTL_DEF(DRM_IOCTL_MODESET_CTL, drm_modeset_ctl, 0),
 
-	DRM_IOCTL_DEF(DRM_IOCTL_UPDATE_DRAW, drm_noop, DRM_AUTH|DRM_MASTER|DRM_ROOT_ONLY),
+	DRM_IOCTL_DEF(DRM_IOCTL_UPDATE_DRAW, drm_noop, DRM_AUTH|DRM_MASTER|DRM_ROOT_ONLY|DRM_UNLOCKED),
 
 	DRM_IOCTL_DEF(DRM_IOCTL_GEM_CLOSE, drm_gem_close_ioctl, DRM_UNLOCKED),
 	DRM_IOCTL_DEF(DRM_IOCTL_GEM_FLINK, drm_gem_flink_ioctl, DRM_AUTH|DRM_UNLOCKED),
@@ -342,6 +343,25 @@ int drm_version(struct drm_device *dev, void *data,
 	return err;
 }
 
+static void
+drm_ioctl_hist_record(struct drm_ioctl_hist *hist, unsigned int nr,
+    uint64_t cycles)
+{
+	struct drm_ioctl_hist_pcpu *pc;
+	int b;
+
+	if (nr >= DRM_IOCTL_HIST_NR)
+		return;
+	/* The array is allocated before the histograms are first enabled. */
+	atomic_thread_fence_acq();
+	b = min(flsll(cycles), DRM_IOCTL_HIST_BUCKETS - 1);
+	critical_enter();
+	pc = &hist->pcpu[curcpu];
+	pc->cycles[nr] += cycles;
+	pc->count[nr][b]++;
+	critical_exit();
+}
+
 /**
  * Called whenever a process performs an ioctl on /dev/drm.
  *
@@ -362,6 +382,7 @@ int drm_ioctl(struct cdev *kdev, u_long cmd, caddr_t data, int flags,
 	struct drm_ioctl_desc *ioctl;
 	drm_ioctl_t *func;
 	unsigned int nr = DRM_IOCTL_NR(cmd);
+	uint64_t start;
 	int retcode;
 
 	dev = drm_get_device_from_kdev(kdev);
@@ -374,8 +395,8 @@ int drm_ioctl(struct cdev *kdev, u_long cmd, caddr_t data, int flags,
 
 	retcode = -EINVAL;
 
-	atomic_inc(&dev->ioctl_count);
-	atomic_inc(&dev->counts[_DRM_STAT_IOCTLS]);
+	counter_u64_add(dev->ioctl_count, 1);
+	counter_u64_add(dev->ioctl_stat, 1);
 	++file_priv->ioctl_count;
 
 	DRM_DEBUG("pid=%d, cmd=0x%02lx, nr=0x%02x, dev 0x%lx, auth=%d\n",
@@ -386,21 +407,21 @@ int drm_ioctl(struct cdev *kdev, u_long cmd, caddr_t data, int flags,
 	switch (cmd) {
 	case FIONBIO:
 	case FIOASYNC:
-		atomic_dec(&dev->ioctl_count);
+		counter_u64_add(dev->ioctl_count, -1);
 		return 0;
 
 	case FIOSETOWN:
-		atomic_dec(&dev->ioctl_count);
+		counter_u64_add(dev->ioctl_count, -1);
 		return fsetown(*(int *)data, &file_priv->minor->buf_sigio);
 
 	case FIOGETOWN:
-		atomic_dec(&dev->ioctl_count);
+		counter_u64_add(dev->ioctl_count, -1);
 		*(int *) data = fgetown(&file_priv->minor->buf_sigio);
 		return 0;
 	}
 
 	if (IOCGROUP(cmd) != DRM_IOCTL_BASE) {
-		atomic_dec(&dev->ioctl_count);
+		counter_u64_add(dev->ioctl_count, -1);
 		DRM_DEBUG("Bad ioctl group 0x%x\n", (int)IOCGROUP(cmd));
 		return EINVAL;
 	}
@@ -463,17 +484,22 @@ int drm_ioctl(struct cdev *kdev, u_long cmd, caddr_t data, int flags,
 		   (!(ioctl->flags & DRM_CONTROL_ALLOW) && (file_priv->minor->type == DRM_MINOR_CONTROL))) {
 		retcode = -EACCES;
 	} else {
+		start = __predict_false(dev->ioctl_hist.enabled) ?
+		    get_cyclecount() : 0;
 		if (ioctl->flags & DRM_UNLOCKED)
 			retcode = func(dev, data, file_priv);
 		else {
-			sx_xlock(&drm_global_mutex);
+			sx_xlock(&dev->ioctl_lock);
 			retcode = func(dev, data, file_priv);
-			sx_xunlock(&drm_global_mutex);
+			sx_xunlock(&dev->ioctl_lock);
 		}
+		if (__predict_false(start != 0))
+			drm_ioctl_hist_record(&dev->ioctl_hist, nr,
+			    get_cyclecount() - start);
 	}
 
       err_i1:
-	atomic_dec(&dev->ioctl_count);
+	counter_u64_add(dev->ioctl_count, -1);
 	if (retcode == -ERESTARTSYS) {
 		/*
 		 * FIXME: Find where in i915 ERESTARTSYS should be
@@ -53,7 +53,7 @@ static int drm_setup(struct drm_device * dev)
 			return ret;
 	}
 
-	atomic_set(&dev->ioctl_count, 0);
+	counter_u64_zero(dev->ioctl_count);
 	atomic_set(&dev->vma_count, 0);
 
 	if (drm_core_check_feature(dev, DRIVER_HAVE_DMA) &&
@@ -134,6 +134,7 @@ int drm_open(struct cdev *kdev, int flags, int fmt, DRM_STRUCTPROC *p)
 		return ENODEV;
 
 	sx_xlock(&drm_global_mutex);
+	sx_xlock(&dev->ioctl_lock);
 
 	/*
 	 * FIXME Linux<->FreeBSD: On Linux, counter updated outside
@@ -144,6 +145,7 @@ int drm_open(struct cdev *kdev, int flags, int fmt, DRM_STRUCTPROC *p)
 
 	retcode = drm_open_helper(kdev, flags, fmt, p, dev);
 	if (retcode) {
+		sx_xunlock(&dev->ioctl_lock);
 		sx_xunlock(&drm_global_mutex);
 		return (-retcode);
 	}
@@ -153,6 +155,7 @@ int drm_open(struct cdev *kdev, int flags, int fmt, DRM_STRUCTPROC *p)
 		if (retcode)
 			goto err_undo;
 	}
+	sx_xunlock(&dev->ioctl_lock);
 	sx_xunlock(&drm_global_mutex);
 	return 0;
 
@@ -161,6 +164,7 @@ err_undo:
 	device_unbusy(dev->dev);
 	mtx_unlock(&Giant);
 	dev->open_count--;
+	sx_xunlock(&dev->ioctl_lock);
 	sx_xunlock(&drm_global_mutex);
 	return -retcode;
 }
@@ -304,16 +308,21 @@ static void drm_events_release(struct drm_file *file_priv)
 	struct drm_pending_event *e, *et;
 	struct drm_pending_vblank_event *v, *vt;
 	unsigned long flags;
+	int i;
 
 	DRM_SPINLOCK_IRQSAVE(&dev->event_lock, flags);
 
 	/* Remove pending flips */
-	list_for_each_entry_safe(v, vt, &dev->vblank_event_list, base.link)
-		if (v->base.file_priv == file_priv) {
-			list_del(&v->base.link);
-			drm_vblank_put(dev, v->pipe);
-			v->base.destroy(&v->base);
-		}
+	for (i = 0; i < dev->num_crtcs; i++) {
+		list_for_each_entry_safe(v, vt, &dev->vblank_event_list[i],
+		    base.link)
+			if (v->base.file_priv == file_priv) {
+				list_del(&v->base.link);
+				dev->vblank_event_pending[i]--;
+				drm_vblank_put(dev, v->pipe);
+				v->base.destroy(&v->base);
+			}
+	}
 
 	/* Remove unconsumed events */
 	list_for_each_entry_safe(e, et, &file_priv->event_list, link)
@@ -340,6 +349,7 @@ void drm_release(void *data)
 	struct drm_device *dev = file_priv->minor->dev;
 
 	sx_xlock(&drm_global_mutex);
+	sx_xlock(&dev->ioctl_lock);
 
 	DRM_DEBUG("open_count = %d\n", dev->open_count);
 
@@ -356,7 +366,7 @@ void drm_release(void *data)
 		  dev->open_count);
 
 	/* Release any auth tokens that might point to this file_priv,
-	   (do that under the drm_global_mutex) */
+	   (do that under the drm_device::ioctl_lock) */
 	if (file_priv->magic)
 		(void) drm_remove_magic(file_priv->master, file_priv->magic);
 
@@ -457,12 +467,13 @@ void drm_release(void *data)
 	device_unbusy(dev->dev);
 	mtx_unlock(&Giant);
 	if (!--dev->open_count) {
-		if (atomic_read(&dev->ioctl_count)) {
-			DRM_ERROR("Device busy: %d\n",
-				  atomic_read(&dev->ioctl_count));
+		if (counter_u64_fetch(dev->ioctl_count) != 0) {
+			DRM_ERROR("Device busy: %jd\n",
+			    (intmax_t)counter_u64_fetch(dev->ioctl_count));
 		} else
 			drm_lastclose(dev);
 	}
+	sx_xunlock(&dev->ioctl_lock);
 	sx_xunlock(&drm_global_mutex);
 }
 EXPORT_SYMBOL(drm_release);
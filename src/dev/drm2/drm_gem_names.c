@@ -37,119 +37,228 @@ __FBSDID("$FreeBSD$");
 #include <sys/kernel.h>
 #include <sys/limits.h>
 #include <sys/malloc.h>
+#include <sys/rwlock.h>
 
 #include <dev/drm2/drm_gem_names.h>
 
 MALLOC_DEFINE(M_GEM_NAMES, "gem_name", "Hash headers for the gem names");
 
+#define	DRM_GEM_NAMES_STRIPE_SHIFT	4	/* log2(DRM_GEM_NAMES_STRIPES) */
+#define	DRM_GEM_NAMES_INIT_SIZE		16
+#define	DRM_GEM_NAMES_REHASH_STEP	8
+
+CTASSERT((1 << DRM_GEM_NAMES_STRIPE_SHIFT) == DRM_GEM_NAMES_STRIPES);
+
 static void drm_gem_names_delete_name(struct drm_gem_names *names,
-    struct drm_gem_name *np);
+    struct drm_gem_names_stripe *st, struct drm_gem_name *np);
+
+static struct drm_gem_names_stripe *
+gem_name_stripe(struct drm_gem_names *names, uint32_t name)
+{
+
+	return (&names->stripes[name & (DRM_GEM_NAMES_STRIPES - 1)]);
+}
+
+static struct drm_gem_names_head *
+gem_name_hash_index(struct drm_gem_names_head *hash, u_long mask,
+    uint32_t name)
+{
+
+	return (&hash[(name >> DRM_GEM_NAMES_STRIPE_SHIFT) & mask]);
+}
+
+static struct drm_gem_name *
+gem_name_lookup(struct drm_gem_names_stripe *st, uint32_t name)
+{
+	struct drm_gem_name *n;
+
+	rw_assert(&st->lock, RA_LOCKED);
+	LIST_FOREACH(n, gem_name_hash_index(st->names_hash, st->hash_mask,
+	    name), link) {
+		if (n->name == name)
+			return (n);
+	}
+	if (st->old_hash == NULL)
+		return (NULL);
+	LIST_FOREACH(n, gem_name_hash_index(st->old_hash, st->old_hash_mask,
+	    name), link) {
+		if (n->name == name)
+			return (n);
+	}
+	return (NULL);
+}
+
+/*
+ * Move up to count buckets of the old table into the current one, and
+ * release the old table once it is drained.
+ */
+static void
+gem_name_rehash_step(struct drm_gem_names_stripe *st, u_long count)
+{
+	struct drm_gem_name *np;
+
+	rw_assert(&st->lock, RA_WLOCKED);
+	if (st->old_hash == NULL || st->iterating != 0)
+		return;
+	for (; count > 0 && st->old_hash_pos <= st->old_hash_mask; count--) {
+		while ((np = LIST_FIRST(&st->old_hash[st->old_hash_pos])) !=
+		    NULL) {
+			LIST_REMOVE(np, link);
+			LIST_INSERT_HEAD(gem_name_hash_index(st->names_hash,
+			    st->hash_mask, np->name), np, link);
+		}
+		st->old_hash_pos++;
+	}
+	if (st->old_hash_pos > st->old_hash_mask) {
+		free(st->old_hash, M_GEM_NAMES);
+		st->old_hash = NULL;
+	}
+}
+
+/*
+ * Start doubling the table once the average chain grows past two
+ * entries.  Failing to allocate the new table only costs longer chains.
+ */
+static void
+gem_name_grow(struct drm_gem_names_stripe *st)
+{
+	struct drm_gem_names_head *hash;
+	u_long i, size;
+
+	rw_assert(&st->lock, RA_WLOCKED);
+	if (st->old_hash != NULL || st->iterating != 0 ||
+	    st->count <= 2 * (st->hash_mask + 1))
+		return;
+	size = 2 * (st->hash_mask + 1);
+	hash = malloc(size * sizeof(*hash), M_GEM_NAMES, M_NOWAIT);
+	if (hash == NULL)
+		return;
+	for (i = 0; i < size; i++)
+		LIST_INIT(&hash[i]);
+	st->old_hash = st->names_hash;
+	st->old_hash_mask = st->hash_mask;
+	st->old_hash_pos = 0;
+	st->names_hash = hash;
+	st->hash_mask = size - 1;
+}
 
 void
 drm_gem_names_init(struct drm_gem_names *names)
 {
+	struct drm_gem_names_stripe *st;
+	int i;
 
-	names->unr = new_unrhdr(1, INT_MAX, NULL); /* XXXKIB */
-	names->names_hash = hashinit(1000 /* XXXKIB */, M_GEM_NAMES,
-	    &names->hash_mask);
-	mtx_init(&names->lock, "drmnames", NULL, MTX_DEF);
+	mtx_init(&names->unr_lock, "drmnamesunr", NULL, MTX_DEF);
+	names->unr = new_unrhdr(1, INT_MAX, &names->unr_lock); /* XXXKIB */
+	for (i = 0; i < DRM_GEM_NAMES_STRIPES; i++) {
+		st = &names->stripes[i];
+		st->names_hash = hashinit(DRM_GEM_NAMES_INIT_SIZE,
+		    M_GEM_NAMES, &st->hash_mask);
+		st->old_hash = NULL;
+		st->count = 0;
+		st->iterating = 0;
+		rw_init(&st->lock, "drmnames");
+	}
 }
 
 void
 drm_gem_names_fini(struct drm_gem_names *names)
 {
+	struct drm_gem_names_stripe *st;
 	struct drm_gem_name *np;
 	int i;
+	u_long j;
 
-	mtx_lock(&names->lock);
-	for (i = 0; i <= names->hash_mask; i++) {
-		while ((np = LIST_FIRST(&names->names_hash[i])) != NULL) {
-			drm_gem_names_delete_name(names, np);
-			mtx_lock(&names->lock);
+	for (i = 0; i < DRM_GEM_NAMES_STRIPES; i++) {
+		st = &names->stripes[i];
+		rw_wlock(&st->lock);
+		gem_name_rehash_step(st, ULONG_MAX);
+		for (j = 0; j <= st->hash_mask; j++) {
+			while ((np = LIST_FIRST(&st->names_hash[j])) != NULL) {
+				drm_gem_names_delete_name(names, st, np);
+				rw_wlock(&st->lock);
+			}
 		}
+		rw_wunlock(&st->lock);
+		rw_destroy(&st->lock);
+		hashdestroy(st->names_hash, M_GEM_NAMES, st->hash_mask);
 	}
-	mtx_unlock(&names->lock);
-	mtx_destroy(&names->lock);
-	hashdestroy(names->names_hash, M_GEM_NAMES, names->hash_mask);
 	delete_unrhdr(names->unr);
+	mtx_destroy(&names->unr_lock);
 }
 
-static struct drm_gem_names_head *
-gem_name_hash_index(struct drm_gem_names *names, int name)
-{
-
-	return (&names->names_hash[name & names->hash_mask]);
-}
-
+/*
+ * Lookups only read the stripe, so they run under the read side of the
+ * stripe lock and do not help the rehash along; updates do that.
+ */
 void *
 drm_gem_name_ref(struct drm_gem_names *names, uint32_t name,
     void (*ref)(void *))
 {
+	struct drm_gem_names_stripe *st;
 	struct drm_gem_name *n;
+	void *res;
 
-	mtx_lock(&names->lock);
-	LIST_FOREACH(n, gem_name_hash_index(names, name), link) {
-		if (n->name == name) {
-			if (ref != NULL)
-				ref(n->ptr);
-			mtx_unlock(&names->lock);
-			return (n->ptr);
-		}
+	st = gem_name_stripe(names, name);
+	rw_rlock(&st->lock);
+	n = gem_name_lookup(st, name);
+	if (n == NULL) {
+		rw_runlock(&st->lock);
+		return (NULL);
 	}
-	mtx_unlock(&names->lock);
-	return (NULL);
+	res = n->ptr;
+	if (ref != NULL)
+		ref(res);
+	rw_runlock(&st->lock);
+	return (res);
 }
 
-struct drm_gem_ptr_match_arg {
-	uint32_t res;
-	void *ptr;
-};
-
-static int
-drm_gem_ptr_match(uint32_t name, void *ptr, void *arg)
+static uint32_t
+gem_name_find_ptr(struct drm_gem_names_head *hash, u_long mask, void *ptr)
 {
-	struct drm_gem_ptr_match_arg *a;
-
-	a = arg;
-	if (ptr == a->ptr) {
-		a->res = name;
-		return (1);
-	} else
-		return (0);
+	struct drm_gem_name *np;
+	u_long j;
+
+	for (j = 0; j <= mask; j++) {
+		LIST_FOREACH(np, &hash[j], link) {
+			if (np->name != -1 && np->ptr == ptr)
+				return (np->name);
+		}
+	}
+	return (0);
 }
 
 uint32_t
 drm_gem_find_name(struct drm_gem_names *names, void *ptr)
 {
-	struct drm_gem_ptr_match_arg arg;
+	struct drm_gem_names_stripe *st;
+	uint32_t res;
+	int i;
 
-	arg.res = 0;
-	arg.ptr = ptr;
-	drm_gem_names_foreach(names, drm_gem_ptr_match, &arg);
-	return (arg.res);
+	res = 0;
+	for (i = 0; i < DRM_GEM_NAMES_STRIPES && res == 0; i++) {
+		st = &names->stripes[i];
+		rw_rlock(&st->lock);
+		res = gem_name_find_ptr(st->names_hash, st->hash_mask, ptr);
+		if (res == 0 && st->old_hash != NULL)
+			res = gem_name_find_ptr(st->old_hash,
+			    st->old_hash_mask, ptr);
+		rw_runlock(&st->lock);
+	}
+	return (res);
 }
 
 void *
 drm_gem_find_ptr(struct drm_gem_names *names, uint32_t name)
 {
-	struct drm_gem_name *n;
-	void *res;
 
-	mtx_lock(&names->lock);
-	LIST_FOREACH(n, gem_name_hash_index(names, name), link) {
-		if (n->name == name) {
-			res = n->ptr;
-			mtx_unlock(&names->lock);
-			return (res);
-		}
-	}
-	mtx_unlock(&names->lock);
-	return (NULL);
+	return (drm_gem_name_ref(names, name, NULL));
 }
 
 int
 drm_gem_name_create(struct drm_gem_names *names, void *p, uint32_t *name)
 {
+	struct drm_gem_names_stripe *st;
 	struct drm_gem_name *np;
 
 	if (*name != 0) {
@@ -157,27 +266,33 @@ drm_gem_name_create(struct drm_gem_names *names, void *p, uint32_t *name)
 	}
 
 	np = malloc(sizeof(struct drm_gem_name), M_GEM_NAMES, M_WAITOK);
-	mtx_lock(&names->lock);
 	np->name = alloc_unr(names->unr);
 	if (np->name == -1) {
-		mtx_unlock(&names->lock);
 		free(np, M_GEM_NAMES);
 		return (-ENOMEM);
 	}
-	*name = np->name;
 	np->ptr = p;
-	LIST_INSERT_HEAD(gem_name_hash_index(names, np->name), np, link);
-	mtx_unlock(&names->lock);
+	st = gem_name_stripe(names, np->name);
+	rw_wlock(&st->lock);
+	*name = np->name;
+	LIST_INSERT_HEAD(gem_name_hash_index(st->names_hash, st->hash_mask,
+	    np->name), np, link);
+	st->count++;
+	gem_name_rehash_step(st, DRM_GEM_NAMES_REHASH_STEP);
+	gem_name_grow(st);
+	rw_wunlock(&st->lock);
 	return (0);
 }
 
 static void
-drm_gem_names_delete_name(struct drm_gem_names *names, struct drm_gem_name *np)
+drm_gem_names_delete_name(struct drm_gem_names *names,
+    struct drm_gem_names_stripe *st, struct drm_gem_name *np)
 {
 
-	mtx_assert(&names->lock, MA_OWNED);
+	rw_assert(&st->lock, RA_WLOCKED);
 	LIST_REMOVE(np, link);
-	mtx_unlock(&names->lock);
+	st->count--;
+	rw_wunlock(&st->lock);
 	free_unr(names->unr, np->name);
 	free(np, M_GEM_NAMES);
 }
@@ -185,47 +300,62 @@ drm_gem_names_delete_name(struct drm_gem_names *names, struct drm_gem_name *np)
 void *
 drm_gem_names_remove(struct drm_gem_names *names, uint32_t name)
 {
+	struct drm_gem_names_stripe *st;
 	struct drm_gem_name *n;
 	void *res;
 
-	mtx_lock(&names->lock);
-	LIST_FOREACH(n, gem_name_hash_index(names, name), link) {
-		if (n->name == name) {
-			res = n->ptr;
-			drm_gem_names_delete_name(names, n);
-			return (res);
-		}
+	st = gem_name_stripe(names, name);
+	rw_wlock(&st->lock);
+	gem_name_rehash_step(st, DRM_GEM_NAMES_REHASH_STEP);
+	n = gem_name_lookup(st, name);
+	if (n == NULL) {
+		rw_wunlock(&st->lock);
+		return (NULL);
 	}
-	mtx_unlock(&names->lock);
-	return (NULL);
+	res = n->ptr;
+	drm_gem_names_delete_name(names, st, n);
+	return (res);
 }
 
 void
 drm_gem_names_foreach(struct drm_gem_names *names,
     int (*f)(uint32_t, void *, void *), void *arg)
 {
+	struct drm_gem_names_stripe *st;
 	struct drm_gem_name *np;
 	struct drm_gem_name marker;
 	int i, fres;
+	u_long j;
 
 	bzero(&marker, sizeof(marker));
 	marker.name = -1;
-	mtx_lock(&names->lock);
-	for (i = 0; i <= names->hash_mask; i++) {
-		for (np = LIST_FIRST(&names->names_hash[i]); np != NULL; ) {
-			if (np->name == -1) {
-				np = LIST_NEXT(np, link);
-				continue;
+	fres = 0;
+	for (i = 0; i < DRM_GEM_NAMES_STRIPES && !fres; i++) {
+		st = &names->stripes[i];
+		rw_wlock(&st->lock);
+		/*
+		 * The marker must stay in place while the lock is dropped,
+		 * so finish any pending migration and hold off new ones.
+		 */
+		gem_name_rehash_step(st, ULONG_MAX);
+		st->iterating++;
+		for (j = 0; j <= st->hash_mask && !fres; j++) {
+			for (np = LIST_FIRST(&st->names_hash[j]); np != NULL; ) {
+				if (np->name == -1) {
+					np = LIST_NEXT(np, link);
+					continue;
+				}
+				LIST_INSERT_AFTER(np, &marker, link);
+				rw_wunlock(&st->lock);
+				fres = f(np->name, np->ptr, arg);
+				rw_wlock(&st->lock);
+				np = LIST_NEXT(&marker, link);
+				LIST_REMOVE(&marker, link);
+				if (fres)
+					break;
 			}
-			LIST_INSERT_AFTER(np, &marker, link);
-			mtx_unlock(&names->lock);
-			fres = f(np->name, np->ptr, arg);
-			mtx_lock(&names->lock);
-			np = LIST_NEXT(&marker, link);
-			LIST_REMOVE(&marker, link);
-			if (fres)
-				break;
 		}
+		st->iterating--;
+		rw_wunlock(&st->lock);
 	}
-	mtx_unlock(&names->lock);
 }
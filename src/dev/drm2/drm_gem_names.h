@@ -35,10 +35,11 @@
 #ifndef DRM_GEM_NAMES_H
 #define	DRM_GEM_NAMES_H
 
-#include <sys/types.h>
+#include <sys/param.h>
 #include <sys/lock.h>
 #include <sys/mutex.h>
 #include <sys/queue.h>
+#include <sys/rwlock.h>
 
 struct drm_gem_name {
 	uint32_t name;
@@ -46,10 +47,31 @@ struct drm_gem_name {
 	LIST_ENTRY(drm_gem_name) link;
 };
 
-struct drm_gem_names {
-	struct mtx lock;
-	LIST_HEAD(drm_gem_names_head, drm_gem_name) *names_hash;
+LIST_HEAD(drm_gem_names_head, drm_gem_name);
+
+/*
+ * Names are spread over DRM_GEM_NAMES_STRIPES independently locked hash
+ * tables by their low bits.  Lookups take the stripe lock shared, updates
+ * take it exclusive.  Each stripe grows on its own; while it does,
+ * entries are migrated from old_hash into names_hash a few buckets at a
+ * time by the subsequent updates, and lookups check both tables.
+ */
+#define	DRM_GEM_NAMES_STRIPES	16
+
+struct drm_gem_names_stripe {
+	struct rwlock lock;
+	struct drm_gem_names_head *names_hash;
 	u_long hash_mask;
+	struct drm_gem_names_head *old_hash;
+	u_long old_hash_mask;
+	u_long old_hash_pos;
+	u_int count;
+	u_int iterating;
+} __aligned(CACHE_LINE_SIZE);
+
+struct drm_gem_names {
+	struct drm_gem_names_stripe stripes[DRM_GEM_NAMES_STRIPES];
+	struct mtx unr_lock;
 	struct unrhdr *unr;
 };
 
@@ -249,6 +249,8 @@ int drm_getstats(struct drm_device *dev, void *data,
 		if (dev->types[i] == _DRM_STAT_LOCK)
 			stats->data[i].value =
 			    (file_priv->master->lock.hw_lock ? file_priv->master->lock.hw_lock->lock : 0);
+		else if (dev->types[i] == _DRM_STAT_IOCTLS)
+			stats->data[i].value = counter_u64_fetch(dev->ioctl_stat);
 		else
 			stats->data[i].value = atomic_read(&dev->counts[i]);
 		stats->data[i].type = dev->types[i];
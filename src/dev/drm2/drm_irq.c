@@ -53,6 +53,33 @@ __FBSDID("$FreeBSD$");
  */
 #define DRM_REDUNDANT_VBLIRQ_THRESH_NS 1000000
 
+/*
+ * The cooked vblank count and its timestamp ringbuffer slots are
+ * published under a per-crtc sequence counter, so that readers such as
+ * drm_vblank_count_and_time() never need vblank_time_lock.  Writers are
+ * already serialized by vblank_time_lock and bracket their updates with
+ * vblank_seq_write_begin()/vblank_seq_write_end(); the counter is odd
+ * while an update is in progress.  Readers spin while it is odd, so the
+ * write section runs in a critical section: vblank_time_lock is a sleep
+ * mutex, and a reader in an interrupt thread preempting the writer on
+ * the same CPU would otherwise spin forever.  Write sections must stay
+ * short and must not sleep.
+ */
+static inline void vblank_seq_write_begin(struct drm_device *dev, int crtc)
+{
+	mtx_assert(&dev->vblank_time_lock, MA_OWNED);
+	critical_enter();
+	atomic_inc(&dev->_vblank_seq[crtc]);
+	smp_wmb();
+}
+
+static inline void vblank_seq_write_end(struct drm_device *dev, int crtc)
+{
+	smp_wmb();
+	atomic_inc(&dev->_vblank_seq[crtc]);
+	critical_exit();
+}
+
 /**
  * Get interrupt from bus id.
  *
@@ -151,6 +178,7 @@ static void vblank_disable_and_save(struct drm_device *dev, int crtc)
 	 * available. In that case we can't account for this and just
 	 * hope for the best.
 	 */
+	vblank_seq_write_begin(dev, crtc);
 	if ((vblrc > 0) && (abs64(diff_ns) > 1000000)) {
 		atomic_inc(&dev->_vblank_count[crtc]);
 		smp_mb__after_atomic_inc();
@@ -158,6 +186,7 @@ static void vblank_disable_and_save(struct drm_device *dev, int crtc)
 
 	/* Invalidate all timestamps while vblank irq's are off. */
 	clear_vblank_timestamps(dev, crtc);
+	vblank_seq_write_end(dev, crtc);
 
 	mtx_unlock(&dev->vblank_time_lock);
 }
@@ -198,6 +227,10 @@ void drm_vblank_cleanup(struct drm_device *dev)
 	free(dev->last_vblank_wait, DRM_MEM_VBLANK);
 	free(dev->vblank_inmodeset, DRM_MEM_VBLANK);
 	free(dev->_vblank_time, DRM_MEM_VBLANK);
+	free(dev->_vblank_seq, DRM_MEM_VBLANK);
+	free(dev->vblank_event_list, DRM_MEM_VBLANK);
+	free(dev->vblank_event_pending, DRM_MEM_VBLANK);
+	free(dev->vblank_event_delivered, DRM_MEM_VBLANK);
 
 	mtx_destroy(&dev->vbl_lock);
 	mtx_destroy(&dev->vblank_time_lock);
@@ -251,6 +284,26 @@ int drm_vblank_init(struct drm_device *dev, int num_crtcs)
 	if (!dev->_vblank_time)
 		goto err;
 
+	dev->_vblank_seq = malloc(num_crtcs * sizeof(atomic_t),
+	    DRM_MEM_VBLANK, M_NOWAIT | M_ZERO);
+	if (!dev->_vblank_seq)
+		goto err;
+
+	dev->vblank_event_list = malloc(num_crtcs * sizeof(struct list_head),
+	    DRM_MEM_VBLANK, M_NOWAIT);
+	if (!dev->vblank_event_list)
+		goto err;
+
+	dev->vblank_event_pending = malloc(num_crtcs * sizeof(u_int),
+	    DRM_MEM_VBLANK, M_NOWAIT | M_ZERO);
+	if (!dev->vblank_event_pending)
+		goto err;
+
+	dev->vblank_event_delivered = malloc(num_crtcs * sizeof(u_long),
+	    DRM_MEM_VBLANK, M_NOWAIT | M_ZERO);
+	if (!dev->vblank_event_delivered)
+		goto err;
+
 	DRM_INFO("Supports vblank timestamp caching Rev 1 (10.10.2010).\n");
 
 	/* Driver specific high-precision vblank timestamping supported? */
@@ -263,6 +316,7 @@ int drm_vblank_init(struct drm_device *dev, int num_crtcs)
 	for (i = 0; i < num_crtcs; i++) {
 		atomic_set(&dev->_vblank_count[i], 0);
 		atomic_set(&dev->vblank_refcount[i], 0);
+		INIT_LIST_HEAD(&dev->vblank_event_list[i]);
 	}
 
 	dev->vblank_disable_allowed = 0;
@@ -781,17 +835,25 @@ u32 drm_vblank_count_and_time(struct drm_device *dev, int crtc,
 			      struct timeval *vblanktime)
 {
 	u32 cur_vblank;
+	u_int seq;
 
 	/* Read timestamp from slot of _vblank_time ringbuffer
 	 * that corresponds to current vblank count. Retry if
-	 * count has incremented during readout. This works like
-	 * a seqlock.
+	 * an update was in progress or completed during readout.
 	 */
-	do {
+	for (;;) {
+		seq = atomic_read(&dev->_vblank_seq[crtc]);
+		if ((seq & 1) != 0) {
+			cpu_spinwait();
+			continue;
+		}
+		smp_rmb();
 		cur_vblank = atomic_read(&dev->_vblank_count[crtc]);
 		*vblanktime = vblanktimestamp(dev, crtc, cur_vblank);
 		smp_rmb();
-	} while (cur_vblank != atomic_read(&dev->_vblank_count[crtc]));
+		if (seq == atomic_read(&dev->_vblank_seq[crtc]))
+			break;
+	}
 
 	return cur_vblank;
 }
@@ -892,6 +954,7 @@ static void drm_update_vblank_count(struct drm_device *dev, int crtc)
 	 * available. Skip this step if query unsupported or failed. Will
 	 * reinitialize delayed at next vblank interrupt in that case.
 	 */
+	vblank_seq_write_begin(dev, crtc);
 	if (rc) {
 		tslot = atomic_read(&dev->_vblank_count[crtc]) + diff;
 		vblanktimestamp(dev, crtc, tslot) = t_vblank;
@@ -900,6 +963,7 @@ static void drm_update_vblank_count(struct drm_device *dev, int crtc)
 	smp_mb__before_atomic_inc();
 	atomic_add(diff, &dev->_vblank_count[crtc]);
 	smp_mb__after_atomic_inc();
+	vblank_seq_write_end(dev, crtc);
 }
 
 /**
@@ -915,9 +979,36 @@ static void drm_update_vblank_count(struct drm_device *dev, int crtc)
  */
 int drm_vblank_get(struct drm_device *dev, int crtc)
 {
+	u_int refcount;
 	int ret = 0;
 
-	mtx_lock(&dev->vbl_lock);
+	/*
+	 * Fast path: if somebody already holds a reference, interrupts
+	 * cannot be disabled underneath us, so just take another one
+	 * without vbl_lock.  Only the 0->1 transition has to enable
+	 * interrupts and is serialized against vblank_disable_fn().
+	 *
+	 * The holder may still be in the middle of that transition, or
+	 * its enable may have failed.  Then back our reference out under
+	 * vbl_lock, where vblank_disable_fn() cannot see the count drop
+	 * to zero, and take the slow path like any other first user.
+	 */
+	for (;;) {
+		refcount = atomic_read(&dev->vblank_refcount[crtc]);
+		if (refcount == 0) {
+			mtx_lock(&dev->vbl_lock);
+			break;
+		}
+		if (atomic_cmpset_int(&dev->vblank_refcount[crtc], refcount,
+		    refcount + 1)) {
+			if (dev->vblank_enabled[crtc])
+				return 0;
+			mtx_lock(&dev->vbl_lock);
+			atomic_dec(&dev->vblank_refcount[crtc]);
+			break;
+		}
+	}
+
 	/* Going from 0->1 means we have to enable interrupts again */
 	if (atomic_add_return(1, &dev->vblank_refcount[crtc]) == 1) {
 		mtx_lock(&dev->vblank_time_lock);
@@ -993,13 +1084,14 @@ void drm_vblank_off(struct drm_device *dev, int crtc)
 	seq = drm_vblank_count_and_time(dev, crtc, &now);
 
 	mtx_lock(&dev->event_lock);
-	list_for_each_entry_safe(e, t, &dev->vblank_event_list, base.link) {
-		if (e->pipe != crtc)
-			continue;
+	list_for_each_entry_safe(e, t, &dev->vblank_event_list[crtc],
+	    base.link) {
 		DRM_DEBUG("Sending premature vblank event on disable: \
 			  wanted %d, current %d\n",
 			  e->event.sequence, seq);
 		list_del(&e->base.link);
+		dev->vblank_event_pending[crtc]--;
+		dev->vblank_event_delivered[crtc]++;
 		drm_vblank_put(dev, e->pipe);
 		send_vblank_event(dev, e, seq, &now);
 	}
@@ -1106,6 +1198,46 @@ drm_vblank_event_destroy(struct drm_pending_event *e)
 	free(e, DRM_MEM_VBLANK);
 }
 
+/*
+ * Distance of an event's target sequence from the current count, or zero
+ * if the event is already due.  It shrinks by the same amount for every
+ * pending event as the count advances, so a list ordered by it stays
+ * ordered and due events are always found at its head.
+ */
+static u32 drm_vblank_event_distance(u32 target, u32 seq)
+{
+
+	if ((seq - target) <= (1 << 23))
+		return (0);
+	return (target - seq);
+}
+
+/*
+ * Insert a pending event into its crtc list, keeping the list sorted by
+ * target sequence.  Clients usually queue events further out than the
+ * ones already pending, so search from the tail.
+ */
+static void drm_vblank_event_insert(struct drm_device *dev,
+				    struct drm_pending_vblank_event *e,
+				    u32 seq)
+{
+	struct list_head *head, *pos;
+	struct drm_pending_vblank_event *t;
+	u32 dist;
+
+	mtx_assert(&dev->event_lock, MA_OWNED);
+
+	head = &dev->vblank_event_list[e->pipe];
+	dist = drm_vblank_event_distance(e->event.sequence, seq);
+	list_for_each_prev(pos, head) {
+		t = list_entry(pos, struct drm_pending_vblank_event, base.link);
+		if (drm_vblank_event_distance(t->event.sequence, seq) <= dist)
+			break;
+	}
+	list_add(&e->base.link, pos);
+	dev->vblank_event_pending[e->pipe]++;
+}
+
 static int drm_queue_vblank_event(struct drm_device *dev, int pipe,
 				  union drm_wait_vblank *vblwait,
 				  struct drm_file *file_priv)
@@ -1155,11 +1287,12 @@ static int drm_queue_vblank_event(struct drm_device *dev, int pipe,
 	e->event.sequence = vblwait->request.sequence;
 	if ((seq - vblwait->request.sequence) <= (1 << 23)) {
 		drm_vblank_put(dev, pipe);
+		dev->vblank_event_delivered[pipe]++;
 		send_vblank_event(dev, e, seq, &now);
 		vblwait->reply.sequence = seq;
 	} else {
 		/* drm_handle_vblank_events will call drm_vblank_put */
-		list_add_tail(&e->base.link, &dev->vblank_event_list);
+		drm_vblank_event_insert(dev, e, seq);
 		vblwait->reply.sequence = vblwait->request.sequence;
 	}
 
@@ -1254,6 +1387,10 @@ int drm_wait_vblank(struct drm_device *dev, void *data,
 	DRM_DEBUG("waiting on vblank count %d, crtc %d\n",
 		  vblwait->request.sequence, crtc);
 	dev->last_vblank_wait[crtc] = vblwait->request.sequence;
+	/* Queries for an already passed count do not need the lock. */
+	if ((drm_vblank_count(dev, crtc) - vblwait->request.sequence) <=
+	    (1 << 23))
+		goto reply;
 	mtx_lock(&dev->vblank_time_lock);
 	while (((drm_vblank_count(dev, crtc) - vblwait->request.sequence) >
 	    (1 << 23)) && dev->irq_enabled) {
@@ -1273,6 +1410,7 @@ int drm_wait_vblank(struct drm_device *dev, void *data,
 			break;
 	}
 	mtx_unlock(&dev->vblank_time_lock);
+reply:
 	if (ret != -EINTR) {
 		struct timeval now;
 		long reply_seq;
@@ -1311,16 +1449,18 @@ static void drm_handle_vblank_events(struct drm_device *dev, int crtc)
 
 	mtx_lock(&dev->event_lock);
 
-	list_for_each_entry_safe(e, t, &dev->vblank_event_list, base.link) {
-		if (e->pipe != crtc)
-			continue;
+	/* The list is sorted, stop at the first event that is not due. */
+	list_for_each_entry_safe(e, t, &dev->vblank_event_list[crtc],
+	    base.link) {
 		if ((seq - e->event.sequence) > (1<<23))
-			continue;
+			break;
 
 		DRM_DEBUG("vblank event on %d, current %d\n",
 			  e->event.sequence, seq);
 
 		list_del(&e->base.link);
+		dev->vblank_event_pending[crtc]--;
+		dev->vblank_event_delivered[crtc]++;
 		drm_vblank_put(dev, e->pipe);
 		send_vblank_event(dev, e, seq, &now);
 	}
@@ -1381,6 +1521,8 @@ bool drm_handle_vblank(struct drm_device *dev, int crtc)
 	 * ignore those for accounting.
 	 */
 	if (abs64(diff_ns) > DRM_REDUNDANT_VBLIRQ_THRESH_NS) {
+		vblank_seq_write_begin(dev, crtc);
+
 		/* Store new timestamp in ringbuffer. */
 		vblanktimestamp(dev, crtc, vblcount + 1) = tvblank;
 
@@ -1390,6 +1532,8 @@ bool drm_handle_vblank(struct drm_device *dev, int crtc)
 		smp_mb__before_atomic_inc();
 		atomic_inc(&dev->_vblank_count[crtc]);
 		smp_mb__after_atomic_inc();
+
+		vblank_seq_write_end(dev, crtc);
 	} else {
 		DRM_DEBUG("crtc %d: Redundant vblirq ignored. diff_ns = %d\n",
 			  crtc, (int) diff_ns);
@@ -32,46 +32,125 @@
 #include <dev/drm2/drmP.h>
 __FBSDID("$FreeBSD$");
 
-struct drm_list_sort_thunk {
-	int (*cmp)(void *, struct list_head *, struct list_head *);
-	void *priv;
-};
+#define	DRM_LIST_SORT_MAX_BITS	20
 
-static int
-drm_le_cmp(void *priv, const void *d1, const void *d2)
+/*
+ * Merge two NULL-terminated singly-linked lists.  Elements of a win
+ * ties, which keeps the sort stable.
+ */
+static struct list_head *
+drm_list_sort_merge(void *priv, int (*cmp)(void *priv, struct list_head *a,
+    struct list_head *b), struct list_head *a, struct list_head *b)
 {
-	struct list_head *le1, *le2;
-	struct drm_list_sort_thunk *thunk;
+	struct list_head head, *tail;
 
-	thunk = priv;
-	le1 = *(__DECONST(struct list_head **, d1));
-	le2 = *(__DECONST(struct list_head **, d2));
-	return ((thunk->cmp)(thunk->priv, le1, le2));
+	tail = &head;
+	while (a != NULL && b != NULL) {
+		if ((*cmp)(priv, a, b) <= 0) {
+			tail->next = a;
+			a = a->next;
+		} else {
+			tail->next = b;
+			b = b->next;
+		}
+		tail = tail->next;
+	}
+	tail->next = a != NULL ? a : b;
+	return (head.next);
 }
 
 /*
- * Punt and use array sort.
+ * Merge the last two lists straight into head, restoring the prev links
+ * of the whole list on the way.
+ */
+static void
+drm_list_sort_merge_final(void *priv, int (*cmp)(void *priv,
+    struct list_head *a, struct list_head *b), struct list_head *head,
+    struct list_head *a, struct list_head *b)
+{
+	struct list_head *tail;
+	uint8_t count;
+
+	tail = head;
+	while (a != NULL && b != NULL) {
+		if ((*cmp)(priv, a, b) <= 0) {
+			tail->next = a;
+			a->prev = tail;
+			a = a->next;
+		} else {
+			tail->next = b;
+			b->prev = tail;
+			b = b->next;
+		}
+		tail = tail->next;
+	}
+	tail->next = a != NULL ? a : b;
+
+	count = 0;
+	do {
+		/*
+		 * A long, already sorted tail makes for a long loop without
+		 * any comparison.  Call cmp() on an element with itself now
+		 * and then so that it gets a chance to yield the CPU.
+		 */
+		if (++count == 0)
+			(*cmp)(priv, tail->next, tail->next);
+		tail->next->prev = tail;
+		tail = tail->next;
+	} while (tail->next != NULL);
+
+	tail->next = head;
+	head->prev = tail;
+}
+
+/*
+ * Stable, in-place bottom-up merge sort of a list, as Linux list_sort().
+ * Elements are unlinked into a singly-linked list and merged into
+ * part[n], which holds a sorted list of 2^n elements, like a binary
+ * counter.  No memory is allocated, so this may be called from any
+ * context cmp() itself may run in.  cmp() returns a negative value if a
+ * sorts before b and a positive value if after; equal elements keep
+ * their original order.
  */
 void
 drm_list_sort(void *priv, struct list_head *head, int (*cmp)(void *priv,
     struct list_head *a, struct list_head *b))
 {
-	struct drm_list_sort_thunk thunk;
-	struct list_head **ar, *le;
-	int count, i;
+	struct list_head *part[DRM_LIST_SORT_MAX_BITS + 1];
+	struct list_head *list, *cur;
+	int lev, max_lev;
 
-	count = 0;
-	list_for_each(le, head)
-		count++;
-	ar = malloc(sizeof(struct list_head *) * count, M_TEMP, M_WAITOK);
-	i = 0;
-	list_for_each(le, head)
-		ar[i++] = le;
-	thunk.cmp = cmp;
-	thunk.priv = priv;
-	qsort_r(ar, count, sizeof(struct list_head *), &thunk, drm_le_cmp);
-	INIT_LIST_HEAD(head);
-	for (i = 0; i < count; i++)
-		list_add_tail(ar[i], head);
-	free(ar, M_TEMP);
+	if (list_empty(head))
+		return;
+
+	memset(part, 0, sizeof(part));
+	max_lev = 0;
+	head->prev->next = NULL;
+	list = head->next;
+
+	while (list != NULL) {
+		cur = list;
+		list = list->next;
+		cur->next = NULL;
+
+		for (lev = 0; part[lev] != NULL; lev++) {
+			cur = drm_list_sort_merge(priv, cmp, part[lev], cur);
+			part[lev] = NULL;
+		}
+		if (lev > max_lev) {
+			if (lev >= DRM_LIST_SORT_MAX_BITS) {
+				/* Over 2^20 elements, keep merging at the top. */
+				lev--;
+			}
+			max_lev = lev;
+		}
+		part[lev] = cur;
+	}
+
+	for (lev = 0; lev < max_lev; lev++) {
+		if (part[lev] != NULL)
+			list = drm_list_sort_merge(priv, cmp, part[lev], list);
+	}
+
+	drm_list_sort_merge_final(priv, cmp, head, part[max_lev], list);
 }
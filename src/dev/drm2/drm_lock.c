@@ -95,7 +95,7 @@ int drm_lock(struct drm_device *dev, void *data, struct drm_file *file_priv)
 
 		/* Contention */
 		DRM_UNLOCK_ASSERT(dev);
-		ret = -sx_sleep(&master->lock.lock_queue, &drm_global_mutex,
+		ret = -sx_sleep(&master->lock.lock_queue, &dev->ioctl_lock,
 		    PCATCH, "drmlk2", 0);
 		if (ret == -ERESTART)
 			ret = -ERESTARTSYS;
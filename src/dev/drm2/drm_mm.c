@@ -33,12 +33,13 @@ __FBSDID("$FreeBSD$");
  * Generic simple memory manager implementation. Intended to be used as a base
  * class implementation for more advanced memory managers.
  *
- * Note that the algorithm used is quite simple and there might be substantial
- * performance gains if a smarter free list is implemented. Currently it is just an
- * unordered stack of free regions. This could easily be improved if an RB-tree
- * is used instead. At least if we expect heavy fragmentation.
+ * Free regions are kept on an unordered stack, and are additionally indexed by
+ * two RB-trees: one ordered by hole size, used for best-fit searches, and one
+ * ordered by hole address and augmented with the largest hole found in each
+ * subtree, used for first-fit and range-restricted searches. This keeps
+ * searches logarithmic even under heavy fragmentation.
  *
- * Aligned allocations can also see improvement.
+ * Aligned allocations can still see improvement.
  *
  * Authors:
  * Thomas Hellström <thomas-at-tungstengraphics-dot-com>
@@ -113,6 +114,108 @@ static inline unsigned long drm_mm_hole_node_end(struct drm_mm_node *hole_node)
 	return next_node->start;
 }
 
+static int drm_mm_hole_size_cmp(struct drm_mm_node *a, struct drm_mm_node *b)
+{
+	unsigned long a_start, b_start;
+
+	if (a->hole_size != b->hole_size)
+		return a->hole_size < b->hole_size ? -1 : 1;
+	a_start = drm_mm_hole_node_start(a);
+	b_start = drm_mm_hole_node_start(b);
+	if (a_start != b_start)
+		return a_start < b_start ? -1 : 1;
+	return 0;
+}
+
+static int drm_mm_hole_addr_cmp(struct drm_mm_node *a, struct drm_mm_node *b)
+{
+	unsigned long a_start = drm_mm_hole_node_start(a);
+	unsigned long b_start = drm_mm_hole_node_start(b);
+
+	if (a_start != b_start)
+		return a_start < b_start ? -1 : 1;
+	return 0;
+}
+
+static void drm_mm_hole_addr_augment(struct drm_mm_node *node)
+{
+	struct drm_mm_node *child;
+	unsigned long max_hole = node->hole_size;
+
+	child = RB_LEFT(node, hole_addr_rb);
+	if (child != NULL && child->subtree_max_hole > max_hole)
+		max_hole = child->subtree_max_hole;
+	child = RB_RIGHT(node, hole_addr_rb);
+	if (child != NULL && child->subtree_max_hole > max_hole)
+		max_hole = child->subtree_max_hole;
+	node->subtree_max_hole = max_hole;
+}
+
+RB_GENERATE_STATIC(drm_mm_hole_size_tree, drm_mm_node, hole_size_rb,
+    drm_mm_hole_size_cmp);
+
+#undef RB_AUGMENT
+#define	RB_AUGMENT(node)	drm_mm_hole_addr_augment(node)
+RB_GENERATE_STATIC(drm_mm_hole_addr_tree, drm_mm_node, hole_addr_rb,
+    drm_mm_hole_addr_cmp);
+
+/*
+ * Recompute the largest-hole augmentation from node up to the root. The
+ * tree code only fixes up the nodes it rotates, so this has to be done
+ * explicitly after every change of a hole size or of the tree shape.
+ */
+static void drm_mm_hole_addr_propagate(struct drm_mm_node *node)
+{
+	for (; node != NULL; node = RB_PARENT(node, hole_addr_rb))
+		drm_mm_hole_addr_augment(node);
+}
+
+static void drm_mm_hole_tree_insert(struct drm_mm *mm, struct drm_mm_node *node)
+{
+	node->hole_size = drm_mm_hole_node_end(node) -
+	    drm_mm_hole_node_start(node);
+	node->subtree_max_hole = node->hole_size;
+	RB_INSERT(drm_mm_hole_size_tree, &mm->hole_size_root, node);
+	RB_INSERT(drm_mm_hole_addr_tree, &mm->hole_addr_root, node);
+	drm_mm_hole_addr_propagate(node);
+}
+
+static void drm_mm_hole_tree_remove(struct drm_mm *mm, struct drm_mm_node *node)
+{
+	struct drm_mm_node *fixup, *succ;
+
+	/*
+	 * Find the lowest position whose subtree changes once node is
+	 * unlinked: its parent when it has at most one child, otherwise
+	 * the place its in-order successor is spliced out of.
+	 */
+	if (RB_LEFT(node, hole_addr_rb) == NULL ||
+	    RB_RIGHT(node, hole_addr_rb) == NULL)
+		fixup = RB_PARENT(node, hole_addr_rb);
+	else {
+		succ = RB_RIGHT(node, hole_addr_rb);
+		while (RB_LEFT(succ, hole_addr_rb) != NULL)
+			succ = RB_LEFT(succ, hole_addr_rb);
+		fixup = RB_PARENT(succ, hole_addr_rb);
+		if (fixup == node)
+			fixup = succ;
+	}
+
+	RB_REMOVE(drm_mm_hole_size_tree, &mm->hole_size_root, node);
+	RB_REMOVE(drm_mm_hole_addr_tree, &mm->hole_addr_root, node);
+	drm_mm_hole_addr_propagate(fixup);
+}
+
+/* The hole following node changed its end; refresh its size keys. */
+static void drm_mm_hole_tree_resize(struct drm_mm *mm, struct drm_mm_node *node)
+{
+	RB_REMOVE(drm_mm_hole_size_tree, &mm->hole_size_root, node);
+	node->hole_size = drm_mm_hole_node_end(node) -
+	    drm_mm_hole_node_start(node);
+	RB_INSERT(drm_mm_hole_size_tree, &mm->hole_size_root, node);
+	drm_mm_hole_addr_propagate(node);
+}
+
 static void drm_mm_insert_helper(struct drm_mm_node *hole_node,
 				 struct drm_mm_node *node,
 				 unsigned long size, unsigned alignment,
@@ -138,6 +241,7 @@ static void drm_mm_insert_helper(struct drm_mm_node *hole_node,
 	if (adj_start == hole_start) {
 		hole_node->hole_follows = 0;
 		list_del(&hole_node->hole_stack);
+		drm_mm_hole_tree_remove(mm, hole_node);
 	}
 
 	node->start = adj_start;
@@ -149,12 +253,16 @@ static void drm_mm_insert_helper(struct drm_mm_node *hole_node,
 	INIT_LIST_HEAD(&node->hole_stack);
 	list_add(&node->node_list, &hole_node->node_list);
 
+	if (hole_node->hole_follows)
+		drm_mm_hole_tree_resize(mm, hole_node);
+
 	BUG_ON(node->start + node->size > adj_end);
 
 	node->hole_follows = 0;
 	if (node->start + node->size < hole_end) {
 		list_add(&node->hole_stack, &mm->hole_stack);
 		node->hole_follows = 1;
+		drm_mm_hole_tree_insert(mm, node);
 	}
 }
 
@@ -235,6 +343,7 @@ static void drm_mm_insert_helper_range(struct drm_mm_node *hole_node,
 	if (adj_start == hole_start) {
 		hole_node->hole_follows = 0;
 		list_del(&hole_node->hole_stack);
+		drm_mm_hole_tree_remove(mm, hole_node);
 	}
 
 	node->start = adj_start;
@@ -246,6 +355,9 @@ static void drm_mm_insert_helper_range(struct drm_mm_node *hole_node,
 	INIT_LIST_HEAD(&node->hole_stack);
 	list_add(&node->node_list, &hole_node->node_list);
 
+	if (hole_node->hole_follows)
+		drm_mm_hole_tree_resize(mm, hole_node);
+
 	BUG_ON(node->start + node->size > adj_end);
 	BUG_ON(node->start + node->size > end);
 
@@ -253,6 +365,7 @@ static void drm_mm_insert_helper_range(struct drm_mm_node *hole_node,
 	if (node->start + node->size < hole_end) {
 		list_add(&node->hole_stack, &mm->hole_stack);
 		node->hole_follows = 1;
+		drm_mm_hole_tree_insert(mm, node);
 	}
 }
 
@@ -327,18 +440,22 @@ void drm_mm_remove_node(struct drm_mm_node *node)
 		BUG_ON(drm_mm_hole_node_start(node)
 				== drm_mm_hole_node_end(node));
 		list_del(&node->hole_stack);
+		drm_mm_hole_tree_remove(mm, node);
 	} else
 		BUG_ON(drm_mm_hole_node_start(node)
 				!= drm_mm_hole_node_end(node));
 
+	list_del(&node->node_list);
+	node->allocated = 0;
+
 	if (!prev_node->hole_follows) {
 		prev_node->hole_follows = 1;
 		list_add(&prev_node->hole_stack, &mm->hole_stack);
-	} else
+		drm_mm_hole_tree_insert(mm, prev_node);
+	} else {
 		list_move(&prev_node->hole_stack, &mm->hole_stack);
-
-	list_del(&node->node_list);
-	node->allocated = 0;
+		drm_mm_hole_tree_resize(mm, prev_node);
+	}
 }
 EXPORT_SYMBOL(drm_mm_remove_node);
 
@@ -379,45 +496,115 @@ static int check_free_hole(unsigned long start, unsigned long end,
 	return end >= start + size;
 }
 
-struct drm_mm_node *drm_mm_search_free_generic(const struct drm_mm *mm,
+static int drm_mm_check_hole(const struct drm_mm *mm,
+			     struct drm_mm_node *entry,
+			     unsigned long size, unsigned alignment,
+			     unsigned long color,
+			     unsigned long start, unsigned long end)
+{
+	unsigned long adj_start = drm_mm_hole_node_start(entry) < start ?
+		start : drm_mm_hole_node_start(entry);
+	unsigned long adj_end = drm_mm_hole_node_end(entry) > end ?
+		end : drm_mm_hole_node_end(entry);
+
+	BUG_ON(!entry->hole_follows);
+
+	if (mm->color_adjust) {
+		mm->color_adjust(entry, color, &adj_start, &adj_end);
+		if (adj_end <= adj_start)
+			return 0;
+	}
+
+	return check_free_hole(adj_start, adj_end, size, alignment);
+}
+
+/*
+ * Best fit: walk the holes by increasing size, starting with the smallest
+ * one that is large enough, and take the first that satisfies the
+ * alignment, color and range constraints.
+ */
+static struct drm_mm_node *drm_mm_search_best(const struct drm_mm *mm,
+					      unsigned long size,
+					      unsigned alignment,
+					      unsigned long color,
+					      unsigned long start,
+					      unsigned long end)
+{
+	struct drm_mm_hole_size_tree *root;
+	struct drm_mm_node *entry, key;
+
+	root = __DECONST(struct drm_mm_hole_size_tree *, &mm->hole_size_root);
+	key.start = 0;
+	key.size = 0;
+	key.hole_size = size;
+
+	for (entry = RB_NFIND(drm_mm_hole_size_tree, root, &key);
+	     entry != NULL;
+	     entry = RB_NEXT(drm_mm_hole_size_tree, root, entry)) {
+		if (drm_mm_hole_node_end(entry) <= start ||
+		    drm_mm_hole_node_start(entry) >= end)
+			continue;
+		if (drm_mm_check_hole(mm, entry, size, alignment, color,
+				      start, end))
+			return entry;
+	}
+
+	return NULL;
+}
+
+/*
+ * First fit: find the lowest addressed suitable hole, skipping subtrees
+ * which lie outside of [start, end) or hold no hole of at least size.
+ * Recursion depth is bounded by the tree height.
+ */
+static struct drm_mm_node *drm_mm_search_first(const struct drm_mm *mm,
+					       struct drm_mm_node *entry,
 					       unsigned long size,
 					       unsigned alignment,
 					       unsigned long color,
-					       bool best_match)
+					       unsigned long start,
+					       unsigned long end)
 {
-	struct drm_mm_node *entry;
-	struct drm_mm_node *best;
-	unsigned long best_size;
+	struct drm_mm_node *found;
+	unsigned long hole_start;
 
-	BUG_ON(mm->scanned_blocks);
+	if (entry == NULL || entry->subtree_max_hole < size)
+		return NULL;
 
-	best = NULL;
-	best_size = ~0UL;
+	hole_start = drm_mm_hole_node_start(entry);
+	if (hole_start > start) {
+		found = drm_mm_search_first(mm, RB_LEFT(entry, hole_addr_rb),
+					    size, alignment, color, start, end);
+		if (found != NULL)
+			return found;
+	}
 
-	list_for_each_entry(entry, &mm->hole_stack, hole_stack) {
-		unsigned long adj_start = drm_mm_hole_node_start(entry);
-		unsigned long adj_end = drm_mm_hole_node_end(entry);
+	if (hole_start >= end)
+		return NULL;
 
-		if (mm->color_adjust) {
-			mm->color_adjust(entry, color, &adj_start, &adj_end);
-			if (adj_end <= adj_start)
-				continue;
-		}
+	if (entry->hole_size >= size &&
+	    drm_mm_hole_node_end(entry) > start &&
+	    drm_mm_check_hole(mm, entry, size, alignment, color, start, end))
+		return entry;
 
-		BUG_ON(!entry->hole_follows);
-		if (!check_free_hole(adj_start, adj_end, size, alignment))
-			continue;
+	return drm_mm_search_first(mm, RB_RIGHT(entry, hole_addr_rb),
+				   size, alignment, color, start, end);
+}
 
-		if (!best_match)
-			return entry;
+struct drm_mm_node *drm_mm_search_free_generic(const struct drm_mm *mm,
+					       unsigned long size,
+					       unsigned alignment,
+					       unsigned long color,
+					       bool best_match)
+{
+	BUG_ON(mm->scanned_blocks);
 
-		if (entry->size < best_size) {
-			best = entry;
-			best_size = entry->size;
-		}
-	}
+	if (best_match)
+		return drm_mm_search_best(mm, size, alignment, color,
+					  0, ~0UL);
 
-	return best;
+	return drm_mm_search_first(mm, RB_ROOT(&mm->hole_addr_root),
+				   size, alignment, color, 0, ~0UL);
 }
 EXPORT_SYMBOL(drm_mm_search_free_generic);
 
@@ -429,42 +616,14 @@ struct drm_mm_node *drm_mm_search_free_in_range_generic(const struct drm_mm *mm,
 							unsigned long end,
 							bool best_match)
 {
-	struct drm_mm_node *entry;
-	struct drm_mm_node *best;
-	unsigned long best_size;
-
 	BUG_ON(mm->scanned_blocks);
 
-	best = NULL;
-	best_size = ~0UL;
-
-	list_for_each_entry(entry, &mm->hole_stack, hole_stack) {
-		unsigned long adj_start = drm_mm_hole_node_start(entry) < start ?
-			start : drm_mm_hole_node_start(entry);
-		unsigned long adj_end = drm_mm_hole_node_end(entry) > end ?
-			end : drm_mm_hole_node_end(entry);
-
-		BUG_ON(!entry->hole_follows);
+	if (best_match)
+		return drm_mm_search_best(mm, size, alignment, color,
+					  start, end);
 
-		if (mm->color_adjust) {
-			mm->color_adjust(entry, color, &adj_start, &adj_end);
-			if (adj_end <= adj_start)
-				continue;
-		}
-
-		if (!check_free_hole(adj_start, adj_end, size, alignment))
-			continue;
-
-		if (!best_match)
-			return entry;
-
-		if (entry->size < best_size) {
-			best = entry;
-			best_size = entry->size;
-		}
-	}
-
-	return best;
+	return drm_mm_search_first(mm, RB_ROOT(&mm->hole_addr_root),
+				   size, alignment, color, start, end);
 }
 EXPORT_SYMBOL(drm_mm_search_free_in_range_generic);
 
@@ -473,6 +632,9 @@ EXPORT_SYMBOL(drm_mm_search_free_in_range_generic);
  */
 void drm_mm_replace_node(struct drm_mm_node *old, struct drm_mm_node *new)
 {
+	if (old->hole_follows)
+		drm_mm_hole_tree_remove(old->mm, old);
+
 	list_replace(&old->node_list, &new->node_list);
 	list_replace(&old->hole_stack, &new->hole_stack);
 	new->hole_follows = old->hole_follows;
@@ -481,6 +643,9 @@ void drm_mm_replace_node(struct drm_mm_node *old, struct drm_mm_node *new)
 	new->size = old->size;
 	new->color = old->color;
 
+	if (new->hole_follows)
+		drm_mm_hole_tree_insert(new->mm, new);
+
 	old->allocated = 0;
 	new->allocated = 1;
 }
@@ -601,8 +766,8 @@ EXPORT_SYMBOL(drm_mm_scan_add_block);
  * corrupted.
  *
  * When the scan list is empty, the selected memory nodes can be freed. An
- * immediately following drm_mm_search_free with best_match = 0 will then return
- * the just freed block (because its at the top of the free_stack list).
+ * immediately following drm_mm_search_free will then find a hole at least as
+ * large as the one requested from drm_mm_init_scan.
  *
  * Returns one if this block should be evicted, zero otherwise. Will always
  * return zero when no hole has been found.
@@ -639,6 +804,8 @@ EXPORT_SYMBOL(drm_mm_clean);
 int drm_mm_init(struct drm_mm * mm, unsigned long start, unsigned long size)
 {
 	INIT_LIST_HEAD(&mm->hole_stack);
+	RB_INIT(&mm->hole_size_root);
+	RB_INIT(&mm->hole_addr_root);
 	INIT_LIST_HEAD(&mm->unused_nodes);
 	mm->num_unused = 0;
 	mm->scanned_blocks = 0;
@@ -655,6 +822,7 @@ int drm_mm_init(struct drm_mm * mm, unsigned long start, unsigned long size)
 	mm->head_node.start = start + size;
 	mm->head_node.size = start - mm->head_node.start;
 	list_add_tail(&mm->head_node.hole_stack, &mm->hole_stack);
+	drm_mm_hole_tree_insert(mm, &mm->head_node);
 
 	mm->color_adjust = NULL;
 
@@ -39,11 +39,17 @@ __FBSDID("$FreeBSD$");
 /*
  * Generic range manager structs
  */
+#include <sys/tree.h>
 #include <dev/drm2/drm_linux_list.h>
 
 struct drm_mm_node {
 	struct list_head node_list;
 	struct list_head hole_stack;
+	/* Free hole tracking, valid while hole_follows is set. */
+	RB_ENTRY(drm_mm_node) hole_size_rb;
+	RB_ENTRY(drm_mm_node) hole_addr_rb;
+	unsigned long hole_size;
+	unsigned long subtree_max_hole;
 	unsigned hole_follows : 1;
 	unsigned scanned_block : 1;
 	unsigned scanned_prev_free : 1;
@@ -59,6 +65,11 @@ struct drm_mm_node {
 struct drm_mm {
 	/* List of all memory nodes that immediately precede a free hole. */
 	struct list_head hole_stack;
+	/* The same holes, indexed by (size, address) for best-fit searches
+	 * and by address, augmented with the largest hole in each subtree,
+	 * for first-fit and range-restricted searches. */
+	RB_HEAD(drm_mm_hole_size_tree, drm_mm_node) hole_size_root;
+	RB_HEAD(drm_mm_hole_addr_tree, drm_mm_node) hole_addr_root;
 	/* head_node.node_list is the list of all memory nodes, ordered
 	 * according to the (increasing) start address of the memory node. */
 	struct drm_mm_node head_node;
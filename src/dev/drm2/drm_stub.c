@@ -230,12 +230,12 @@ int drm_fill_in_dev(struct drm_device *dev,
 	INIT_LIST_HEAD(&dev->filelist);
 	INIT_LIST_HEAD(&dev->ctxlist);
 	INIT_LIST_HEAD(&dev->maplist);
-	INIT_LIST_HEAD(&dev->vblank_event_list);
 
 	mtx_init(&dev->irq_lock, "drmirq", NULL, MTX_DEF);
 	mtx_init(&dev->count_lock, "drmcount", NULL, MTX_DEF);
 	mtx_init(&dev->event_lock, "drmev", NULL, MTX_DEF);
 	sx_init(&dev->dev_struct_lock, "drmslk");
+	sx_init(&dev->ioctl_lock, "drmioctl");
 	mtx_init(&dev->ctxlist_mutex, "drmctxlist", NULL, MTX_DEF);
 	mtx_init(&dev->pcir_lock, "drmpcir", NULL, MTX_DEF);
 
@@ -257,6 +257,8 @@ int drm_fill_in_dev(struct drm_device *dev,
 	 */
 	for (i = 0; i < ARRAY_SIZE(dev->counts); i++)
 		atomic_set(&dev->counts[i], 0);
+	dev->ioctl_count = counter_u64_alloc(M_WAITOK);
+	dev->ioctl_stat = counter_u64_alloc(M_WAITOK);
 
 	dev->driver = driver;
 
@@ -320,10 +322,14 @@ void drm_cancel_fill_in_dev(struct drm_device *dev)
 
 	drm_ht_remove(&dev->map_hash);
 
+	counter_u64_free(dev->ioctl_count);
+	counter_u64_free(dev->ioctl_stat);
+
 	mtx_destroy(&dev->irq_lock);
 	mtx_destroy(&dev->count_lock);
 	mtx_destroy(&dev->event_lock);
 	sx_destroy(&dev->dev_struct_lock);
+	sx_destroy(&dev->ioctl_lock);
 	mtx_destroy(&dev->ctxlist_mutex);
 	mtx_destroy(&dev->pcir_lock);
 }
@@ -487,10 +493,14 @@ void drm_put_dev(struct drm_device *dev)
 
 	drm_put_minor(&dev->primary);
 
+	counter_u64_free(dev->ioctl_count);
+	counter_u64_free(dev->ioctl_stat);
+
 	mtx_destroy(&dev->irq_lock);
 	mtx_destroy(&dev->count_lock);
 	mtx_destroy(&dev->event_lock);
 	sx_destroy(&dev->dev_struct_lock);
+	sx_destroy(&dev->ioctl_lock);
 	mtx_destroy(&dev->ctxlist_mutex);
 	mtx_destroy(&dev->pcir_lock);
 
@@ -39,6 +39,8 @@ static int	   drm_vm_info DRM_SYSCTL_HANDLER_ARGS;
 static int	   drm_clients_info DRM_SYSCTL_HANDLER_ARGS;
 static int	   drm_bufs_info DRM_SYSCTL_HANDLER_ARGS;
 static int	   drm_vblank_info DRM_SYSCTL_HANDLER_ARGS;
+static int	   drm_ioctl_hist_sysctl_init(struct drm_device *dev,
+		       struct sysctl_ctx_list *ctx, struct sysctl_oid *top);
 
 struct drm_sysctl_list {
 	const char *name;
@@ -121,6 +123,9 @@ int drm_sysctl_init(struct drm_device *dev)
 	    CTLFLAG_RW, &drm_notyet, sizeof(drm_debug),
 	    "Enable notyet reminders");
 
+	drm_trace_sysctl_init(dev, &info->ctx, top);
+	drm_ioctl_hist_sysctl_init(dev, &info->ctx, top);
+
 	if (dev->driver->sysctl_init != NULL)
 		dev->driver->sysctl_init(dev, &info->ctx, top);
 
@@ -146,6 +151,10 @@ int drm_sysctl_cleanup(struct drm_device *dev)
 	error = sysctl_ctx_free(&dev->sysctl->ctx);
 	free(dev->sysctl, DRM_MEM_DRIVER);
 	dev->sysctl = NULL;
+	drm_trace_fini(&dev->trace);
+	dev->ioctl_hist.enabled = 0;
+	free(dev->ioctl_hist.pcpu, DRM_MEM_DRIVER);
+	dev->ioctl_hist.pcpu = NULL;
 	if (dev->driver->sysctl_cleanup != NULL)
 		dev->driver->sysctl_cleanup(dev);
 
@@ -383,17 +392,21 @@ static int drm_vblank_info DRM_SYSCTL_HANDLER_ARGS
 	int retcode;
 	int i;
 
-	DRM_SYSCTL_PRINT("\ncrtc ref count    last     enabled inmodeset\n");
+	DRM_SYSCTL_PRINT("\ncrtc ref count    last     enabled inmodeset"
+	    " pending delivered\n");
 	DRM_LOCK(dev);
 	if (dev->_vblank_count == NULL)
 		goto done;
 	for (i = 0 ; i < dev->num_crtcs ; i++) {
-		DRM_SYSCTL_PRINT("  %02d  %02d %08d %08d %02d      %02d\n",
+		DRM_SYSCTL_PRINT("  %02d  %02d %08d %08d %02d      %02d"
+		    "        %04u    %lu\n",
 		    i, dev->vblank_refcount[i],
 		    dev->_vblank_count[i],
 		    dev->last_vblank[i],
 		    dev->vblank_enabled[i],
-		    dev->vblank_inmodeset[i]);
+		    dev->vblank_inmodeset[i],
+		    dev->vblank_event_pending[i],
+		    dev->vblank_event_delivered[i]);
 	}
 done:
 	DRM_UNLOCK(dev);
@@ -401,3 +414,100 @@ done:
 	SYSCTL_OUT(req, "", -1);
 	return retcode;
 }
+
+static int
+drm_ioctl_hist_enable_sysctl(SYSCTL_HANDLER_ARGS)
+{
+	struct drm_ioctl_hist *hist;
+	struct drm_ioctl_hist_pcpu *pcpu;
+	int error, val;
+
+	hist = arg1;
+	val = hist->enabled;
+	error = sysctl_handle_int(oidp, &val, 0, req);
+	if (error != 0 || req->newptr == NULL)
+		return (error);
+
+	if (val != 0 && hist->pcpu == NULL) {
+		pcpu = malloc((mp_maxid + 1) * sizeof(*pcpu), DRM_MEM_DRIVER,
+		    M_WAITOK | M_ZERO);
+		if (!atomic_cmpset_rel_ptr((volatile uintptr_t *)&hist->pcpu,
+		    (uintptr_t)NULL, (uintptr_t)pcpu))
+			free(pcpu, DRM_MEM_DRIVER);
+	}
+	atomic_store_rel_int(&hist->enabled, val != 0);
+	return (0);
+}
+
+static int
+drm_ioctl_hist_stats_sysctl(SYSCTL_HANDLER_ARGS)
+{
+	struct drm_ioctl_hist *hist;
+	struct drm_ioctl_hist_pcpu *pc;
+	uint64_t buckets[DRM_IOCTL_HIST_BUCKETS];
+	uint64_t calls, cycles;
+	struct sbuf sb;
+	int b, cpu, error;
+	u_int nr;
+
+	hist = arg1;
+	error = sysctl_wire_old_buffer(req, 0);
+	if (error != 0)
+		return (error);
+	sbuf_new_for_sysctl(&sb, NULL, 128, req);
+	sbuf_printf(&sb, "\n%-4s %-10s %-16s %-10s %s", "nr", "calls",
+	    "cycles", "avg", "log2(cycles):calls");
+	if (atomic_load_acq_ptr((volatile uintptr_t *)&hist->pcpu) == 0)
+		goto out;
+
+	for (nr = 0; nr < DRM_IOCTL_HIST_NR; nr++) {
+		memset(buckets, 0, sizeof(buckets));
+		calls = cycles = 0;
+		CPU_FOREACH(cpu) {
+			pc = &hist->pcpu[cpu];
+			cycles += pc->cycles[nr];
+			for (b = 0; b < DRM_IOCTL_HIST_BUCKETS; b++)
+				buckets[b] += pc->count[nr][b];
+		}
+		for (b = 0; b < DRM_IOCTL_HIST_BUCKETS; b++)
+			calls += buckets[b];
+		if (calls == 0)
+			continue;
+		sbuf_printf(&sb, "\n0x%02x %-10ju %-16ju %-10ju", nr,
+		    (uintmax_t)calls, (uintmax_t)cycles,
+		    (uintmax_t)(cycles / calls));
+		for (b = 0; b < DRM_IOCTL_HIST_BUCKETS; b++) {
+			if (buckets[b] != 0)
+				sbuf_printf(&sb, " %d:%ju", b,
+				    (uintmax_t)buckets[b]);
+		}
+	}
+out:
+	error = sbuf_finish(&sb);
+	sbuf_delete(&sb);
+	return (error);
+}
+
+static int
+drm_ioctl_hist_sysctl_init(struct drm_device *dev, struct sysctl_ctx_list *ctx,
+    struct sysctl_oid *top)
+{
+	struct sysctl_oid *node, *oid;
+
+	node = SYSCTL_ADD_NODE(ctx, SYSCTL_CHILDREN(top), OID_AUTO,
+	    "ioctl_hist", CTLFLAG_RW, NULL, "Per-ioctl latency histograms");
+	if (node == NULL)
+		return (-ENOMEM);
+	oid = SYSCTL_ADD_PROC(ctx, SYSCTL_CHILDREN(node), OID_AUTO, "enable",
+	    CTLTYPE_INT | CTLFLAG_RW | CTLFLAG_MPSAFE, &dev->ioctl_hist, 0,
+	    drm_ioctl_hist_enable_sysctl, "I", "Time ioctls by number");
+	if (oid == NULL)
+		return (-ENOMEM);
+	oid = SYSCTL_ADD_PROC(ctx, SYSCTL_CHILDREN(node), OID_AUTO, "stats",
+	    CTLTYPE_STRING | CTLFLAG_RD | CTLFLAG_MPSAFE, &dev->ioctl_hist, 0,
+	    drm_ioctl_hist_stats_sysctl, "A",
+	    "Calls, cycles and log2 cycle histogram per ioctl number");
+	if (oid == NULL)
+		return (-ENOMEM);
+	return (0);
+}
@@ -0,0 +1,191 @@
+/*-
+ * SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+ *
+ * Copyright (c) 2026 The FreeBSD Project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <sys/cdefs.h>
+__FBSDID("$FreeBSD$");
+
+#include <dev/drm2/drmP.h>
+
+#include <sys/sysctl.h>
+
+static int drm_trace_nentries = 4096;
+TUNABLE_INT("hw.drm.trace_entries", &drm_trace_nentries);
+
+static const char *drm_trace_event_names[DRM_TRACE_NEVENTS] = {
+	[DRM_TRACE_SUBMIT] =	"submit",
+	[DRM_TRACE_RELOC] =	"reloc",
+	[DRM_TRACE_VALIDATE] =	"validate",
+	[DRM_TRACE_EMIT] =	"emit",
+	[DRM_TRACE_SIGNAL] =	"signal",
+	[DRM_TRACE_RETIRE] =	"retire",
+};
+
+void
+drm_trace_record(struct drm_trace *trace, enum drm_trace_event event,
+    int ring, uint32_t id, uint32_t seqno)
+{
+	struct drm_trace_entry *entry;
+	u_int idx;
+
+	/*
+	 * The entries are allocated before tracing is first enabled and
+	 * only freed when the device goes away.
+	 */
+	atomic_thread_fence_acq();
+	idx = atomic_fetchadd_int(&trace->head, 1);
+	entry = &trace->entries[idx & (trace->nentries - 1)];
+	entry->gen = 0;
+	atomic_thread_fence_rel();
+	entry->ts = sbinuptime();
+	entry->id = id;
+	entry->seqno = seqno;
+	entry->event = event;
+	entry->ring = ring;
+	entry->cpu = curcpu;
+	atomic_store_rel_int(&entry->gen, idx + 1);
+}
+
+uint32_t
+drm_trace_next_id(struct drm_trace *trace)
+{
+
+	return (atomic_fetchadd_int(&trace->next_id, 1) + 1);
+}
+
+static int
+drm_trace_enable_sysctl(SYSCTL_HANDLER_ARGS)
+{
+	struct drm_trace *trace;
+	struct drm_trace_entry *entries;
+	u_int nentries;
+	int error, val;
+
+	trace = arg1;
+	val = trace->enabled;
+	error = sysctl_handle_int(oidp, &val, 0, req);
+	if (error != 0 || req->newptr == NULL)
+		return (error);
+
+	if (val != 0 && trace->entries == NULL) {
+		nentries = drm_trace_nentries;
+		if (nentries < 64)
+			nentries = 64;
+		if (nentries > 1024 * 1024)
+			nentries = 1024 * 1024;
+		if (!powerof2(nentries))
+			nentries = 1U << fls(nentries);
+		entries = malloc(nentries * sizeof(*entries), DRM_MEM_DRIVER,
+		    M_WAITOK | M_ZERO);
+		trace->nentries = nentries;
+		if (!atomic_cmpset_rel_ptr(
+		    (volatile uintptr_t *)&trace->entries,
+		    (uintptr_t)NULL, (uintptr_t)entries))
+			free(entries, DRM_MEM_DRIVER);
+	}
+	atomic_store_rel_int(&trace->enabled, val != 0);
+	return (0);
+}
+
+static int
+drm_trace_events_sysctl(SYSCTL_HANDLER_ARGS)
+{
+	struct drm_trace *trace;
+	struct drm_trace_entry entry, *slot;
+	struct sbuf sb;
+	u_int gen, head, i, n;
+	int error;
+
+	trace = arg1;
+	error = sysctl_wire_old_buffer(req, 0);
+	if (error != 0)
+		return (error);
+	sbuf_new_for_sysctl(&sb, NULL, 128, req);
+	sbuf_printf(&sb, "\n%-6s %-3s %-16s %-8s %-4s %-10s %-10s",
+	    "index", "cpu", "time_ns", "event", "ring", "id", "seqno");
+	if (trace->entries == NULL)
+		goto out;
+
+	head = atomic_load_acq_int(&trace->head);
+	n = min(head, trace->nentries);
+	for (i = head - n; i != head; i++) {
+		slot = &trace->entries[i & (trace->nentries - 1)];
+		/*
+		 * Skip records being written or already overwritten by
+		 * writers that lapped us.
+		 */
+		gen = atomic_load_acq_int(&slot->gen);
+		if (gen != i + 1)
+			continue;
+		entry = *slot;
+		atomic_thread_fence_acq();
+		if (atomic_load_acq_int(&slot->gen) != gen)
+			continue;
+		sbuf_printf(&sb, "\n%-6u %-3u %-16ju %-8s %-4d %-10u %-10u", i,
+		    entry.cpu, (uintmax_t)sbttons(entry.ts),
+		    entry.event < DRM_TRACE_NEVENTS &&
+		    drm_trace_event_names[entry.event] != NULL ?
+		    drm_trace_event_names[entry.event] : "?",
+		    (int16_t)entry.ring, entry.id, entry.seqno);
+	}
+out:
+	error = sbuf_finish(&sb);
+	sbuf_delete(&sb);
+	return (error);
+}
+
+int
+drm_trace_sysctl_init(struct drm_device *dev, struct sysctl_ctx_list *ctx,
+    struct sysctl_oid *top)
+{
+	struct sysctl_oid *node, *oid;
+
+	node = SYSCTL_ADD_NODE(ctx, SYSCTL_CHILDREN(top), OID_AUTO, "trace",
+	    CTLFLAG_RW, NULL, "Command submission trace");
+	if (node == NULL)
+		return (-ENOMEM);
+	oid = SYSCTL_ADD_PROC(ctx, SYSCTL_CHILDREN(node), OID_AUTO, "enable",
+	    CTLTYPE_INT | CTLFLAG_RW | CTLFLAG_MPSAFE, &dev->trace, 0,
+	    drm_trace_enable_sysctl, "I", "Record submission events");
+	if (oid == NULL)
+		return (-ENOMEM);
+	oid = SYSCTL_ADD_PROC(ctx, SYSCTL_CHILDREN(node), OID_AUTO, "events",
+	    CTLTYPE_STRING | CTLFLAG_RD | CTLFLAG_MPSAFE, &dev->trace, 0,
+	    drm_trace_events_sysctl, "A", "Recorded submission events");
+	if (oid == NULL)
+		return (-ENOMEM);
+	return (0);
+}
+
+void
+drm_trace_fini(struct drm_trace *trace)
+{
+
+	trace->enabled = 0;
+	free(trace->entries, DRM_MEM_DRIVER);
+	trace->entries = NULL;
+}
@@ -0,0 +1,108 @@
+/*-
+ * SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+ *
+ * Copyright (c) 2026 The FreeBSD Project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ *
+ */
+
+#ifndef DRM_TRACE_H
+#define	DRM_TRACE_H
+
+#include <sys/param.h>
+#include <sys/time.h>
+
+/*
+ * Per-device command submission trace.
+ *
+ * Drivers record the life of each submission into a fixed size ring of
+ * timestamped events: the ioctl entry, relocation processing, buffer
+ * validation, emission to the hardware ring, the fence interrupt and the
+ * retirement of the request.  Writers claim a slot with a single atomic
+ * increment and never block, so events can be recorded from interrupt
+ * context.  The ring wraps, keeping the most recent events.
+ *
+ * Submission-side events carry an id allocated by DRM_TRACE_ID() at the
+ * start of the ioctl; the emit event also carries the fence seqno, which
+ * is what the signal and retire events are keyed by.  The ring is -1 when
+ * it is not known yet.
+ *
+ * Tracing is off by default and enabled through hw.dri.N.trace.enable;
+ * the events are read back as text from hw.dri.N.trace.events.  When
+ * disabled, each trace point costs a single predicted branch.
+ */
+
+enum drm_trace_event {
+	DRM_TRACE_SUBMIT = 1,	/* submission ioctl entered */
+	DRM_TRACE_RELOC,	/* relocations parsed */
+	DRM_TRACE_VALIDATE,	/* buffers validated and placed */
+	DRM_TRACE_EMIT,		/* commands emitted, seqno allocated */
+	DRM_TRACE_SIGNAL,	/* fence interrupt saw seqno pass */
+	DRM_TRACE_RETIRE,	/* request retired */
+	DRM_TRACE_NEVENTS
+};
+
+struct drm_trace_entry {
+	sbintime_t	ts;
+	/* index + 1 of the record, 0 while the slot is being written */
+	volatile u_int	gen;
+	uint32_t	id;
+	uint32_t	seqno;
+	uint16_t	event;
+	uint16_t	ring;
+	uint32_t	cpu;
+};
+
+struct drm_trace {
+	volatile u_int	enabled;
+	u_int		nentries;	/* power of two */
+	volatile u_int	head;
+	volatile u_int	next_id;
+	struct drm_trace_entry *entries;
+};
+
+struct drm_device;
+struct sysctl_ctx_list;
+struct sysctl_oid;
+
+void	drm_trace_record(struct drm_trace *trace, enum drm_trace_event event,
+	    int ring, uint32_t id, uint32_t seqno);
+uint32_t drm_trace_next_id(struct drm_trace *trace);
+int	drm_trace_sysctl_init(struct drm_device *dev,
+	    struct sysctl_ctx_list *ctx, struct sysctl_oid *top);
+void	drm_trace_fini(struct drm_trace *trace);
+
+#define	DRM_TRACE(dev, event, ring, id, seqno) do {			\
+	if (__predict_false((dev)->trace.enabled))			\
+		drm_trace_record(&(dev)->trace, (event), (ring), (id),	\
+		    (seqno));						\
+} while (0)
+
+#define	DRM_TRACE_ID(dev)						\
+	(__predict_false((dev)->trace.enabled) ?			\
+	    drm_trace_next_id(&(dev)->trace) : 0)
+
+#endif /* DRM_TRACE_H */
@@ -351,6 +351,7 @@ static int i915_gem_request_info(struct drm_device *dev, struct sbuf *m, void *d
 			continue;
 
 		seq_printf(m, "%s requests:\n", ring->name);
+		mtx_lock(&ring->retire_lock);
 		list_for_each_entry(gem_request,
 				    &ring->request_list,
 				    list) {
@@ -358,6 +359,7 @@ static int i915_gem_request_info(struct drm_device *dev, struct sbuf *m, void *d
 				   gem_request->seqno,
 				   (int) (jiffies - gem_request->emitted_jiffies));
 		}
+		mtx_unlock(&ring->retire_lock);
 		count++;
 	}
 	DRM_UNLOCK(dev);
@@ -394,6 +396,70 @@ static int i915_gem_seqno_info(struct drm_device *dev, struct sbuf *m, void *dat
 	return 0;
 }
 
+static void i915_ring_hist_info(struct sbuf *m, const uint64_t *hist)
+{
+	int j;
+
+	for (j = 0; j < I915_RING_STALL_BUCKETS; j++) {
+		if (hist[j] == 0)
+			continue;
+		seq_printf(m, "  %s%juus: %ju\n",
+		    j == I915_RING_STALL_BUCKETS - 1 ? ">=" : "<",
+		    (uintmax_t)1 << (j == I915_RING_STALL_BUCKETS - 1 ?
+		    j - 1 : j), (uintmax_t)hist[j]);
+	}
+}
+
+static int i915_ring_stall_info(struct drm_device *dev, struct sbuf *m,
+				void *data)
+{
+	drm_i915_private_t *dev_priv = dev->dev_private;
+	struct intel_ring_buffer *ring;
+	struct intel_ring_stall_stats *stats;
+	int i;
+
+	if (sx_xlock_sig(&dev->dev_struct_lock))
+		return -EINTR;
+
+	for_each_ring(ring, dev_priv, i) {
+		stats = &ring->stall_stats;
+		seq_printf(m, "%s: %d pages, %ju stalls, %ju head waits "
+		    "(%ju irq wakeups, %ju timeouts), total %juus, max %juus\n",
+		    ring->name, ring->size / PAGE_SIZE,
+		    (uintmax_t)stats->stalls, (uintmax_t)stats->head_waits,
+		    (uintmax_t)stats->irq_wakeups, (uintmax_t)stats->timeouts,
+		    (uintmax_t)stats->total_us, (uintmax_t)stats->max_us);
+		i915_ring_hist_info(m, stats->hist);
+	}
+
+	DRM_UNLOCK(dev);
+
+	return 0;
+}
+
+static int i915_ring_retire_info(struct drm_device *dev, struct sbuf *m,
+				 void *data)
+{
+	drm_i915_private_t *dev_priv = dev->dev_private;
+	struct intel_ring_buffer *ring;
+	struct intel_ring_retire_stats stats;
+	int i;
+
+	for_each_ring(ring, dev_priv, i) {
+		mtx_lock(&ring->retire_lock);
+		stats = ring->retire_stats;
+		mtx_unlock(&ring->retire_lock);
+
+		seq_printf(m, "%s: %ju retired (%ju from interrupt, "
+		    "%ju left active), total %juus, max %juus\n",
+		    ring->name, (uintmax_t)stats.retired,
+		    (uintmax_t)stats.irq_retired, (uintmax_t)stats.contended,
+		    (uintmax_t)stats.total_us, (uintmax_t)stats.max_us);
+		i915_ring_hist_info(m, stats.hist);
+	}
+
+	return 0;
+}
 
 static int i915_interrupt_info(struct drm_device *dev, struct sbuf *m, void *data)
 {
@@ -1505,6 +1571,26 @@ i915_ring_stop(SYSCTL_HANDLER_ARGS)
 	return (0);
 }
 
+static int
+i915_fault_around(SYSCTL_HANDLER_ARGS)
+{
+	struct drm_device *dev = arg1;
+	drm_i915_private_t *dev_priv = dev->dev_private;
+	int val, ret;
+
+	if (dev_priv == NULL)
+		return (EBUSY);
+
+	val = dev_priv->mm.fault_around;
+	ret = sysctl_handle_int(oidp, &val, 0, req);
+	if (ret != 0 || !req->newptr)
+		return (ret);
+
+	dev_priv->mm.fault_around = val;
+
+	return (0);
+}
+
 static int
 i915_max_freq(SYSCTL_HANDLER_ARGS)
 {
@@ -1625,6 +1711,8 @@ static struct i915_info_sysctl_list {
 	{"i915_gem_pageflip", i915_gem_pageflip_info, NULL, 0},
 	{"i915_gem_request", i915_gem_request_info, NULL, 0},
 	{"i915_gem_seqno", i915_gem_seqno_info, NULL, 0},
+	{"i915_ring_stalls", i915_ring_stall_info, NULL, 0},
+	{"i915_ring_retire", i915_ring_retire_info, NULL, 0},
 	{"i915_gem_fence_regs", i915_gem_fence_regs_info, NULL, 0},
 	{"i915_gem_interrupt", i915_interrupt_info, NULL, 0},
 	{"i915_gem_hws", i915_hws_info, NULL, 0, (void *)RCS},
@@ -1701,6 +1789,8 @@ out:
 
 extern int i915_intr_pf;
 extern long i915_gem_wired_pages_cnt;
+extern long i915_gem_gtt_faults;
+extern long i915_gem_gtt_fault_pages;
 
 int
 i915_sysctl_init(struct drm_device *dev, struct sysctl_ctx_list *ctx,
@@ -1763,6 +1853,22 @@ i915_sysctl_init(struct drm_device *dev, struct sysctl_ctx_list *ctx,
 	    CTLFLAG_RW, &i915_intr_pf, 0, NULL);
 	if (oid == NULL)
 		return (-ENOMEM);
+	oid = SYSCTL_ADD_PROC(ctx, SYSCTL_CHILDREN(top), OID_AUTO,
+	    "fault_around", CTLTYPE_INT | CTLFLAG_RW | CTLFLAG_MPSAFE, dev,
+	    0, i915_fault_around, "I",
+	    "Pages mapped per GTT mmap fault (max 64, 0 or 1 disables)");
+	if (oid == NULL)
+		return (-ENOMEM);
+	oid = SYSCTL_ADD_LONG(ctx, SYSCTL_CHILDREN(info), OID_AUTO,
+	    "i915_gem_gtt_faults", CTLFLAG_RD, &i915_gem_gtt_faults,
+	    "GTT mmap faults");
+	if (oid == NULL)
+		return (-ENOMEM);
+	oid = SYSCTL_ADD_LONG(ctx, SYSCTL_CHILDREN(info), OID_AUTO,
+	    "i915_gem_gtt_fault_pages", CTLFLAG_RD, &i915_gem_gtt_fault_pages,
+	    "Pages mapped by GTT mmap faults");
+	if (oid == NULL)
+		return (-ENOMEM);
 
 	error = drm_add_busid_modesetting(dev, ctx, top);
 	if (error != 0)
@@ -146,6 +146,27 @@ MODULE_PARM_DESC(preliminary_hw_support,
 		"Enable Haswell and ValleyView Support. "
 		"(default: false)");
 
+int i915_render_ring_pages __read_mostly = 32;
+TUNABLE_INT("drm.i915.render_ring_pages", &i915_render_ring_pages);
+module_param_named(render_ring_pages, i915_render_ring_pages, int, 0400);
+MODULE_PARM_DESC(render_ring_pages,
+		"Size of the render ring in pages, a power of two up to 512 "
+		"(default: 32)");
+
+int i915_bsd_ring_pages __read_mostly = 32;
+TUNABLE_INT("drm.i915.bsd_ring_pages", &i915_bsd_ring_pages);
+module_param_named(bsd_ring_pages, i915_bsd_ring_pages, int, 0400);
+MODULE_PARM_DESC(bsd_ring_pages,
+		"Size of the video (BSD) ring in pages, a power of two up to 512 "
+		"(default: 32)");
+
+int i915_blt_ring_pages __read_mostly = 32;
+TUNABLE_INT("drm.i915.blt_ring_pages", &i915_blt_ring_pages);
+module_param_named(blt_ring_pages, i915_blt_ring_pages, int, 0400);
+MODULE_PARM_DESC(blt_ring_pages,
+		"Size of the blitter ring in pages, a power of two up to 512 "
+		"(default: 32)");
+
 int intel_iommu_gfx_mapped = 0;
 TUNABLE_INT("drm.i915.intel_iommu_gfx_mapped", &intel_iommu_gfx_mapped);
 
@@ -860,6 +860,9 @@ typedef struct drm_i915_private {
 		/* storage for physical objects */
 		struct drm_i915_gem_phys_object *phys_objs[I915_MAX_PHYS_OBJECT];
 
+		/** Pages mapped per GTT mmap fault, 0 or 1 maps just one */
+		int fault_around;
+
 		/* accounting, useful for userland debugging */
 		size_t gtt_total;
 		size_t mappable_gtt_total;
@@ -1135,6 +1138,9 @@ struct drm_i915_gem_request {
 	/** Time at which this request was emitted, in jiffies. */
 	unsigned long emitted_jiffies;
 
+	/** Time at which this request was emitted, for retire latency. */
+	sbintime_t emitted_time;
+
 	/** global list entry for this request */
 	struct list_head list;
 
@@ -1286,6 +1292,9 @@ extern int i915_enable_fbc __read_mostly;
 extern int i915_enable_hangcheck __read_mostly;
 extern int i915_enable_ppgtt __read_mostly;
 extern unsigned int i915_preliminary_hw_support __read_mostly;
+extern int i915_render_ring_pages __read_mostly;
+extern int i915_bsd_ring_pages __read_mostly;
+extern int i915_blt_ring_pages __read_mostly;
 
 extern struct drm_driver i915_driver_info;
 extern struct cdev_pager_ops i915_gem_pager_ops;
@@ -1412,6 +1421,7 @@ int i915_gem_get_aperture_ioctl(struct drm_device *dev, void *data,
 int i915_gem_wait_ioctl(struct drm_device *dev, void *data,
 			struct drm_file *file_priv);
 void i915_gem_load(struct drm_device *dev);
+void i915_gem_unload(struct drm_device *dev);
 int i915_gem_init_object(struct drm_gem_object *obj);
 void i915_gem_object_init(struct drm_i915_gem_object *obj,
 			 const struct drm_i915_gem_object_ops *ops);
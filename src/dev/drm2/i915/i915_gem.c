@@ -98,6 +98,9 @@ static int i915_gem_object_get_pages_range(struct drm_i915_gem_object *obj,
 static vm_page_t i915_gem_wire_page(vm_object_t object, vm_pindex_t pindex,
     bool *fresh);
 
+/* Ticks to wait before retrying retirement when struct_mutex is busy. */
+#define	I915_RETIRE_RETRY	max(hz / 50, 1)
+
 MALLOC_DEFINE(DRM_I915_GEM, "i915gem", "Allocations from i915 gem");
 long i915_gem_wired_pages_cnt;
 
@@ -1474,6 +1477,72 @@ i915_gem_pager_ctor(void *handle, vm_ooffset_t size, vm_prot_t prot,
  */
 
 int i915_intr_pf;
+static int i915_gem_fault_around = 16;
+TUNABLE_INT("drm.i915.fault_around", &i915_gem_fault_around);
+long i915_gem_gtt_faults;
+long i915_gem_gtt_fault_pages;
+
+/*
+ * Insert the GTT page backing pidx into vm_obj and busy it.  Only used
+ * for the pages around the faulting one, so give up instead of sleeping
+ * when the page is busy or memory is short.
+ */
+static bool
+i915_gem_pager_insert_page(vm_object_t vm_obj,
+    struct drm_i915_gem_object *obj, vm_pindex_t pidx)
+{
+	drm_i915_private_t *dev_priv = obj->base.dev->dev_private;
+	vm_page_t page;
+
+	page = vm_page_lookup(vm_obj, pidx);
+	if (page == NULL) {
+		page = PHYS_TO_VM_PAGE(dev_priv->mm.gtt_base_addr +
+		    obj->gtt_offset + IDX_TO_OFF(pidx));
+		if (page == NULL || vm_page_busied(page) ||
+		    vm_page_insert(page, vm_obj, pidx))
+			return (false);
+		page->valid = VM_PAGE_BITS_ALL;
+	} else if (vm_page_busied(page))
+		return (false);
+	vm_page_xbusy(page);
+	return (true);
+}
+
+/*
+ * Grow the populated range [*first, *last], which holds the faulting
+ * page, to the aligned window of mm.fault_around pages around it,
+ * clipped to the object.  The object is pinned, in the GTT domain and,
+ * if tiled, covered by its fence as a whole, so every page of the window
+ * can be mapped under this single DRM_LOCK acquisition.
+ */
+static void
+i915_gem_pager_fault_around(vm_object_t vm_obj,
+    struct drm_i915_gem_object *obj, vm_pindex_t pidx, vm_pindex_t *first,
+    vm_pindex_t *last)
+{
+	drm_i915_private_t *dev_priv;
+	vm_pindex_t start, end, idx;
+	int window;
+
+	VM_OBJECT_ASSERT_WLOCKED(vm_obj);
+	dev_priv = obj->base.dev->dev_private;
+	window = min(dev_priv->mm.fault_around, 64);
+	if (window <= 1)
+		return;
+	start = rounddown(pidx, window);
+	end = MIN(start + window, OFF_TO_IDX(obj->base.size)) - 1;
+
+	for (idx = pidx; idx > start; idx--) {
+		if (!i915_gem_pager_insert_page(vm_obj, obj, idx - 1))
+			break;
+	}
+	*first = idx;
+	for (idx = pidx; idx < end; idx++) {
+		if (!i915_gem_pager_insert_page(vm_obj, obj, idx + 1))
+			break;
+	}
+	*last = idx;
+}
 
 static int
 i915_gem_pager_populate(vm_object_t vm_obj, vm_pindex_t pidx, int fault_type,
@@ -1567,6 +1636,7 @@ retry:
 	page->valid = VM_PAGE_BITS_ALL;
 have_page:
 	vm_page_xbusy(page);
+	*first = *last = pidx;
 
 	CTR4(KTR_DRM, "fault %p %jx %x phys %x", gem_obj, pidx, fault_type,
 	    page->phys_addr);
@@ -1575,10 +1645,12 @@ have_page:
 		 * We may have not pinned the object if the page was
 		 * found by the call to vm_page_lookup().
 		 */
+		i915_gem_pager_fault_around(vm_obj, obj, pidx, first, last);
 		i915_gem_object_unpin(obj);
 	}
 	DRM_UNLOCK(dev);
-	*first = *last = pidx;
+	atomic_add_long(&i915_gem_gtt_faults, 1);
+	atomic_add_long(&i915_gem_gtt_fault_pages, *last - *first + 1);
 	return (VM_PAGER_OK);
 
 unpin:
@@ -2274,6 +2346,7 @@ i915_add_request(struct intel_ring_buffer *ring,
 	drm_i915_private_t *dev_priv = ring->dev->dev_private;
 	struct drm_i915_gem_request *request;
 	u32 request_ring_position;
+	u32 seqno;
 	int was_empty;
 	int ret;
 
@@ -2306,12 +2379,12 @@ i915_add_request(struct intel_ring_buffer *ring,
 		return ret;
 	}
 
-	request->seqno = intel_ring_get_seqno(ring);
+	seqno = intel_ring_get_seqno(ring);
+	request->seqno = seqno;
 	request->ring = ring;
 	request->tail = request_ring_position;
 	request->emitted_jiffies = jiffies;
-	was_empty = list_empty(&ring->request_list);
-	list_add_tail(&request->list, &ring->request_list);
+	request->emitted_time = sbinuptime();
 	request->file_priv = NULL;
 
 	if (file) {
@@ -2324,7 +2397,13 @@ i915_add_request(struct intel_ring_buffer *ring,
 		mtx_unlock(&file_priv->mm.lock);
 	}
 
-	CTR2(KTR_DRM, "request_add %s %d", ring->name, request->seqno);
+	/* The retire task may free the request as soon as it is listed. */
+	mtx_lock(&ring->retire_lock);
+	was_empty = list_empty(&ring->request_list);
+	list_add_tail(&request->list, &ring->request_list);
+	mtx_unlock(&ring->retire_lock);
+
+	CTR2(KTR_DRM, "request_add %s %d", ring->name, seqno);
 	ring->outstanding_lazy_request = 0;
 
 	if (!dev_priv->mm.suspended) {
@@ -2340,15 +2419,22 @@ i915_add_request(struct intel_ring_buffer *ring,
 	}
 
 	if (out_seqno)
-		*out_seqno = request->seqno;
+		*out_seqno = seqno;
 	return 0;
 }
 
+/*
+ * Called with the request's retire_lock held, which keeps
+ * i915_gem_release() from clearing request->file_priv and freeing the
+ * file between the unlocked read below and taking mm.lock.
+ */
 static inline void
 i915_gem_request_remove_from_client(struct drm_i915_gem_request *request)
 {
-	struct drm_i915_file_private *file_priv = request->file_priv;
+	struct drm_i915_file_private *file_priv;
 
+	mtx_assert(&request->ring->retire_lock, MA_OWNED);
+	file_priv = request->file_priv;
 	if (!file_priv)
 		return;
 
@@ -2366,6 +2452,7 @@ static void i915_gem_reset_ring_lists(struct drm_i915_private *dev_priv,
 	if (ring->dev != NULL)
 		DRM_LOCK_ASSERT(ring->dev);
 
+	mtx_lock(&ring->retire_lock);
 	while (!list_empty(&ring->request_list)) {
 		struct drm_i915_gem_request *request;
 
@@ -2377,6 +2464,7 @@ static void i915_gem_reset_ring_lists(struct drm_i915_private *dev_priv,
 		i915_gem_request_remove_from_client(request);
 		free(request, DRM_I915_GEM);
 	}
+	mtx_unlock(&ring->retire_lock);
 
 	while (!list_empty(&ring->active_list)) {
 		struct drm_i915_gem_object *obj;
@@ -2434,21 +2522,23 @@ void i915_gem_reset(struct drm_device *dev)
 	i915_gem_reset_fences(dev);
 }
 
-/**
- * This function clears the request list as sequence numbers are passed.
+/*
+ * Free the requests the GPU has passed.  Only the ring's retire_lock is
+ * needed, so the interrupt task can run this without struct_mutex; the
+ * objects those requests kept busy stay on the active list until
+ * i915_gem_retire_requests_ring() is called.  Called with retire_lock
+ * held.
  */
-void
-i915_gem_retire_requests_ring(struct intel_ring_buffer *ring)
+static void
+i915_gem_retire_ring_requests(struct intel_ring_buffer *ring, uint32_t seqno,
+    bool from_irq)
 {
-	uint32_t seqno;
+	struct intel_ring_retire_stats *stats = &ring->retire_stats;
+	sbintime_t now;
+	uint64_t us;
 
-	if (list_empty(&ring->request_list))
-		return;
-
-	WARN_ON(i915_verify_lists(ring->dev));
-
-	seqno = ring->get_seqno(ring, true);
-	CTR2(KTR_DRM, "retire_request_ring %s %d", ring->name, seqno);
+	mtx_assert(&ring->retire_lock, MA_OWNED);
+	now = sbinuptime();
 
 	while (!list_empty(&ring->request_list)) {
 		struct drm_i915_gem_request *request;
@@ -2462,6 +2552,8 @@ i915_gem_retire_requests_ring(struct intel_ring_buffer *ring)
 
 		CTR2(KTR_DRM, "retire_request_seqno_passed %s %d",
 		    ring->name, seqno);
+		DRM_TRACE(ring->dev, DRM_TRACE_RETIRE, ring->id, 0,
+		    request->seqno);
 		/* We know the GPU must have read the request to have
 		 * sent us the seqno + interrupt, so use the position
 		 * of tail of the request to update the last known position
@@ -2469,10 +2561,45 @@ i915_gem_retire_requests_ring(struct intel_ring_buffer *ring)
 		 */
 		ring->last_retired_head = request->tail;
 
+		us = now > request->emitted_time ?
+		    sbttous(now - request->emitted_time) : 0;
+		stats->retired++;
+		if (from_irq)
+			stats->irq_retired++;
+		stats->total_us += us;
+		if (us > stats->max_us)
+			stats->max_us = us;
+		stats->hist[us == 0 ? 0 :
+		    min(flsll(us), I915_RING_STALL_BUCKETS - 1)]++;
+
 		list_del(&request->list);
 		i915_gem_request_remove_from_client(request);
 		free(request, DRM_I915_GEM);
 	}
+}
+
+/**
+ * This function clears the request list as sequence numbers are passed.
+ */
+void
+i915_gem_retire_requests_ring(struct intel_ring_buffer *ring)
+{
+	uint32_t seqno;
+
+	/* The retire task may have freed the requests already and left
+	 * their objects for us.
+	 */
+	if (list_empty(&ring->request_list) && list_empty(&ring->active_list))
+		return;
+
+	WARN_ON(i915_verify_lists(ring->dev));
+
+	seqno = ring->get_seqno(ring, true);
+	CTR2(KTR_DRM, "retire_request_ring %s %d", ring->name, seqno);
+
+	mtx_lock(&ring->retire_lock);
+	i915_gem_retire_ring_requests(ring, seqno, false);
+	mtx_unlock(&ring->retire_lock);
 
 	/* Move any buffers on the active list that are no longer referenced
 	 * by the ringbuffer to the flushing/inactive lists as appropriate.
@@ -2499,6 +2626,51 @@ i915_gem_retire_requests_ring(struct intel_ring_buffer *ring)
 	WARN_ON(i915_verify_lists(ring->dev));
 }
 
+/*
+ * Run from the driver taskqueue whenever a ring reports a new seqno.
+ * Requests are freed straight away; the objects they kept busy are
+ * moved off the active list too if struct_mutex happens to be free,
+ * otherwise the periodic retire work picks them up.
+ */
+static void
+i915_gem_retire_task_handler(void *arg, int pending)
+{
+	struct intel_ring_buffer *ring;
+	struct drm_device *dev;
+	drm_i915_private_t *dev_priv;
+
+	ring = arg;
+	dev = ring->dev;
+	dev_priv = dev->dev_private;
+
+	CTR1(KTR_DRM, "retire_ring_task %s", ring->name);
+
+	/* intel_cleanup_ring_buffer() clears ring->obj under retire_lock
+	 * and drains this task before the status page goes away.
+	 */
+	mtx_lock(&ring->retire_lock);
+	if (ring->obj == NULL) {
+		mtx_unlock(&ring->retire_lock);
+		return;
+	}
+	i915_gem_retire_ring_requests(ring, ring->get_seqno(ring, true), true);
+	mtx_unlock(&ring->retire_lock);
+
+	if (list_empty(&ring->active_list))
+		return;
+	if (!sx_try_xlock(&dev->dev_struct_lock)) {
+		mtx_lock(&ring->retire_lock);
+		ring->retire_stats.contended++;
+		mtx_unlock(&ring->retire_lock);
+		taskqueue_enqueue_timeout(dev_priv->wq,
+		    &dev_priv->mm.retire_work, I915_RETIRE_RETRY);
+		return;
+	}
+	if (ring->obj != NULL)
+		i915_gem_retire_requests_ring(ring);
+	DRM_UNLOCK(dev);
+}
+
 void
 i915_gem_retire_requests(struct drm_device *dev)
 {
@@ -2522,10 +2694,10 @@ i915_gem_retire_work_handler(void *arg, int pending)
 	dev_priv = arg;
 	dev = dev_priv->dev;
 
-	/* Come back later if the device is busy... */
+	/* Come back soon if the device is busy... */
 	if (!sx_try_xlock(&dev->dev_struct_lock)) {
 		taskqueue_enqueue_timeout(dev_priv->wq,
-		    &dev_priv->mm.retire_work, hz);
+		    &dev_priv->mm.retire_work, I915_RETIRE_RETRY);
 		return;
 	}
 
@@ -4437,6 +4609,18 @@ init_ring_lists(struct intel_ring_buffer *ring)
 {
 	INIT_LIST_HEAD(&ring->active_list);
 	INIT_LIST_HEAD(&ring->request_list);
+	mtx_init(&ring->retire_lock, "915rtr", NULL, MTX_DEF);
+	TASK_INIT(&ring->retire_task, 0, i915_gem_retire_task_handler, ring);
+}
+
+void
+i915_gem_unload(struct drm_device *dev)
+{
+	drm_i915_private_t *dev_priv = dev->dev_private;
+	int i;
+
+	for (i = 0; i < I915_NUM_RINGS; i++)
+		mtx_destroy(&dev_priv->ring[i].retire_lock);
 }
 
 void
@@ -4465,6 +4649,7 @@ i915_gem_load(struct drm_device *dev)
 	}
 
 	dev_priv->relative_constants_mode = I915_EXEC_CONSTANTS_REL_GENERAL;
+	dev_priv->mm.fault_around = i915_gem_fault_around;
 
 	/* Old X drivers will take 0-2 for front, back, depth buffers */
 	if (!drm_core_check_feature(dev, DRIVER_MODESET))
@@ -4705,23 +4890,35 @@ i915_gem_phys_pwrite(struct drm_device *dev,
 
 void i915_gem_release(struct drm_device *dev, struct drm_file *file)
 {
+	struct drm_i915_private *dev_priv = dev->dev_private;
 	struct drm_i915_file_private *file_priv = file->driver_priv;
+	struct drm_i915_gem_request *request, *next;
+	struct intel_ring_buffer *ring;
+	int i;
 
 	/* Clean up our request list when the client is going away, so that
 	 * later retire_requests won't dereference our soon-to-be-gone
-	 * file_priv.
+	 * file_priv.  The retire task frees requests without struct_mutex,
+	 * under the ring's retire_lock alone, so unlink each ring's requests
+	 * under that lock: once it is dropped, the task can no longer be
+	 * holding a pointer to this file_priv.
 	 */
-	mtx_lock(&file_priv->mm.lock);
-	while (!list_empty(&file_priv->mm.request_list)) {
-		struct drm_i915_gem_request *request;
-
-		request = list_first_entry(&file_priv->mm.request_list,
-					   struct drm_i915_gem_request,
-					   client_list);
-		list_del(&request->client_list);
-		request->file_priv = NULL;
+	for (i = 0; i < I915_NUM_RINGS; i++) {
+		ring = &dev_priv->ring[i];
+		mtx_lock(&ring->retire_lock);
+		mtx_lock(&file_priv->mm.lock);
+		list_for_each_entry_safe(request, next,
+		    &file_priv->mm.request_list, client_list) {
+			if (request->ring != ring)
+				continue;
+			list_del(&request->client_list);
+			request->file_priv = NULL;
+		}
+		mtx_unlock(&file_priv->mm.lock);
+		mtx_unlock(&ring->retire_lock);
 	}
-	mtx_unlock(&file_priv->mm.lock);
+	KASSERT(list_empty(&file_priv->mm.request_list),
+	    ("i915_gem_release: request left on a closed file"));
 }
 
 static void
@@ -37,18 +37,41 @@ __FBSDID("$FreeBSD$");
 #include <sys/limits.h>
 #include <sys/sf_buf.h>
 
+/*
+ * Objects of an execbuffer, looked up by relocation target handle.  With
+ * I915_EXEC_HANDLE_LUT the handle is the index in the exec list and the
+ * objects are kept in a direct table, marked by a negative and holding
+ * the negated buffer count; otherwise they are hashed by their handle.
+ */
 struct eb_objects {
 	int and;
-	struct hlist_head buckets[0];
+	union {
+		struct drm_i915_gem_object *lut[0];
+		struct hlist_head buckets[0];
+	};
 };
 
 static struct eb_objects *
-eb_create(int size)
+eb_create(struct drm_i915_gem_execbuffer2 *args)
 {
 	struct eb_objects *eb;
-	int count = PAGE_SIZE / sizeof(struct hlist_head) / 2;
+	int count;
+
+	if (args->flags & I915_EXEC_HANDLE_LUT) {
+		eb = malloc(args->buffer_count *
+			     sizeof(struct drm_i915_gem_object *) +
+			     sizeof(struct eb_objects),
+			     DRM_I915_GEM, M_WAITOK | M_ZERO);
+		if (eb == NULL)
+			return eb;
+
+		eb->and = -(int)args->buffer_count;
+		return eb;
+	}
+
+	count = PAGE_SIZE / sizeof(struct hlist_head) / 2;
 	BUILD_BUG_ON_NOT_POWER_OF_2(PAGE_SIZE / sizeof(struct hlist_head));
-	while (count > size)
+	while (count > args->buffer_count)
 		count >>= 1;
 	eb = malloc(count*sizeof(struct hlist_head) +
 		     sizeof(struct eb_objects),
@@ -63,12 +86,19 @@ eb_create(int size)
 static void
 eb_reset(struct eb_objects *eb)
 {
-	memset(eb->buckets, 0, (eb->and+1)*sizeof(struct hlist_head));
+	if (eb->and >= 0)
+		memset(eb->buckets, 0, (eb->and+1)*sizeof(struct hlist_head));
 }
 
 static void
-eb_add_object(struct eb_objects *eb, struct drm_i915_gem_object *obj)
+eb_add_object(struct eb_objects *eb, struct drm_i915_gem_object *obj,
+	      int index)
 {
+	if (eb->and < 0) {
+		eb->lut[index] = obj;
+		return;
+	}
+
 	hlist_add_head(&obj->exec_node,
 		       &eb->buckets[obj->exec_handle & eb->and]);
 }
@@ -80,6 +110,12 @@ eb_get_object(struct eb_objects *eb, unsigned long handle)
 	struct hlist_node *node;
 	struct drm_i915_gem_object *obj;
 
+	if (eb->and < 0) {
+		if (handle >= -eb->and)
+			return NULL;
+		return eb->lut[handle];
+	}
+
 	head = &eb->buckets[handle & eb->and];
 	hlist_for_each(node, head) {
 		obj = hlist_entry(node, struct drm_i915_gem_object, exec_node);
@@ -343,7 +379,8 @@ need_reloc_mappable(struct drm_i915_gem_object *obj)
 
 static int
 i915_gem_execbuffer_reserve_object(struct drm_i915_gem_object *obj,
-				   struct intel_ring_buffer *ring)
+				   struct intel_ring_buffer *ring,
+				   bool *need_relocs)
 {
 	struct drm_i915_private *dev_priv = obj->base.dev->dev_private;
 	struct drm_i915_gem_exec_object2 *entry = obj->exec_entry;
@@ -384,7 +421,17 @@ i915_gem_execbuffer_reserve_object(struct drm_i915_gem_object *obj,
 		obj->has_aliasing_ppgtt_mapping = 1;
 	}
 
-	entry->offset = obj->gtt_offset;
+	/* The presumed offsets in the batch are stale if the object moved */
+	if (entry->offset != obj->gtt_offset) {
+		entry->offset = obj->gtt_offset;
+		*need_relocs = true;
+	}
+
+	if (entry->flags & EXEC_OBJECT_WRITE) {
+		obj->base.pending_read_domains = I915_GEM_DOMAIN_RENDER;
+		obj->base.pending_write_domain = I915_GEM_DOMAIN_RENDER;
+	}
+
 	return 0;
 }
 
@@ -410,7 +457,8 @@ i915_gem_execbuffer_unreserve_object(struct drm_i915_gem_object *obj)
 static int
 i915_gem_execbuffer_reserve(struct intel_ring_buffer *ring,
 			    struct drm_file *file,
-			    struct list_head *objects)
+			    struct list_head *objects,
+			    bool *need_relocs)
 {
 	struct drm_i915_gem_object *obj;
 	struct list_head ordered_objects;
@@ -478,7 +526,8 @@ i915_gem_execbuffer_reserve(struct intel_ring_buffer *ring,
 			    (need_mappable && !obj->map_and_fenceable))
 				ret = i915_gem_object_unbind(obj);
 			else
-				ret = i915_gem_execbuffer_reserve_object(obj, ring);
+				ret = i915_gem_execbuffer_reserve_object(obj,
+				    ring, need_relocs);
 			if (ret)
 				goto err;
 		}
@@ -488,7 +537,8 @@ i915_gem_execbuffer_reserve(struct intel_ring_buffer *ring,
 			if (obj->gtt_space)
 				continue;
 
-			ret = i915_gem_execbuffer_reserve_object(obj, ring);
+			ret = i915_gem_execbuffer_reserve_object(obj, ring,
+			    need_relocs);
 			if (ret)
 				goto err;
 		}
@@ -512,13 +562,15 @@ i915_gem_execbuffer_relocate_slow(struct drm_device *dev,
 				  struct intel_ring_buffer *ring,
 				  struct list_head *objects,
 				  struct eb_objects *eb,
-				  struct drm_i915_gem_exec_object2 *exec,
-				  int count)
+				  struct drm_i915_gem_execbuffer2 *args,
+				  struct drm_i915_gem_exec_object2 *exec)
 {
 	struct drm_i915_gem_relocation_entry *reloc;
 	struct drm_i915_gem_object *obj;
+	bool need_relocs;
 	int *reloc_offset;
 	int i, total, ret;
+	int count = args->buffer_count;
 
 	/* We may process another execbuffer during the unlock... */
 	while (!list_empty(objects)) {
@@ -603,10 +655,11 @@ i915_gem_execbuffer_relocate_slow(struct drm_device *dev,
 		list_add_tail(&obj->exec_list, objects);
 		obj->exec_handle = exec[i].handle;
 		obj->exec_entry = &exec[i];
-		eb_add_object(eb, obj);
+		eb_add_object(eb, obj, i);
 	}
 
-	ret = i915_gem_execbuffer_reserve(ring, file, objects);
+	need_relocs = (args->flags & I915_EXEC_NO_RELOC) == 0;
+	ret = i915_gem_execbuffer_reserve(ring, file, objects, &need_relocs);
 	if (ret)
 		goto err;
 
@@ -778,8 +831,12 @@ i915_gem_execbuffer_move_to_active(struct list_head *objects,
 		u32 old_write = obj->base.write_domain;
 #endif
 
-		obj->base.read_domains = obj->base.pending_read_domains;
 		obj->base.write_domain = obj->base.pending_write_domain;
+		/* Without relocations nothing was collected for objects
+		 * only read, keep what the GPU may still be reading. */
+		if (obj->base.write_domain == 0)
+			obj->base.pending_read_domains |= obj->base.read_domains;
+		obj->base.read_domains = obj->base.pending_read_domains;
 		obj->fenced_gpu_access = obj->pending_fenced_gpu_access;
 
 		i915_gem_object_move_to_active(obj, ring);
@@ -848,10 +905,15 @@ i915_gem_do_execbuffer(struct drm_device *dev, void *data,
 	u32 exec_start, exec_len;
 	u32 mask;
 	u32 flags;
+	u32 trace_id;
+	bool need_relocs;
 	int ret, mode, i;
 	vm_page_t **relocs_ma;
 	int *relocs_len;
 
+	trace_id = DRM_TRACE_ID(dev);
+	DRM_TRACE(dev, DRM_TRACE_SUBMIT, -1, trace_id, 0);
+
 	if (!i915_gem_check_execbuffer(args)) {
 		DRM_DEBUG("execbuf with invalid offset/length\n");
 		return -EINVAL;
@@ -992,7 +1054,7 @@ i915_gem_do_execbuffer(struct drm_device *dev, void *data,
 		goto pre_mutex_err;
 	}
 
-	eb = eb_create(args->buffer_count);
+	eb = eb_create(args);
 	if (eb == NULL) {
 		DRM_UNLOCK(dev);
 		ret = -ENOMEM;
@@ -1024,7 +1086,7 @@ i915_gem_do_execbuffer(struct drm_device *dev, void *data,
 		list_add_tail(&obj->exec_list, &objects);
 		obj->exec_handle = exec[i].handle;
 		obj->exec_entry = &exec[i];
-		eb_add_object(eb, obj);
+		eb_add_object(eb, obj, i);
 	}
 
 	/* take note of the batch buffer before we might reorder the lists */
@@ -1033,23 +1095,28 @@ i915_gem_do_execbuffer(struct drm_device *dev, void *data,
 			       exec_list);
 
 	/* Move the objects en-masse into the GTT, evicting if necessary. */
-	ret = i915_gem_execbuffer_reserve(ring, file, &objects);
+	need_relocs = (args->flags & I915_EXEC_NO_RELOC) == 0;
+	ret = i915_gem_execbuffer_reserve(ring, file, &objects, &need_relocs);
 	if (ret)
 		goto err;
+	DRM_TRACE(dev, DRM_TRACE_VALIDATE, ring->id, trace_id, 0);
 
-	/* The objects are in their final locations, apply the relocations. */
-	ret = i915_gem_execbuffer_relocate(dev, eb, &objects);
+	/* The objects are in their final locations, apply the relocations.
+	 * With I915_EXEC_NO_RELOC this is skipped when every object is
+	 * still bound where userspace presumed it to be. */
+	if (need_relocs)
+		ret = i915_gem_execbuffer_relocate(dev, eb, &objects);
 	if (ret) {
 		if (ret == -EFAULT) {
 			ret = i915_gem_execbuffer_relocate_slow(dev, file, ring,
 								&objects, eb,
-								exec,
-								args->buffer_count);
+								args, exec);
 			DRM_LOCK_ASSERT(dev);
 		}
 		if (ret)
 			goto err;
 	}
+	DRM_TRACE(dev, DRM_TRACE_RELOC, ring->id, trace_id, 0);
 
 	/* Set the pending read domains for the batch buffer to COMMAND */
 	if (batch_obj->base.pending_write_domain) {
@@ -1120,6 +1187,8 @@ i915_gem_do_execbuffer(struct drm_device *dev, void *data,
 
 	CTR3(KTR_DRM, "ring_dispatch ring=%s seqno=%d flags=%u", ring->name,
 	    intel_ring_get_seqno(ring), flags);
+	DRM_TRACE(dev, DRM_TRACE_EMIT, ring->id, trace_id,
+	    intel_ring_get_seqno(ring));
 
 	i915_gem_execbuffer_move_to_active(&objects, ring);
 	i915_gem_execbuffer_retire_commands(dev, file, ring);
@@ -353,8 +353,12 @@ static void notify_ring(struct drm_device *dev,
 		return;
 
 	CTR2(KTR_DRM, "request_complete %s %d", ring->name, ring->get_seqno(ring, false));
+	DRM_TRACE(dev, DRM_TRACE_SIGNAL, ring->id, 0,
+	    ring->get_seqno(ring, false));
 
 	wake_up_all(&ring->irq_queue);
+	if (!list_empty(&ring->request_list))
+		taskqueue_enqueue(dev_priv->wq, &ring->retire_task);
 	if (i915_enable_hangcheck) {
 		dev_priv->hangcheck_count = 0;
 		callout_schedule(&dev_priv->hangcheck_timer,
@@ -1184,8 +1188,10 @@ static void i915_gem_record_rings(struct drm_device *dev,
 			i915_error_object_create(dev_priv, ring->obj);
 
 		count = 0;
+		mtx_lock(&ring->retire_lock);
 		list_for_each_entry(request, &ring->request_list, list)
 			count++;
+		mtx_unlock(&ring->retire_lock);
 
 		error->ring[i].num_requests = count;
 		error->ring[i].requests =
@@ -1197,14 +1203,19 @@ static void i915_gem_record_rings(struct drm_device *dev,
 		}
 
 		count = 0;
+		mtx_lock(&ring->retire_lock);
 		list_for_each_entry(request, &ring->request_list, list) {
 			struct drm_i915_error_request *erq;
 
+			if (count == error->ring[i].num_requests)
+				break;
 			erq = &error->ring[i].requests[count++];
 			erq->seqno = request->seqno;
 			erq->jiffies = request->emitted_jiffies;
 			erq->tail = request->tail;
 		}
+		mtx_unlock(&ring->retire_lock);
+		error->ring[i].num_requests = count;
 	}
 }
 
@@ -1666,9 +1677,14 @@ ring_last_seqno(struct intel_ring_buffer *ring)
 
 static bool i915_hangcheck_ring_idle(struct intel_ring_buffer *ring, bool *err)
 {
-	if (list_empty(&ring->request_list) ||
+	bool idle;
+
+	mtx_lock(&ring->retire_lock);
+	idle = list_empty(&ring->request_list) ||
 	    i915_seqno_passed(ring->get_seqno(ring, false),
-			      ring_last_seqno(ring))) {
+			      ring_last_seqno(ring));
+	mtx_unlock(&ring->retire_lock);
+	if (idle) {
 		/* Issue a wake-up to catch stuck h/w. */
 		sleepq_lock(&ring->irq_queue);
 		if (sleepq_sleepcnt(&ring->irq_queue, 0) != 0) {
@@ -1154,6 +1154,34 @@ static int init_phys_hws_pga(struct intel_ring_buffer *ring)
 	return 0;
 }
 
+/*
+ * Ring size from the drm.i915.*_ring_pages tunables.  The tail wraps with
+ * a mask and RING_CTL holds at most 512 pages, so round down to a power
+ * of two in that range.
+ */
+static int intel_ring_pages(struct intel_ring_buffer *ring)
+{
+	int pages;
+
+	switch (ring->id) {
+	case VCS:
+		pages = i915_bsd_ring_pages;
+		break;
+	case BCS:
+		pages = i915_blt_ring_pages;
+		break;
+	default:
+		pages = i915_render_ring_pages;
+		break;
+	}
+
+	if (pages < 1)
+		pages = 1;
+	else if (pages > RING_NR_PAGES / PAGE_SIZE + 1)
+		pages = RING_NR_PAGES / PAGE_SIZE + 1;
+	return (1 << (fls(pages) - 1));
+}
+
 static int intel_init_ring_buffer(struct drm_device *dev,
 				  struct intel_ring_buffer *ring)
 {
@@ -1164,7 +1192,9 @@ static int intel_init_ring_buffer(struct drm_device *dev,
 	ring->dev = dev;
 	INIT_LIST_HEAD(&ring->active_list);
 	INIT_LIST_HEAD(&ring->request_list);
-	ring->size = 32 * PAGE_SIZE;
+	ring->size = intel_ring_pages(ring) * PAGE_SIZE;
+	memset(&ring->stall_stats, 0, sizeof(ring->stall_stats));
+	memset(&ring->retire_stats, 0, sizeof(ring->retire_stats));
 	memset(ring->sync_seqno, 0, sizeof(ring->sync_seqno));
 
 #ifdef __linux__
@@ -1238,6 +1268,7 @@ err_hws:
 void intel_cleanup_ring_buffer(struct intel_ring_buffer *ring)
 {
 	struct drm_i915_private *dev_priv;
+	struct drm_i915_gem_object *obj;
 	int ret;
 
 	if (ring->obj == NULL)
@@ -1250,13 +1281,26 @@ void intel_cleanup_ring_buffer(struct intel_ring_buffer *ring)
 		DRM_ERROR("failed to quiesce %s whilst cleaning up: %d\n",
 			  ring->name, ret);
 
+	/* Stop the retire task before the status page it reads goes away;
+	 * it checks ring->obj under retire_lock and only try-locks
+	 * struct_mutex, so draining it here cannot deadlock.
+	 */
+	mtx_lock(&ring->retire_lock);
+	obj = ring->obj;
+	ring->obj = NULL;
+	mtx_unlock(&ring->retire_lock);
+	if (dev_priv->wq != NULL) {
+		while (taskqueue_cancel(dev_priv->wq, &ring->retire_task,
+		    NULL) != 0)
+			taskqueue_drain(dev_priv->wq, &ring->retire_task);
+	}
+
 	I915_WRITE_CTL(ring, 0);
 
 	pmap_unmapdev((vm_offset_t)ring->virtual_start, ring->size);
 
-	i915_gem_object_unpin(ring->obj);
-	drm_gem_object_unreference(&ring->obj->base);
-	ring->obj = NULL;
+	i915_gem_object_unpin(obj);
+	drm_gem_object_unreference(&obj->base);
 
 	if (ring->cleanup)
 		ring->cleanup(ring);
@@ -1283,12 +1327,15 @@ static int intel_ring_wait_request(struct intel_ring_buffer *ring, int n)
 
 	i915_gem_retire_requests_ring(ring);
 
+	mtx_lock(&ring->retire_lock);
 	if (ring->last_retired_head != -1) {
 		ring->head = ring->last_retired_head;
 		ring->last_retired_head = -1;
 		ring->space = ring_space(ring);
-		if (ring->space >= n)
+		if (ring->space >= n) {
+			mtx_unlock(&ring->retire_lock);
 			return 0;
+		}
 	}
 
 	list_for_each_entry(request, &ring->request_list, list) {
@@ -1312,6 +1359,7 @@ static int intel_ring_wait_request(struct intel_ring_buffer *ring, int n)
 		 */
 		request->tail = -1;
 	}
+	mtx_unlock(&ring->retire_lock);
 
 	if (seqno == 0)
 		return -ENOSPC;
@@ -1320,11 +1368,15 @@ static int intel_ring_wait_request(struct intel_ring_buffer *ring, int n)
 	if (ret)
 		return ret;
 
-	if (WARN_ON(ring->last_retired_head == -1))
+	mtx_lock(&ring->retire_lock);
+	if (WARN_ON(ring->last_retired_head == -1)) {
+		mtx_unlock(&ring->retire_lock);
 		return -ENOSPC;
+	}
 
 	ring->head = ring->last_retired_head;
 	ring->last_retired_head = -1;
+	mtx_unlock(&ring->retire_lock);
 	ring->space = ring_space(ring);
 	if (WARN_ON(ring->space < n))
 		return -ENOSPC;
@@ -1332,18 +1384,36 @@ static int intel_ring_wait_request(struct intel_ring_buffer *ring, int n)
 	return 0;
 }
 
-static int ring_wait_for_space(struct intel_ring_buffer *ring, int n)
+/*
+ * No request frees enough space, so wait for the ring HEAD itself to pass
+ * the offset we need.  While requests are outstanding, sleep on the ring's
+ * user interrupt until the newest of them completes: HEAD has then passed
+ * its tail, and only what was emitted after it is left.  Without a
+ * request to wait for (DRI1, or nothing queued yet) wake every tick and
+ * re-read HEAD.  The one tick timeout also covers a missed wakeup.
+ */
+static int ring_wait_for_head(struct intel_ring_buffer *ring, int n)
 {
 	struct drm_device *dev = ring->dev;
 	struct drm_i915_private *dev_priv = dev->dev_private;
+	struct intel_ring_stall_stats *stats = &ring->stall_stats;
 	unsigned long end;
+	u32 target, seqno;
+	bool irq;
 	int ret;
 
-	ret = intel_ring_wait_request(ring, n);
-	if (ret != -ENOSPC)
-		return ret;
+	target = (ring->tail + I915_RING_FREE_SPACE + n) & (ring->size - 1);
+	seqno = 0;
+	mtx_lock(&ring->retire_lock);
+	if (!list_empty(&ring->request_list))
+		seqno = list_entry(ring->request_list.prev,
+				   struct drm_i915_gem_request,
+				   list)->seqno;
+	mtx_unlock(&ring->retire_lock);
+	CTR3(KTR_DRM, "ring_wait_begin %s head %x seqno %d", ring->name,
+	    target, seqno);
+	stats->head_waits++;
 
-	CTR1(KTR_DRM, "ring_wait_begin %s", ring->name);
 	/* With GEM the hangcheck timer should kick us out of the loop,
 	 * leaving it early runs the risk of corrupting GEM state (due
 	 * to running on almost untested codepaths). But on resume
@@ -1351,12 +1421,14 @@ static int ring_wait_for_space(struct intel_ring_buffer *ring, int n)
 	 * case by choosing an insanely large timeout. */
 	end = jiffies + 60 * HZ;
 
+	irq = ring->irq_get(ring);
 	do {
 		ring->head = I915_READ_HEAD(ring);
 		ring->space = ring_space(ring);
 		if (ring->space >= n) {
 			CTR1(KTR_DRM, "ring_wait_end %s", ring->name);
-			return 0;
+			ret = 0;
+			goto out;
 		}
 
 		if (dev->primary->master) {
@@ -1365,16 +1437,65 @@ static int ring_wait_for_space(struct intel_ring_buffer *ring, int n)
 				master_priv->sarea_priv->perf_boxes |= I915_BOX_WAIT;
 		}
 
-		DRM_MSLEEP(1);
+		if (irq) {
+			mtx_lock(&dev_priv->irq_lock);
+			for (;;) {
+				if (seqno != 0 &&
+				    (i915_seqno_passed(ring->get_seqno(ring,
+				    false), seqno) ||
+				    atomic_read(&dev_priv->mm.wedged) ||
+				    time_after(jiffies, end)))
+					break;
+				ret = msleep(&ring->irq_queue,
+				    &dev_priv->irq_lock, 0, "915rsp", 1);
+				if (ret == 0)
+					stats->irq_wakeups++;
+				else
+					stats->timeouts++;
+				if (seqno == 0)
+					break;
+			}
+			mtx_unlock(&dev_priv->irq_lock);
+			seqno = 0;
+		} else
+			DRM_MSLEEP(1);
 
 		ret = i915_gem_check_wedge(dev_priv, dev_priv->mm.interruptible);
 		if (ret) {
 			CTR1(KTR_DRM, "ring_wait_end %s wedged", ring->name);
-			return ret;
+			goto out;
 		}
 	} while (!time_after(jiffies, end));
 	CTR1(KTR_DRM, "ring_wait_end %s busy", ring->name);
-	return -EBUSY;
+	ret = -EBUSY;
+out:
+	if (irq)
+		ring->irq_put(ring);
+	return ret;
+}
+
+static int ring_wait_for_space(struct intel_ring_buffer *ring, int n)
+{
+	struct intel_ring_stall_stats *stats = &ring->stall_stats;
+	sbintime_t start;
+	uint64_t us;
+	int ret;
+
+	start = sbinuptime();
+	stats->stalls++;
+
+	ret = intel_ring_wait_request(ring, n);
+	if (ret == -ENOSPC)
+		ret = ring_wait_for_head(ring, n);
+
+	us = sbttous(sbinuptime() - start);
+	stats->total_us += us;
+	if (us > stats->max_us)
+		stats->max_us = us;
+	stats->hist[us == 0 ? 0 :
+	    min(flsll(us), I915_RING_STALL_BUCKETS - 1)]++;
+
+	return ret;
 }
 
 static int intel_wrap_ring_buffer(struct intel_ring_buffer *ring)
@@ -1412,12 +1533,16 @@ int intel_ring_idle(struct intel_ring_buffer *ring)
 	}
 
 	/* Wait upon the last request to be completed */
-	if (list_empty(&ring->request_list))
+	mtx_lock(&ring->retire_lock);
+	if (list_empty(&ring->request_list)) {
+		mtx_unlock(&ring->retire_lock);
 		return 0;
+	}
 
 	seqno = list_entry(ring->request_list.prev,
 			   struct drm_i915_gem_request,
 			   list)->seqno;
+	mtx_unlock(&ring->retire_lock);
 
 	return i915_wait_seqno(ring, seqno);
 }
@@ -40,6 +40,35 @@ struct  intel_hw_status_page {
 #define I915_READ_SYNC_0(ring) I915_READ(RING_SYNC_0((ring)->mmio_base))
 #define I915_READ_SYNC_1(ring) I915_READ(RING_SYNC_1((ring)->mmio_base))
 
+/*
+ * Ring-full stalls seen by intel_ring_begin().  Wait times go into log2
+ * microsecond buckets, the last bucket collecting everything longer.
+ */
+#define I915_RING_STALL_BUCKETS 20
+
+struct intel_ring_stall_stats {
+	uint64_t	stalls;		/* waits for ring space */
+	uint64_t	head_waits;	/* ... that had no request to wait on */
+	uint64_t	irq_wakeups;	/* head_waits sleeps ended by an interrupt */
+	uint64_t	timeouts;	/* head_waits sleeps that timed out */
+	uint64_t	total_us;
+	uint64_t	max_us;
+	uint64_t	hist[I915_RING_STALL_BUCKETS];
+};
+
+/*
+ * Request retirement, timed from emission to the request being freed.
+ * Latencies use the same log2 microsecond buckets as the stall stats.
+ */
+struct intel_ring_retire_stats {
+	uint64_t	retired;	/* requests freed */
+	uint64_t	irq_retired;	/* ... by the interrupt task */
+	uint64_t	contended;	/* task runs that left objects active */
+	uint64_t	total_us;
+	uint64_t	max_us;
+	uint64_t	hist[I915_RING_STALL_BUCKETS];
+};
+
 struct  intel_ring_buffer {
 	const char	*name;
 	enum intel_ring_id {
@@ -119,9 +148,14 @@ struct  intel_ring_buffer {
 
 	/**
 	 * List of breadcrumbs associated with GPU requests currently
-	 * outstanding.
+	 * outstanding.  Protected by retire_lock, which the interrupt
+	 * task takes to free passed requests without struct_mutex.
+	 * last_retired_head and retire_stats are covered by it too.
 	 */
 	struct list_head request_list;
+	struct mtx retire_lock;
+	struct task retire_task;
+	struct intel_ring_retire_stats retire_stats;
 
 	/**
 	 * Do we have some not yet emitted requests outstanding?
@@ -131,6 +165,13 @@ struct  intel_ring_buffer {
 
 	wait_queue_head_t irq_queue;
 
+	/*
+	 * Updated by whoever is emitting to the ring: GEM holds struct_mutex,
+	 * but DRI1 BEGIN_LP_RING users may only hold dev->ioctl_lock.  The
+	 * stats are advisory and readers may see them torn.
+	 */
+	struct intel_ring_stall_stats stall_stats;
+
 	/**
 	 * Do an explicit TLB flush before MI_SET_CONTEXT
 	 */
@@ -60,7 +60,72 @@ typedef struct {
 	bool abort;
 } atom_exec_context;
 
+/*
+ * Decoded command tables.  The first execution of a command table
+ * decodes its instruction stream once and keeps it in the context.
+ * Later executions run the arithmetic, logic and jump opcodes from the
+ * decoded operands, without parsing operand bytes or dispatching on
+ * operand encodings again.  Other opcodes go through their opcode_table
+ * handler.
+ *
+ * Decoding is linear from the start of the code, so an instruction is
+ * decoded exactly as the byte interpreter would read it from the same
+ * offset.  A jump to an offset that is not a decoded instruction
+ * boundary continues in the byte interpreter.  The cache lives as long
+ * as the BIOS image it was decoded from; a reloaded BIOS gets a new
+ * context from atom_parse().
+ */
+enum {
+	ATOM_INSN_CALL,		/* run the opcode_table handler */
+	ATOM_INSN_ADD,
+	ATOM_INSN_AND,
+	ATOM_INSN_OR,
+	ATOM_INSN_XOR,
+	ATOM_INSN_SUB,
+	ATOM_INSN_MOVE,
+	ATOM_INSN_MUL,
+	ATOM_INSN_DIV,
+	ATOM_INSN_COMPARE,
+	ATOM_INSN_TEST,
+	ATOM_INSN_MASK,
+	ATOM_INSN_CLEAR,
+	ATOM_INSN_SHIFT_LEFT,
+	ATOM_INSN_SHIFT_RIGHT,
+	ATOM_INSN_SHL,
+	ATOM_INSN_SHR,
+	ATOM_INSN_JUMP,
+	/* run through opcode_table, differing only in operand length */
+	ATOM_INSN_SETPORT,
+	ATOM_INSN_SETREGBLOCK,
+	ATOM_INSN_SETFBBASE,
+	ATOM_INSN_SWITCH,
+	ATOM_INSN_BYTE,		/* one immediate byte */
+};
+
+struct atom_insn {
+	int offset;		/* of the opcode byte */
+	int next;		/* offset of the following instruction */
+	uint8_t op;
+	uint8_t kind;
+	uint8_t arg;		/* opcode_table argument */
+	uint8_t attr;
+	uint8_t dst_align;
+	int target;		/* decoded jump target, -1 if not decoded */
+	uint32_t dst;		/* destination index */
+	uint32_t src;		/* source index or immediate */
+	uint32_t aux;		/* mask, shift count or jump offset */
+};
+
+struct atom_decoded_table {
+	int count;
+	int end;		/* offset where decoding stopped */
+	struct atom_insn insns[];
+};
+
+#define ATOM_DECODED_CNT	256
+
 int atom_debug = 0;
+int atom_decode = 1;
 static int atom_execute_table_locked(struct atom_context *ctx, int index, uint32_t * params);
 
 static uint32_t atom_arg_mask[8] =
@@ -171,17 +236,58 @@ static uint32_t atom_iio_execute(struct atom_context *ctx, int base,
 		}
 }
 
-static uint32_t atom_get_src_int(atom_exec_context *ctx, uint8_t attr,
-				 int *ptr, uint32_t *saved, int print)
+static int atom_arg_len(int arg, int align)
 {
-	uint32_t idx, val = 0xCDCDCDCD, align, arg;
-	struct atom_context *gctx = ctx->ctx;
-	arg = attr & 7;
-	align = (attr >> 3) & 7;
 	switch (arg) {
 	case ATOM_ARG_REG:
-		idx = U16(*ptr);
+	case ATOM_ARG_ID:
+		return 2;
+	case ATOM_ARG_IMM:
+		switch (align) {
+		case ATOM_SRC_DWORD:
+			return 4;
+		case ATOM_SRC_WORD0:
+		case ATOM_SRC_WORD8:
+		case ATOM_SRC_WORD16:
+			return 2;
+		default:
+			return 1;
+		}
+	default:
+		return 1;
+	}
+}
+
+/* fetch the index or immediate value of an operand from the table */
+static uint32_t atom_fetch_arg(struct atom_context *ctx, int arg, int align,
+			       int *ptr)
+{
+	uint32_t val;
+
+	switch (atom_arg_len(arg, align)) {
+	case 4:
+		val = CU32(*ptr);
+		(*ptr) += 4;
+		break;
+	case 2:
+		val = CU16(*ptr);
 		(*ptr) += 2;
+		break;
+	default:
+		val = CU8(*ptr);
+		(*ptr)++;
+		break;
+	}
+	return val;
+}
+
+static uint32_t atom_read_arg(atom_exec_context *ctx, int arg, int align,
+			      uint32_t idx, uint32_t *saved, int print)
+{
+	uint32_t val = 0xCDCDCDCD;
+	struct atom_context *gctx = ctx->ctx;
+	switch (arg) {
+	case ATOM_ARG_REG:
 		if (print)
 			ATOM_DEBUG_PRINT("REG[0x%04X]", idx);
 		idx += gctx->reg_block;
@@ -215,8 +321,6 @@ static uint32_t atom_get_src_int(atom_exec_context *ctx, uint8_t attr,
 		}
 		break;
 	case ATOM_ARG_PS:
-		idx = U8(*ptr);
-		(*ptr)++;
 		/* get_unaligned_le32 avoids unaligned accesses from atombios
 		 * tables, noticed on a DEC Alpha. */
 		val = get_unaligned_le32((u32 *)&ctx->ps[idx]);
@@ -224,8 +328,6 @@ static uint32_t atom_get_src_int(atom_exec_context *ctx, uint8_t attr,
 			ATOM_DEBUG_PRINT("PS[0x%02X,0x%04X]", idx, val);
 		break;
 	case ATOM_ARG_WS:
-		idx = U8(*ptr);
-		(*ptr)++;
 		if (print)
 			ATOM_DEBUG_PRINT("WS[0x%02X]", idx);
 		switch (idx) {
@@ -261,8 +363,6 @@ static uint32_t atom_get_src_int(atom_exec_context *ctx, uint8_t attr,
 		}
 		break;
 	case ATOM_ARG_ID:
-		idx = U16(*ptr);
-		(*ptr) += 2;
 		if (print) {
 			if (gctx->data_block)
 				ATOM_DEBUG_PRINT("ID[0x%04X+%04X]", idx, gctx->data_block);
@@ -272,8 +372,6 @@ static uint32_t atom_get_src_int(atom_exec_context *ctx, uint8_t attr,
 		val = U32(idx + gctx->data_block);
 		break;
 	case ATOM_ARG_FB:
-		idx = U8(*ptr);
-		(*ptr)++;
 		if ((gctx->fb_base + (idx * 4)) > gctx->scratch_size_bytes) {
 			DRM_ERROR("ATOM: fb read beyond scratch region: %d vs. %d\n",
 				  gctx->fb_base + (idx * 4), gctx->scratch_size_bytes);
@@ -284,18 +382,15 @@ static uint32_t atom_get_src_int(atom_exec_context *ctx, uint8_t attr,
 			ATOM_DEBUG_PRINT("FB[0x%02X]", idx);
 		break;
 	case ATOM_ARG_IMM:
+		val = idx;
 		switch (align) {
 		case ATOM_SRC_DWORD:
-			val = U32(*ptr);
-			(*ptr) += 4;
 			if (print)
 				ATOM_DEBUG_PRINT("IMM 0x%08X\n", val);
 			return val;
 		case ATOM_SRC_WORD0:
 		case ATOM_SRC_WORD8:
 		case ATOM_SRC_WORD16:
-			val = U16(*ptr);
-			(*ptr) += 2;
 			if (print)
 				ATOM_DEBUG_PRINT("IMM 0x%04X\n", val);
 			return val;
@@ -303,23 +398,17 @@ static uint32_t atom_get_src_int(atom_exec_context *ctx, uint8_t attr,
 		case ATOM_SRC_BYTE8:
 		case ATOM_SRC_BYTE16:
 		case ATOM_SRC_BYTE24:
-			val = U8(*ptr);
-			(*ptr)++;
 			if (print)
 				ATOM_DEBUG_PRINT("IMM 0x%02X\n", val);
 			return val;
 		}
 		return 0;
 	case ATOM_ARG_PLL:
-		idx = U8(*ptr);
-		(*ptr)++;
 		if (print)
 			ATOM_DEBUG_PRINT("PLL[0x%02X]", idx);
 		val = gctx->card->pll_read(gctx->card, idx);
 		break;
 	case ATOM_ARG_MC:
-		idx = U8(*ptr);
-		(*ptr)++;
 		if (print)
 			ATOM_DEBUG_PRINT("MC[0x%02X]", idx);
 		val = gctx->card->mc_read(gctx->card, idx);
@@ -395,6 +484,16 @@ static void atom_skip_src_int(atom_exec_context *ctx, uint8_t attr, int *ptr)
 	}
 }
 
+static uint32_t atom_get_src_int(atom_exec_context *ctx, uint8_t attr,
+				 int *ptr, uint32_t *saved, int print)
+{
+	uint32_t idx, align, arg;
+	arg = attr & 7;
+	align = (attr >> 3) & 7;
+	idx = atom_fetch_arg(ctx->ctx, arg, align, ptr);
+	return atom_read_arg(ctx, arg, align, idx, saved, print);
+}
+
 static uint32_t atom_get_src(atom_exec_context *ctx, uint8_t attr, int *ptr)
 {
 	return atom_get_src_int(ctx, attr, ptr, NULL, 1);
@@ -402,28 +501,7 @@ static uint32_t atom_get_src(atom_exec_context *ctx, uint8_t attr, int *ptr)
 
 static uint32_t atom_get_src_direct(atom_exec_context *ctx, uint8_t align, int *ptr)
 {
-	uint32_t val = 0xCDCDCDCD;
-
-	switch (align) {
-	case ATOM_SRC_DWORD:
-		val = U32(*ptr);
-		(*ptr) += 4;
-		break;
-	case ATOM_SRC_WORD0:
-	case ATOM_SRC_WORD8:
-	case ATOM_SRC_WORD16:
-		val = U16(*ptr);
-		(*ptr) += 2;
-		break;
-	case ATOM_SRC_BYTE0:
-	case ATOM_SRC_BYTE8:
-	case ATOM_SRC_BYTE16:
-	case ATOM_SRC_BYTE24:
-		val = U8(*ptr);
-		(*ptr)++;
-		break;
-	}
-	return val;
+	return atom_fetch_arg(ctx->ctx, ATOM_ARG_IMM, align, ptr);
 }
 
 static uint32_t atom_get_dst(atom_exec_context *ctx, int arg, uint8_t attr,
@@ -442,12 +520,10 @@ static void atom_skip_dst(atom_exec_context *ctx, int arg, uint8_t attr, int *pt
 								 3] << 3, ptr);
 }
 
-static void atom_put_dst(atom_exec_context *ctx, int arg, uint8_t attr,
-			 int *ptr, uint32_t val, uint32_t saved)
+static void atom_write_arg(atom_exec_context *ctx, int arg, int align,
+			   uint32_t idx, uint32_t val, uint32_t saved)
 {
-	uint32_t align =
-	    atom_dst_to_src[(attr >> 3) & 7][(attr >> 6) & 3], old_val =
-	    val, idx;
+	uint32_t old_val = val;
 	struct atom_context *gctx = ctx->ctx;
 	old_val &= atom_arg_mask[align] >> atom_arg_shift[align];
 	val <<= atom_arg_shift[align];
@@ -456,8 +532,6 @@ static void atom_put_dst(atom_exec_context *ctx, int arg, uint8_t attr,
 	val |= saved;
 	switch (arg) {
 	case ATOM_ARG_REG:
-		idx = U16(*ptr);
-		(*ptr) += 2;
 		ATOM_DEBUG_PRINT("REG[0x%04X]", idx);
 		idx += gctx->reg_block;
 		switch (gctx->io_mode) {
@@ -492,14 +566,10 @@ static void atom_put_dst(atom_exec_context *ctx, int arg, uint8_t attr,
 		}
 		break;
 	case ATOM_ARG_PS:
-		idx = U8(*ptr);
-		(*ptr)++;
 		ATOM_DEBUG_PRINT("PS[0x%02X]", idx);
 		ctx->ps[idx] = cpu_to_le32(val);
 		break;
 	case ATOM_ARG_WS:
-		idx = U8(*ptr);
-		(*ptr)++;
 		ATOM_DEBUG_PRINT("WS[0x%02X]", idx);
 		switch (idx) {
 		case ATOM_WS_QUOTIENT:
@@ -531,8 +601,6 @@ static void atom_put_dst(atom_exec_context *ctx, int arg, uint8_t attr,
 		}
 		break;
 	case ATOM_ARG_FB:
-		idx = U8(*ptr);
-		(*ptr)++;
 		if ((gctx->fb_base + (idx * 4)) > gctx->scratch_size_bytes) {
 			DRM_ERROR("ATOM: fb write beyond scratch region: %d vs. %d\n",
 				  gctx->fb_base + (idx * 4), gctx->scratch_size_bytes);
@@ -541,14 +609,10 @@ static void atom_put_dst(atom_exec_context *ctx, int arg, uint8_t attr,
 		ATOM_DEBUG_PRINT("FB[0x%02X]", idx);
 		break;
 	case ATOM_ARG_PLL:
-		idx = U8(*ptr);
-		(*ptr)++;
 		ATOM_DEBUG_PRINT("PLL[0x%02X]", idx);
 		gctx->card->pll_write(gctx->card, idx, val);
 		break;
 	case ATOM_ARG_MC:
-		idx = U8(*ptr);
-		(*ptr)++;
 		ATOM_DEBUG_PRINT("MC[0x%02X]", idx);
 		gctx->card->mc_write(gctx->card, idx, val);
 		return;
@@ -581,6 +645,15 @@ static void atom_put_dst(atom_exec_context *ctx, int arg, uint8_t attr,
 	}
 }
 
+static void atom_put_dst(atom_exec_context *ctx, int arg, uint8_t attr,
+			 int *ptr, uint32_t val, uint32_t saved)
+{
+	uint32_t align = atom_dst_to_src[(attr >> 3) & 7][(attr >> 6) & 3];
+
+	atom_write_arg(ctx, arg, align, atom_fetch_arg(ctx->ctx, arg, align, ptr),
+		       val, saved);
+}
+
 static void atom_op_add(atom_exec_context *ctx, int *ptr, int arg)
 {
 	uint8_t attr = U8((*ptr)++);
@@ -690,12 +763,10 @@ static void atom_op_eot(atom_exec_context *ctx, int *ptr, int arg)
 	/* functionally, a nop */
 }
 
-static void atom_op_jump(atom_exec_context *ctx, int *ptr, int arg)
+static int atom_jump_cond(atom_exec_context *ctx, int arg)
 {
-	int execute = 0, target = U16(*ptr);
-	unsigned long cjiffies;
+	int execute = 0;
 
-	(*ptr) += 2;
 	switch (arg) {
 	case ATOM_COND_ABOVE:
 		execute = ctx->ctx->cs_above;
@@ -719,26 +790,42 @@ static void atom_op_jump(atom_exec_context *ctx, int *ptr, int arg)
 		execute = !ctx->ctx->cs_equal;
 		break;
 	}
-	if (arg != ATOM_COND_ALWAYS)
-		ATOM_SDEBUG_PRINT("   taken: %s\n", execute ? "yes" : "no");
-	ATOM_SDEBUG_PRINT("   target: 0x%04X\n", target);
-	if (execute) {
-		if (ctx->last_jump == (ctx->start + target)) {
-			cjiffies = jiffies;
-			if (time_after(cjiffies, ctx->last_jump_jiffies)) {
-				cjiffies -= ctx->last_jump_jiffies;
-				if ((jiffies_to_msecs(cjiffies) > 5000)) {
-					DRM_ERROR("atombios stuck in loop for more than 5secs aborting\n");
-					ctx->abort = true;
-				}
-			} else {
-				/* jiffies wrap around we will just wait a little longer */
-				ctx->last_jump_jiffies = jiffies;
+	return execute;
+}
+
+static void atom_jump_check_loop(atom_exec_context *ctx, int target)
+{
+	unsigned long cjiffies;
+
+	if (ctx->last_jump == (ctx->start + target)) {
+		cjiffies = jiffies;
+		if (time_after(cjiffies, ctx->last_jump_jiffies)) {
+			cjiffies -= ctx->last_jump_jiffies;
+			if ((jiffies_to_msecs(cjiffies) > 5000)) {
+				DRM_ERROR("atombios stuck in loop for more than 5secs aborting\n");
+				ctx->abort = true;
 			}
 		} else {
-			ctx->last_jump = ctx->start + target;
+			/* jiffies wrap around we will just wait a little longer */
 			ctx->last_jump_jiffies = jiffies;
 		}
+	} else {
+		ctx->last_jump = ctx->start + target;
+		ctx->last_jump_jiffies = jiffies;
+	}
+}
+
+static void atom_op_jump(atom_exec_context *ctx, int *ptr, int arg)
+{
+	int execute, target = U16(*ptr);
+
+	(*ptr) += 2;
+	execute = atom_jump_cond(ctx, arg);
+	if (arg != ATOM_COND_ALWAYS)
+		ATOM_SDEBUG_PRINT("   taken: %s\n", execute ? "yes" : "no");
+	ATOM_SDEBUG_PRINT("   target: 0x%04X\n", target);
+	if (execute) {
+		atom_jump_check_loop(ctx, target);
 		*ptr = ctx->start + target;
 	}
 }
@@ -1153,12 +1240,356 @@ static struct {
 	atom_op_shr, ATOM_ARG_MC}, {
 atom_op_debug, 0},};
 
+/* Decoded instruction kind of each opcode, in opcode_table order. */
+#define	ATOM_INSN_ARGS(kind)	kind, kind, kind, kind, kind, kind
+
+static const uint8_t atom_insn_kind[ATOM_OP_CNT] = {
+	ATOM_INSN_CALL,					/* 0 */
+	ATOM_INSN_ARGS(ATOM_INSN_MOVE),			/* 1 */
+	ATOM_INSN_ARGS(ATOM_INSN_AND),			/* 7 */
+	ATOM_INSN_ARGS(ATOM_INSN_OR),			/* 13 */
+	ATOM_INSN_ARGS(ATOM_INSN_SHIFT_LEFT),		/* 19 */
+	ATOM_INSN_ARGS(ATOM_INSN_SHIFT_RIGHT),		/* 25 */
+	ATOM_INSN_ARGS(ATOM_INSN_MUL),			/* 31 */
+	ATOM_INSN_ARGS(ATOM_INSN_DIV),			/* 37 */
+	ATOM_INSN_ARGS(ATOM_INSN_ADD),			/* 43 */
+	ATOM_INSN_ARGS(ATOM_INSN_SUB),			/* 49 */
+	ATOM_INSN_SETPORT, ATOM_INSN_SETPORT, ATOM_INSN_SETPORT, /* 55 */
+	ATOM_INSN_SETREGBLOCK,				/* 58 */
+	ATOM_INSN_SETFBBASE,				/* 59 */
+	ATOM_INSN_ARGS(ATOM_INSN_COMPARE),		/* 60 */
+	ATOM_INSN_SWITCH,				/* 66 */
+	ATOM_INSN_ARGS(ATOM_INSN_JUMP), ATOM_INSN_JUMP,	/* 67 */
+	ATOM_INSN_ARGS(ATOM_INSN_TEST),			/* 74 */
+	ATOM_INSN_BYTE, ATOM_INSN_BYTE,			/* 80 delay */
+	ATOM_INSN_BYTE,					/* 82 calltable */
+	ATOM_INSN_CALL,					/* 83 repeat */
+	ATOM_INSN_ARGS(ATOM_INSN_CLEAR),		/* 84 */
+	ATOM_INSN_CALL, ATOM_INSN_CALL,			/* 90 nop, eot */
+	ATOM_INSN_ARGS(ATOM_INSN_MASK),			/* 92 */
+	ATOM_INSN_BYTE,					/* 98 postcard */
+	ATOM_INSN_CALL, ATOM_INSN_CALL, ATOM_INSN_CALL,	/* 99 */
+	ATOM_INSN_BYTE,					/* 102 setdatablock */
+	ATOM_INSN_ARGS(ATOM_INSN_XOR),			/* 103 */
+	ATOM_INSN_ARGS(ATOM_INSN_SHL),			/* 109 */
+	ATOM_INSN_ARGS(ATOM_INSN_SHR),			/* 115 */
+	ATOM_INSN_CALL,					/* 121 debug */
+};
+
+#undef	ATOM_INSN_ARGS
+
+static int atom_decode_insn(struct atom_context *ctx, int ptr,
+			    struct atom_insn *insn)
+{
+	uint8_t attr;
+	int arg, i, n;
+
+	memset(insn, 0, sizeof(*insn));
+	insn->offset = ptr;
+	insn->op = CU8(ptr++);
+	insn->target = -1;
+	if (insn->op == 0 || insn->op >= ATOM_OP_CNT ||
+	    opcode_table[insn->op].func == NULL)
+		return -1;
+	arg = insn->arg = opcode_table[insn->op].arg;
+	insn->kind = atom_insn_kind[insn->op];
+
+	switch (insn->kind) {
+	case ATOM_INSN_ADD:
+	case ATOM_INSN_AND:
+	case ATOM_INSN_OR:
+	case ATOM_INSN_XOR:
+	case ATOM_INSN_SUB:
+	case ATOM_INSN_MOVE:
+	case ATOM_INSN_MUL:
+	case ATOM_INSN_DIV:
+	case ATOM_INSN_COMPARE:
+	case ATOM_INSN_TEST:
+	case ATOM_INSN_MASK:
+	case ATOM_INSN_SHL:
+	case ATOM_INSN_SHR:
+		attr = insn->attr = CU8(ptr++);
+		insn->dst_align =
+		    atom_dst_to_src[(attr >> 3) & 7][(attr >> 6) & 3];
+		insn->dst = atom_fetch_arg(ctx, arg, insn->dst_align, &ptr);
+		if (insn->kind == ATOM_INSN_MASK)
+			insn->aux = atom_fetch_arg(ctx, ATOM_ARG_IMM,
+						   (attr >> 3) & 7, &ptr);
+		insn->src = atom_fetch_arg(ctx, attr & 7, (attr >> 3) & 7,
+					   &ptr);
+		break;
+	case ATOM_INSN_CLEAR:
+	case ATOM_INSN_SHIFT_LEFT:
+	case ATOM_INSN_SHIFT_RIGHT:
+		attr = CU8(ptr++);
+		attr &= 0x38;
+		attr |= atom_def_dst[attr >> 3] << 6;
+		insn->attr = attr;
+		insn->dst_align =
+		    atom_dst_to_src[(attr >> 3) & 7][(attr >> 6) & 3];
+		insn->dst = atom_fetch_arg(ctx, arg, insn->dst_align, &ptr);
+		if (insn->kind != ATOM_INSN_CLEAR)
+			insn->aux = CU8(ptr++);
+		break;
+	case ATOM_INSN_JUMP:
+		insn->aux = CU16(ptr);
+		ptr += 2;
+		break;
+	case ATOM_INSN_SETPORT:
+		ptr += (arg == ATOM_PORT_ATI) ? 2 : 1;
+		break;
+	case ATOM_INSN_SETREGBLOCK:
+		ptr += 2;
+		break;
+	case ATOM_INSN_SETFBBASE:
+		attr = CU8(ptr++);
+		ptr += atom_arg_len(attr & 7, (attr >> 3) & 7);
+		break;
+	case ATOM_INSN_SWITCH:
+		attr = CU8(ptr++);
+		ptr += atom_arg_len(attr & 7, (attr >> 3) & 7);
+		n = atom_arg_len(ATOM_ARG_IMM, (attr >> 3) & 7);
+		for (i = 0; CU16(ptr) != ATOM_CASE_END; i++) {
+			if (CU8(ptr) != ATOM_CASE_MAGIC || i > 0xFFFF)
+				return -1;
+			ptr += 1 + n + 2;
+		}
+		ptr += 2;
+		break;
+	case ATOM_INSN_BYTE:
+		ptr++;
+		break;
+	}
+	insn->next = ptr;
+	return ptr;
+}
+
+static int atom_decoded_lookup(const struct atom_decoded_table *dt, int offset)
+{
+	int lo = 0, hi = dt->count - 1, mid;
+
+	while (lo <= hi) {
+		mid = (lo + hi) / 2;
+		if (dt->insns[mid].offset == offset)
+			return mid;
+		if (dt->insns[mid].offset < offset)
+			lo = mid + 1;
+		else
+			hi = mid - 1;
+	}
+	return -1;
+}
+
+static struct atom_decoded_table *atom_decode_table(struct atom_context *ctx,
+						    int index, int base, int len)
+{
+	struct atom_decoded_table *dt;
+	struct atom_insn insn;
+	int count, end, ptr, next, i;
+
+	if (!atom_decode || index < 0 || index >= ATOM_DECODED_CNT)
+		return NULL;
+	if (ctx->decoded == NULL) {
+		ctx->decoded = malloc(ATOM_DECODED_CNT * sizeof(*ctx->decoded),
+				      DRM_MEM_DRIVER, M_NOWAIT | M_ZERO);
+		if (ctx->decoded == NULL)
+			return NULL;
+	}
+	if (ctx->decoded[index] != NULL)
+		return ctx->decoded[index];
+
+	end = base + len;
+	ptr = base + ATOM_CT_CODE_PTR;
+	for (count = 0; ptr < end; count++, ptr = next) {
+		next = atom_decode_insn(ctx, ptr, &insn);
+		if (next < 0 || next > end)
+			break;
+	}
+	dt = malloc(sizeof(*dt) + count * sizeof(dt->insns[0]),
+		    DRM_MEM_DRIVER, M_NOWAIT);
+	if (dt == NULL)
+		return NULL;
+	dt->count = count;
+	ptr = base + ATOM_CT_CODE_PTR;
+	for (i = 0; i < count; i++)
+		ptr = atom_decode_insn(ctx, ptr, &dt->insns[i]);
+	dt->end = ptr;
+	for (i = 0; i < count; i++) {
+		if (dt->insns[i].kind == ATOM_INSN_JUMP)
+			dt->insns[i].target = atom_decoded_lookup(dt,
+			    base + dt->insns[i].aux);
+	}
+	ctx->decoded[index] = dt;
+	return dt;
+}
+
+static uint32_t atom_read_dst(atom_exec_context *ctx,
+			      const struct atom_insn *insn, uint32_t *saved)
+{
+	return atom_read_arg(ctx, insn->arg, insn->dst_align, insn->dst,
+			     saved, 0);
+}
+
+static uint32_t atom_read_src(atom_exec_context *ctx,
+			      const struct atom_insn *insn)
+{
+	return atom_read_arg(ctx, insn->attr & 7, (insn->attr >> 3) & 7,
+			     insn->src, NULL, 0);
+}
+
+static void atom_write_dst(atom_exec_context *ctx,
+			   const struct atom_insn *insn, uint32_t val,
+			   uint32_t saved)
+{
+	atom_write_arg(ctx, insn->arg, insn->dst_align, insn->dst, val, saved);
+}
+
+/*
+ * Run a decoded table from its first instruction.  Returns true once
+ * the table is done, or false with *ptr set to the offset at which the
+ * byte interpreter has to continue.  The operations match the
+ * atom_op_* handlers with debug output off.
+ */
+static bool atom_execute_decoded(atom_exec_context *ctx,
+				 const struct atom_decoded_table *dt, int *ptr)
+{
+	const struct atom_insn *insn;
+	uint32_t dst, src, saved;
+	uint8_t shift;
+	int i, p;
+
+	i = 0;
+	while (i < dt->count) {
+		insn = &dt->insns[i++];
+		if (ctx->abort) {
+			*ptr = insn->offset;
+			return false;
+		}
+		saved = 0xCDCDCDCD;
+		switch (insn->kind) {
+		case ATOM_INSN_ADD:
+		case ATOM_INSN_AND:
+		case ATOM_INSN_OR:
+		case ATOM_INSN_XOR:
+		case ATOM_INSN_SUB:
+			dst = atom_read_dst(ctx, insn, &saved);
+			src = atom_read_src(ctx, insn);
+			if (insn->kind == ATOM_INSN_ADD)
+				dst += src;
+			else if (insn->kind == ATOM_INSN_AND)
+				dst &= src;
+			else if (insn->kind == ATOM_INSN_OR)
+				dst |= src;
+			else if (insn->kind == ATOM_INSN_XOR)
+				dst ^= src;
+			else
+				dst -= src;
+			atom_write_dst(ctx, insn, dst, saved);
+			break;
+		case ATOM_INSN_MOVE:
+			if (((insn->attr >> 3) & 7) != ATOM_SRC_DWORD)
+				atom_read_dst(ctx, insn, &saved);
+			src = atom_read_src(ctx, insn);
+			atom_write_dst(ctx, insn, src, saved);
+			break;
+		case ATOM_INSN_MUL:
+			dst = atom_read_dst(ctx, insn, NULL);
+			src = atom_read_src(ctx, insn);
+			ctx->ctx->divmul[0] = dst * src;
+			break;
+		case ATOM_INSN_DIV:
+			dst = atom_read_dst(ctx, insn, NULL);
+			src = atom_read_src(ctx, insn);
+			if (src != 0) {
+				ctx->ctx->divmul[0] = dst / src;
+				ctx->ctx->divmul[1] = dst % src;
+			} else {
+				ctx->ctx->divmul[0] = 0;
+				ctx->ctx->divmul[1] = 0;
+			}
+			break;
+		case ATOM_INSN_COMPARE:
+			dst = atom_read_dst(ctx, insn, NULL);
+			src = atom_read_src(ctx, insn);
+			ctx->ctx->cs_equal = (dst == src);
+			ctx->ctx->cs_above = (dst > src);
+			break;
+		case ATOM_INSN_TEST:
+			dst = atom_read_dst(ctx, insn, NULL);
+			src = atom_read_src(ctx, insn);
+			ctx->ctx->cs_equal = ((dst & src) == 0);
+			break;
+		case ATOM_INSN_MASK:
+			dst = atom_read_dst(ctx, insn, &saved);
+			src = atom_read_src(ctx, insn);
+			dst &= insn->aux;
+			dst |= src;
+			atom_write_dst(ctx, insn, dst, saved);
+			break;
+		case ATOM_INSN_CLEAR:
+			atom_read_dst(ctx, insn, &saved);
+			atom_write_dst(ctx, insn, 0, saved);
+			break;
+		case ATOM_INSN_SHIFT_LEFT:
+		case ATOM_INSN_SHIFT_RIGHT:
+			dst = atom_read_dst(ctx, insn, &saved);
+			shift = insn->aux;
+			if (insn->kind == ATOM_INSN_SHIFT_LEFT)
+				dst <<= shift;
+			else
+				dst >>= shift;
+			atom_write_dst(ctx, insn, dst, saved);
+			break;
+		case ATOM_INSN_SHL:
+		case ATOM_INSN_SHR:
+			atom_read_dst(ctx, insn, &saved);
+			/* op needs to full dst value */
+			dst = saved;
+			shift = atom_read_src(ctx, insn);
+			if (insn->kind == ATOM_INSN_SHL)
+				dst <<= shift;
+			else
+				dst >>= shift;
+			dst &= atom_arg_mask[insn->dst_align];
+			dst >>= atom_arg_shift[insn->dst_align];
+			atom_write_dst(ctx, insn, dst, saved);
+			break;
+		case ATOM_INSN_JUMP:
+			if (!atom_jump_cond(ctx, insn->arg))
+				break;
+			atom_jump_check_loop(ctx, insn->aux);
+			if (insn->target < 0) {
+				*ptr = ctx->start + insn->aux;
+				return false;
+			}
+			i = insn->target;
+			break;
+		default:
+			p = insn->offset + 1;
+			opcode_table[insn->op].func(ctx, &p, insn->arg);
+			if (insn->op == ATOM_OP_EOT)
+				return true;
+			if (p != insn->next) {
+				i = atom_decoded_lookup(dt, p);
+				if (i < 0) {
+					*ptr = p;
+					return false;
+				}
+			}
+			break;
+		}
+	}
+	*ptr = dt->end;
+	return false;
+}
+
 static int atom_execute_table_locked(struct atom_context *ctx, int index, uint32_t * params)
 {
 	int base = CU16(ctx->cmd_table + 4 + 2 * index);
 	int len, ws, ps, ptr;
 	unsigned char op;
 	atom_exec_context ectx;
+	struct atom_decoded_table *dt;
 	int ret = 0;
 
 	if (!base)
@@ -1182,8 +1613,11 @@ static int atom_execute_table_locked(struct atom_context *ctx, int index, uint32
 	else
 		ectx.ws = NULL;
 
+	dt = atom_debug ? NULL : atom_decode_table(ctx, index, base, len);
+
 	debug_depth++;
-	while (1) {
+	while (dt == NULL || !atom_execute_decoded(&ectx, dt, &ptr)) {
+		dt = NULL;
 		op = CU8(ptr++);
 		if (op < ATOM_OP_NAMES_CNT)
 			ATOM_SDEBUG_PRINT("%s @ 0x%04X\n", atom_op_names[op], ptr - 1);
@@ -1332,6 +1766,13 @@ int atom_asic_init(struct atom_context *ctx)
 
 void atom_destroy(struct atom_context *ctx)
 {
+	int i;
+
+	if (ctx->decoded) {
+		for (i = 0; i < ATOM_DECODED_CNT; i++)
+			free(ctx->decoded[i], DRM_MEM_DRIVER);
+		free(ctx->decoded, DRM_MEM_DRIVER);
+	}
 	if (ctx->iio)
 		free(ctx->iio, DRM_MEM_DRIVER);
 	free(ctx, DRM_MEM_DRIVER);
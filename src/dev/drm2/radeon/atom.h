@@ -141,9 +141,11 @@ struct atom_context {
 	int io_mode;
 	uint32_t *scratch;
 	int scratch_size_bytes;
+	struct atom_decoded_table **decoded;
 };
 
 extern int atom_debug;
+extern int atom_decode;
 
 struct atom_context *atom_parse(struct card_info *, void *);
 int atom_execute_table(struct atom_context *, int, uint32_t *);
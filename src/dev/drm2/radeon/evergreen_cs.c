@@ -94,6 +94,9 @@ struct evergreen_cs_track {
 	u32			htile_offset;
 	u32			htile_surface;
 	struct radeon_bo	*htile_bo;
+	/* register safe bitmap of the asic family */
+	const unsigned		*reg_safe_bm;
+	u32			reg_safe_bm_size;
 };
 
 static u32 evergreen_cs_get_aray_mode(u32 tiling_flags)
@@ -1278,41 +1281,21 @@ static int evergreen_cs_parse_packet0(struct radeon_cs_parser *p,
 }
 
 /**
- * evergreen_cs_check_reg() - check if register is authorized or not
+ * evergreen_cs_handle_reg() - check a register that is not flagged as safe
  * @parser: parser structure holding parsing context
  * @reg: register we are testing
  * @idx: index into the cs buffer
  *
- * This function will test against evergreen_reg_safe_bm and return 0
- * if register is safe. If register is not flag as safe this function
- * will test it against a list of register needind special handling.
+ * This function will test the register against a list of register
+ * needing special handling and return 0 if it is allowed.
  */
-static int evergreen_cs_check_reg(struct radeon_cs_parser *p, u32 reg, u32 idx)
+static int evergreen_cs_handle_reg(struct radeon_cs_parser *p, u32 reg, u32 idx)
 {
 	struct evergreen_cs_track *track = (struct evergreen_cs_track *)p->track;
 	struct radeon_cs_reloc *reloc;
-	u32 last_reg;
-	u32 m, i, tmp, *ib;
+	u32 i, tmp, *ib;
 	int r;
 
-	if (p->rdev->family >= CHIP_CAYMAN)
-		last_reg = ARRAY_SIZE(cayman_reg_safe_bm);
-	else
-		last_reg = ARRAY_SIZE(evergreen_reg_safe_bm);
-
-	i = (reg >> 7);
-	if (i >= last_reg) {
-		dev_warn(p->dev, "forbidden register 0x%08x at %d\n", reg, idx);
-		return -EINVAL;
-	}
-	m = 1 << ((reg >> 2) & 31);
-	if (p->rdev->family >= CHIP_CAYMAN) {
-		if (!(cayman_reg_safe_bm[i] & m))
-			return 0;
-	} else {
-		if (!(evergreen_reg_safe_bm[i] & m))
-			return 0;
-	}
 	ib = p->ib.ptr;
 	switch (reg) {
 	/* force following reg to 0 in an attempt to disable out buffer
@@ -1959,28 +1942,62 @@ static int evergreen_cs_check_reg(struct radeon_cs_parser *p, u32 reg, u32 idx)
 	return 0;
 }
 
-static bool evergreen_is_safe_reg(struct radeon_cs_parser *p, u32 reg, u32 idx)
+/**
+ * evergreen_cs_check_reg_range() - check a run of consecutive registers
+ * @parser: parser structure holding parsing context
+ * @start_reg: first register of the run
+ * @count: number of registers
+ * @idx: index into the cs buffer of the first register value
+ *
+ * This function tests up to 32 registers at a time against the family
+ * register safe bitmap, so that only the registers not flagged as safe
+ * are checked individually by evergreen_cs_handle_reg().
+ */
+static int evergreen_cs_check_reg_range(struct radeon_cs_parser *p,
+					u32 start_reg, u32 count, u32 idx)
 {
-	u32 last_reg, m, i;
+	struct evergreen_cs_track *track = (struct evergreen_cs_track *)p->track;
+	u32 reg, end_reg, first, n, mask, unsafe, i;
+	int r;
 
-	if (p->rdev->family >= CHIP_CAYMAN)
-		last_reg = ARRAY_SIZE(cayman_reg_safe_bm);
-	else
-		last_reg = ARRAY_SIZE(evergreen_reg_safe_bm);
+	end_reg = start_reg + 4 * count;
+	for (reg = start_reg; reg < end_reg; reg += 4 * n) {
+		i = (reg >> 7);
+		if (i >= track->reg_safe_bm_size) {
+			dev_warn(p->dev, "forbidden register 0x%08x at %d\n",
+				 reg, idx + (reg - start_reg) / 4);
+			return -EINVAL;
+		}
+		first = (reg >> 2) & 31;
+		n = min(32 - first, (end_reg - reg) >> 2);
+		mask = (n == 32) ? ~0U : ((1U << n) - 1) << first;
+		unsafe = track->reg_safe_bm[i] & mask;
+		while (unsafe) {
+			u32 r_reg = (i << 7) | ((ffs(unsafe) - 1) << 2);
+
+			unsafe &= unsafe - 1;
+			r = evergreen_cs_handle_reg(p, r_reg,
+					idx + (r_reg - start_reg) / 4);
+			if (r)
+				return r;
+		}
+	}
+	return 0;
+}
+
+static bool evergreen_is_safe_reg(struct radeon_cs_parser *p, u32 reg, u32 idx)
+{
+	struct evergreen_cs_track *track = (struct evergreen_cs_track *)p->track;
+	u32 m, i;
 
 	i = (reg >> 7);
-	if (i >= last_reg) {
+	if (i >= track->reg_safe_bm_size) {
 		dev_warn(p->dev, "forbidden register 0x%08x at %d\n", reg, idx);
 		return false;
 	}
 	m = 1 << ((reg >> 2) & 31);
-	if (p->rdev->family >= CHIP_CAYMAN) {
-		if (!(cayman_reg_safe_bm[i] & m))
-			return true;
-	} else {
-		if (!(evergreen_reg_safe_bm[i] & m))
-			return true;
-	}
+	if (!(track->reg_safe_bm[i] & m))
+		return true;
 	dev_warn(p->dev, "forbidden register 0x%08x at %d\n", reg, idx);
 	return false;
 }
@@ -2444,12 +2461,9 @@ static int evergreen_packet3_check(struct radeon_cs_parser *p,
 			DRM_ERROR("bad PACKET3_SET_CONFIG_REG\n");
 			return -EINVAL;
 		}
-		for (i = 0; i < pkt->count; i++) {
-			reg = start_reg + (4 * i);
-			r = evergreen_cs_check_reg(p, reg, idx+1+i);
-			if (r)
-				return r;
-		}
+		r = evergreen_cs_check_reg_range(p, start_reg, pkt->count, idx+1);
+		if (r)
+			return r;
 		break;
 	case PACKET3_SET_CONTEXT_REG:
 		start_reg = (idx_value << 2) + PACKET3_SET_CONTEXT_REG_START;
@@ -2460,12 +2474,9 @@ static int evergreen_packet3_check(struct radeon_cs_parser *p,
 			DRM_ERROR("bad PACKET3_SET_CONTEXT_REG\n");
 			return -EINVAL;
 		}
-		for (i = 0; i < pkt->count; i++) {
-			reg = start_reg + (4 * i);
-			r = evergreen_cs_check_reg(p, reg, idx+1+i);
-			if (r)
-				return r;
-		}
+		r = evergreen_cs_check_reg_range(p, start_reg, pkt->count, idx+1);
+		if (r)
+			return r;
 		break;
 	case PACKET3_SET_RESOURCE:
 		if (pkt->count % 8) {
@@ -2767,10 +2778,15 @@ int evergreen_cs_parse(struct radeon_cs_parser *p)
 		if (track == NULL)
 			return -ENOMEM;
 		evergreen_cs_track_init(track);
-		if (p->rdev->family >= CHIP_CAYMAN)
+		if (p->rdev->family >= CHIP_CAYMAN) {
 			tmp = p->rdev->config.cayman.tile_config;
-		else
+			track->reg_safe_bm = cayman_reg_safe_bm;
+			track->reg_safe_bm_size = ARRAY_SIZE(cayman_reg_safe_bm);
+		} else {
 			tmp = p->rdev->config.evergreen.tile_config;
+			track->reg_safe_bm = evergreen_reg_safe_bm;
+			track->reg_safe_bm_size = ARRAY_SIZE(evergreen_reg_safe_bm);
+		}
 
 		switch (tmp & 0xf) {
 		case 0:
@@ -662,6 +662,7 @@ int r100_pci_gart_init(struct radeon_device *rdev)
 	rdev->gart.table_size = rdev->gart.num_gpu_pages * 4;
 	rdev->asic->gart.tlb_flush = &r100_pci_gart_tlb_flush;
 	rdev->asic->gart.set_page = &r100_pci_gart_set_page;
+	rdev->asic->gart.set_pages = &r100_pci_gart_set_pages;
 	return radeon_gart_table_ram_alloc(rdev);
 }
 
@@ -710,6 +711,19 @@ int r100_pci_gart_set_page(struct radeon_device *rdev, int i, uint64_t addr)
 	return 0;
 }
 
+int r100_pci_gart_set_pages(struct radeon_device *rdev, int i, unsigned count,
+			    uint64_t addr)
+{
+	u32 *gtt = rdev->gart.ptr;
+
+	if (i < 0 || i + count > rdev->gart.num_gpu_pages) {
+		return -EINVAL;
+	}
+	for (gtt += i; count > 0; count--, addr += RADEON_GPU_PAGE_SIZE)
+		*gtt++ = cpu_to_le32(lower_32_bits(addr));
+	return 0;
+}
+
 void r100_pci_gart_fini(struct radeon_device *rdev)
 {
 	radeon_gart_fini(rdev);
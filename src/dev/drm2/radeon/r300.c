@@ -92,6 +92,23 @@ int rv370_pcie_gart_set_page(struct radeon_device *rdev, int i, uint64_t addr)
 	return 0;
 }
 
+int rv370_pcie_gart_set_pages(struct radeon_device *rdev, int i,
+			      unsigned count, uint64_t addr)
+{
+	volatile uint32_t *ptr = rdev->gart.ptr;
+
+	if (i < 0 || i + count > rdev->gart.num_gpu_pages) {
+		return -EINVAL;
+	}
+	/* the table lives in write-combined VRAM, keep the stores
+	 * sequential so they are merged into full bursts */
+	for (ptr += i; count > 0; count--, addr += RADEON_GPU_PAGE_SIZE)
+		*ptr++ = (lower_32_bits(addr) >> 8) |
+			 ((upper_32_bits(addr) & 0xff) << 24) |
+			 R300_PTE_WRITEABLE | R300_PTE_READABLE;
+	return 0;
+}
+
 int rv370_pcie_gart_init(struct radeon_device *rdev)
 {
 	int r;
@@ -110,6 +127,7 @@ int rv370_pcie_gart_init(struct radeon_device *rdev)
 	rdev->gart.table_size = rdev->gart.num_gpu_pages * 4;
 	rdev->asic->gart.tlb_flush = &rv370_pcie_gart_tlb_flush;
 	rdev->asic->gart.set_page = &rv370_pcie_gart_set_page;
+	rdev->asic->gart.set_pages = &rv370_pcie_gart_set_pages;
 	return radeon_gart_table_vram_alloc(rdev);
 }
 
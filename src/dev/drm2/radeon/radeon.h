@@ -107,6 +107,7 @@ extern int radeon_hw_i2c;
 extern int radeon_pcie_gen2;
 extern int radeon_msi;
 extern int radeon_lockup_timeout;
+extern int radeon_fence_spin_usecs;
 
 /*
  * Copy from radeon_drv.h so we don't have to include both and have conflicting
@@ -228,6 +229,16 @@ struct radeon_fence_driver {
 	atomic64_t			last_seq;
 	unsigned long			last_activity;
 	bool				initialized;
+	/* waiters on this ring only, woken by radeon_fence_process() */
+	struct mtx			queue_mtx;
+	struct cv			queue;
+	u_int				waiters;
+	/* current spin budget before sleeping, adapted to the workload */
+	u_int				spin_usecs;
+	u_int				spin_skipped;	/* waits since the last probe */
+	u_long				spin_hits;
+	u_long				spin_misses;
+	u_long				sleeps;
 };
 
 struct radeon_fence {
@@ -243,6 +254,7 @@ int radeon_fence_driver_start_ring(struct radeon_device *rdev, int ring);
 int radeon_fence_driver_init(struct radeon_device *rdev);
 void radeon_fence_driver_fini(struct radeon_device *rdev);
 void radeon_fence_driver_force_completion(struct radeon_device *rdev);
+int radeon_fence_sysctl_stats(SYSCTL_HANDLER_ARGS);
 int radeon_fence_emit(struct radeon_device *rdev, struct radeon_fence **fence, int ring);
 void radeon_fence_process(struct radeon_device *rdev, int ring);
 bool radeon_fence_signaled(struct radeon_fence *fence);
@@ -483,6 +495,9 @@ struct radeon_gart {
 	vm_page_t			*pages;
 	dma_addr_t			*pages_addr;
 	bool				ready;
+	/* thread batching its TLB flushes, see radeon_gart_defer_flush() */
+	struct thread			*flush_defer_td;
+	bool				flush_pending;
 };
 
 int radeon_gart_table_ram_alloc(struct radeon_device *rdev);
@@ -499,6 +514,9 @@ int radeon_gart_bind(struct radeon_device *rdev, unsigned offset,
 		     int pages, vm_page_t *pagelist,
 		     dma_addr_t *dma_addr);
 void radeon_gart_restore(struct radeon_device *rdev);
+void radeon_gart_defer_flush(struct radeon_device *rdev);
+void radeon_gart_sync_flush(struct radeon_device *rdev);
+void radeon_gart_commit_flush(struct radeon_device *rdev);
 
 
 /*
@@ -719,13 +737,53 @@ struct radeon_vm_manager {
 	bool				enabled;
 };
 
+/*
+ * CS parser arena: the chunk, relocation and kdata arrays of a submission
+ * are carved from buffers owned by the file and kept across CS ioctls.
+ * Buffers grow to the largest request seen and are released again when
+ * they stayed mostly unused for RADEON_CS_ARENA_WINDOW submissions, or
+ * all at once when the file has not submitted for RADEON_CS_ARENA_IDLE
+ * seconds.
+ */
+#define RADEON_CS_ARENA_CHUNKS_ARRAY	0
+#define RADEON_CS_ARENA_CHUNKS		1
+#define RADEON_CS_ARENA_KDATA		2
+#define RADEON_CS_ARENA_RELOCS		3
+#define RADEON_CS_ARENA_RELOCS_PTR	4
+#define RADEON_CS_ARENA_KPAGE		5
+#define RADEON_CS_ARENA_NUM		6
+#define RADEON_CS_ARENA_WINDOW		64
+#define RADEON_CS_ARENA_IDLE		5
+
+struct radeon_cs_arena {
+	void				*buf[RADEON_CS_ARENA_NUM];
+	size_t				size[RADEON_CS_ARENA_NUM];
+	/* largest request per buffer over the current window */
+	size_t				hwm[RADEON_CS_ARENA_NUM];
+	unsigned			submits;
+};
+
 /*
  * file private structure
  */
 struct radeon_fpriv {
 	struct radeon_vm		vm;
+	/* relocation handle table and parser arena, kept across CS ioctls */
+	struct mtx			cs_lock;
+	uint32_t			*reloc_hash;
+	unsigned			reloc_hash_order;
+	struct radeon_cs_arena		cs_arena;
+	bool				cs_arena_busy;
+	/* frees the arena once the file goes idle, runs under cs_lock */
+	struct callout			cs_arena_timer;
+	int				cs_arena_used;
+	struct radeon_device		*rdev;
 };
 
+void radeon_cs_arena_init(struct radeon_fpriv *fpriv,
+			  struct radeon_device *rdev);
+void radeon_cs_arena_fini(struct radeon_cs_arena *arena);
+
 /*
  * R6xx+ IH ring
  */
@@ -874,9 +932,26 @@ struct radeon_cs_parser {
 	u32			cs_flags;
 	u32			ring;
 	s32			priority;
+	/* submission id in the device trace, see drm_trace.h */
+	uint32_t		trace_id;
+	/* buffers borrowed from the file, see radeon_cs_arena */
+	struct radeon_cs_arena	arena;
+	bool			arena_owned;
+	unsigned		nallocs;
+	size_t			alloc_bytes;
+};
+
+/* CS ioctl allocation counters, reported by the cs_stats sysctl */
+struct radeon_cs_stats {
+	u_long			ioctls;
+	u_long			allocs;
+	u_long			alloc_bytes;
+	u_long			shrinks;
+	u_long			contended;
 };
 
 extern int radeon_cs_finish_pages(struct radeon_cs_parser *p);
+int radeon_cs_sysctl_stats(SYSCTL_HANDLER_ARGS);
 extern u32 radeon_get_ib_value(struct radeon_cs_parser *p, int idx);
 
 struct radeon_cs_packet {
@@ -1191,6 +1266,9 @@ struct radeon_asic {
 	struct {
 		void (*tlb_flush)(struct radeon_device *rdev);
 		int (*set_page)(struct radeon_device *rdev, int i, uint64_t addr);
+		/* optional, count entries for contiguous addresses from addr */
+		int (*set_pages)(struct radeon_device *rdev, int i,
+				 unsigned count, uint64_t addr);
 	} gart;
 	struct {
 		int (*init)(struct radeon_device *rdev);
@@ -1602,12 +1680,15 @@ struct radeon_device {
 	struct radeon_scratch		scratch;
 	struct radeon_mman		mman;
 	struct radeon_fence_driver	fence_drv[RADEON_NUM_RINGS];
+	/* waiters on any of several rings, see radeon_fence_wait_any() */
 	struct cv			fence_queue;
 	struct mtx			fence_queue_mtx;
+	u_int				fence_any_waiters;
 	struct sx			ring_lock;
 	struct radeon_ring		ring[RADEON_NUM_RINGS];
 	bool				ib_pool_ready;
 	struct radeon_sa_manager	ring_tmp_bo;
+	struct radeon_cs_stats		cs_stats;
 	struct radeon_irq		irq;
 	struct radeon_asic		*asic;
 	struct radeon_gem		gem;
@@ -1825,6 +1906,7 @@ void radeon_ring_write(struct radeon_ring *ring, uint32_t v);
 #define radeon_asic_reset(rdev) (rdev)->asic->asic_reset((rdev))
 #define radeon_gart_tlb_flush(rdev) (rdev)->asic->gart.tlb_flush((rdev))
 #define radeon_gart_set_page(rdev, i, p) (rdev)->asic->gart.set_page((rdev), (i), (p))
+#define radeon_gart_set_pages(rdev, i, c, p) (rdev)->asic->gart.set_pages((rdev), (i), (c), (p))
 #define radeon_asic_vm_init(rdev) (rdev)->asic->vm.init((rdev))
 #define radeon_asic_vm_fini(rdev) (rdev)->asic->vm.fini((rdev))
 #define radeon_asic_vm_set_page(rdev, pe, addr, count, incr, flags) ((rdev)->asic->vm.set_page((rdev), (pe), (addr), (count), (incr), (flags)))
@@ -150,11 +150,13 @@ void radeon_agp_disable(struct radeon_device *rdev)
 		rdev->flags |= RADEON_IS_PCIE;
 		rdev->asic->gart.tlb_flush = &rv370_pcie_gart_tlb_flush;
 		rdev->asic->gart.set_page = &rv370_pcie_gart_set_page;
+		rdev->asic->gart.set_pages = &rv370_pcie_gart_set_pages;
 	} else {
 		DRM_INFO("Forcing AGP to PCI mode\n");
 		rdev->flags |= RADEON_IS_PCI;
 		rdev->asic->gart.tlb_flush = &r100_pci_gart_tlb_flush;
 		rdev->asic->gart.set_page = &r100_pci_gart_set_page;
+		rdev->asic->gart.set_pages = &r100_pci_gart_set_pages;
 	}
 	rdev->mc.gtt_size = radeon_gart_size * 1024 * 1024;
 }
@@ -175,6 +177,7 @@ static struct radeon_asic r100_asic = {
 	.gart = {
 		.tlb_flush = &r100_pci_gart_tlb_flush,
 		.set_page = &r100_pci_gart_set_page,
+		.set_pages = &r100_pci_gart_set_pages,
 	},
 	.ring = {
 		[RADEON_RING_TYPE_GFX_INDEX] = {
@@ -251,6 +254,7 @@ static struct radeon_asic r200_asic = {
 	.gart = {
 		.tlb_flush = &r100_pci_gart_tlb_flush,
 		.set_page = &r100_pci_gart_set_page,
+		.set_pages = &r100_pci_gart_set_pages,
 	},
 	.ring = {
 		[RADEON_RING_TYPE_GFX_INDEX] = {
@@ -327,6 +331,7 @@ static struct radeon_asic r300_asic = {
 	.gart = {
 		.tlb_flush = &r100_pci_gart_tlb_flush,
 		.set_page = &r100_pci_gart_set_page,
+		.set_pages = &r100_pci_gart_set_pages,
 	},
 	.ring = {
 		[RADEON_RING_TYPE_GFX_INDEX] = {
@@ -403,6 +408,7 @@ static struct radeon_asic r300_asic_pcie = {
 	.gart = {
 		.tlb_flush = &rv370_pcie_gart_tlb_flush,
 		.set_page = &rv370_pcie_gart_set_page,
+		.set_pages = &rv370_pcie_gart_set_pages,
 	},
 	.ring = {
 		[RADEON_RING_TYPE_GFX_INDEX] = {
@@ -479,6 +485,7 @@ static struct radeon_asic r420_asic = {
 	.gart = {
 		.tlb_flush = &rv370_pcie_gart_tlb_flush,
 		.set_page = &rv370_pcie_gart_set_page,
+		.set_pages = &rv370_pcie_gart_set_pages,
 	},
 	.ring = {
 		[RADEON_RING_TYPE_GFX_INDEX] = {
@@ -555,6 +562,7 @@ static struct radeon_asic rs400_asic = {
 	.gart = {
 		.tlb_flush = &rs400_gart_tlb_flush,
 		.set_page = &rs400_gart_set_page,
+		.set_pages = &rs400_gart_set_pages,
 	},
 	.ring = {
 		[RADEON_RING_TYPE_GFX_INDEX] = {
@@ -631,6 +639,7 @@ static struct radeon_asic rs600_asic = {
 	.gart = {
 		.tlb_flush = &rs600_gart_tlb_flush,
 		.set_page = &rs600_gart_set_page,
+		.set_pages = &rs600_gart_set_pages,
 	},
 	.ring = {
 		[RADEON_RING_TYPE_GFX_INDEX] = {
@@ -707,6 +716,7 @@ static struct radeon_asic rs690_asic = {
 	.gart = {
 		.tlb_flush = &rs400_gart_tlb_flush,
 		.set_page = &rs400_gart_set_page,
+		.set_pages = &rs400_gart_set_pages,
 	},
 	.ring = {
 		[RADEON_RING_TYPE_GFX_INDEX] = {
@@ -783,6 +793,7 @@ static struct radeon_asic rv515_asic = {
 	.gart = {
 		.tlb_flush = &rv370_pcie_gart_tlb_flush,
 		.set_page = &rv370_pcie_gart_set_page,
+		.set_pages = &rv370_pcie_gart_set_pages,
 	},
 	.ring = {
 		[RADEON_RING_TYPE_GFX_INDEX] = {
@@ -859,6 +870,7 @@ static struct radeon_asic r520_asic = {
 	.gart = {
 		.tlb_flush = &rv370_pcie_gart_tlb_flush,
 		.set_page = &rv370_pcie_gart_set_page,
+		.set_pages = &rv370_pcie_gart_set_pages,
 	},
 	.ring = {
 		[RADEON_RING_TYPE_GFX_INDEX] = {
@@ -935,6 +947,7 @@ static struct radeon_asic r600_asic = {
 	.gart = {
 		.tlb_flush = &r600_pcie_gart_tlb_flush,
 		.set_page = &rs600_gart_set_page,
+		.set_pages = &rs600_gart_set_pages,
 	},
 	.ring = {
 		[RADEON_RING_TYPE_GFX_INDEX] = {
@@ -1019,6 +1032,7 @@ static struct radeon_asic rs780_asic = {
 	.gart = {
 		.tlb_flush = &r600_pcie_gart_tlb_flush,
 		.set_page = &rs600_gart_set_page,
+		.set_pages = &rs600_gart_set_pages,
 	},
 	.ring = {
 		[RADEON_RING_TYPE_GFX_INDEX] = {
@@ -1103,6 +1117,7 @@ static struct radeon_asic rv770_asic = {
 	.gart = {
 		.tlb_flush = &r600_pcie_gart_tlb_flush,
 		.set_page = &rs600_gart_set_page,
+		.set_pages = &rs600_gart_set_pages,
 	},
 	.ring = {
 		[RADEON_RING_TYPE_GFX_INDEX] = {
@@ -1187,6 +1202,7 @@ static struct radeon_asic evergreen_asic = {
 	.gart = {
 		.tlb_flush = &evergreen_pcie_gart_tlb_flush,
 		.set_page = &rs600_gart_set_page,
+		.set_pages = &rs600_gart_set_pages,
 	},
 	.ring = {
 		[RADEON_RING_TYPE_GFX_INDEX] = {
@@ -1271,6 +1287,7 @@ static struct radeon_asic sumo_asic = {
 	.gart = {
 		.tlb_flush = &evergreen_pcie_gart_tlb_flush,
 		.set_page = &rs600_gart_set_page,
+		.set_pages = &rs600_gart_set_pages,
 	},
 	.ring = {
 		[RADEON_RING_TYPE_GFX_INDEX] = {
@@ -1355,6 +1372,7 @@ static struct radeon_asic btc_asic = {
 	.gart = {
 		.tlb_flush = &evergreen_pcie_gart_tlb_flush,
 		.set_page = &rs600_gart_set_page,
+		.set_pages = &rs600_gart_set_pages,
 	},
 	.ring = {
 		[RADEON_RING_TYPE_GFX_INDEX] = {
@@ -1439,6 +1457,7 @@ static struct radeon_asic cayman_asic = {
 	.gart = {
 		.tlb_flush = &cayman_pcie_gart_tlb_flush,
 		.set_page = &rs600_gart_set_page,
+		.set_pages = &rs600_gart_set_pages,
 	},
 	.vm = {
 		.init = &cayman_vm_init,
@@ -1566,6 +1585,7 @@ static struct radeon_asic trinity_asic = {
 	.gart = {
 		.tlb_flush = &cayman_pcie_gart_tlb_flush,
 		.set_page = &rs600_gart_set_page,
+		.set_pages = &rs600_gart_set_pages,
 	},
 	.vm = {
 		.init = &cayman_vm_init,
@@ -1693,6 +1713,7 @@ static struct radeon_asic si_asic = {
 	.gart = {
 		.tlb_flush = &si_pcie_gart_tlb_flush,
 		.set_page = &rs600_gart_set_page,
+		.set_pages = &rs600_gart_set_pages,
 	},
 	.vm = {
 		.init = &si_vm_init,
@@ -36,12 +36,242 @@ __FBSDID("$FreeBSD$");
 void r100_cs_dump_packet(struct radeon_cs_parser *p,
 			 struct radeon_cs_packet *pkt);
 
+/*
+ * Relocation handles are de-duplicated through an open-addressed table
+ * of reloc indices (biased by one, zero marks an empty slot) sized to at
+ * least twice the number of relocations. The table is cached in the file
+ * private data so that steady-state submissions do not allocate it. A
+ * cached table larger than needed is only used, and cleared, up to the
+ * size this submission wants, so one big submission does not make every
+ * later one clear the whole table.
+ */
+static uint32_t *radeon_cs_reloc_hash_get(struct radeon_cs_parser *p,
+					  unsigned *order,
+					  unsigned *alloc_order)
+{
+	struct radeon_fpriv *fpriv = p->filp->driver_priv;
+	uint32_t *hash = NULL;
+	unsigned want;
+
+	want = 1;
+	while ((1U << want) < p->nrelocs * 2)
+		want++;
+
+	if (fpriv != NULL) {
+		mtx_lock(&fpriv->cs_lock);
+		if (fpriv->reloc_hash != NULL &&
+		    fpriv->reloc_hash_order >= want) {
+			hash = fpriv->reloc_hash;
+			*alloc_order = fpriv->reloc_hash_order;
+			fpriv->reloc_hash = NULL;
+		}
+		mtx_unlock(&fpriv->cs_lock);
+	}
+
+	if (hash == NULL) {
+		hash = malloc(sizeof(uint32_t) << want, DRM_MEM_DRIVER,
+		    M_NOWAIT);
+		if (hash == NULL)
+			return NULL;
+		*alloc_order = want;
+	}
+	memset(hash, 0, sizeof(uint32_t) << want);
+	*order = want;
+	return hash;
+}
+
+static void radeon_cs_reloc_hash_put(struct radeon_cs_parser *p,
+				     uint32_t *hash, unsigned alloc_order)
+{
+	struct radeon_fpriv *fpriv = p->filp->driver_priv;
+	uint32_t *old = hash;
+
+	if (fpriv != NULL) {
+		mtx_lock(&fpriv->cs_lock);
+		if (fpriv->reloc_hash == NULL ||
+		    fpriv->reloc_hash_order < alloc_order) {
+			old = fpriv->reloc_hash;
+			fpriv->reloc_hash = hash;
+			fpriv->reloc_hash_order = alloc_order;
+		}
+		mtx_unlock(&fpriv->cs_lock);
+	}
+	free(old, DRM_MEM_DRIVER);
+}
+
+/*
+ * The parser borrows the file's arena for the duration of the ioctl. A
+ * second submission racing on the same file gets an empty arena, and its
+ * buffers are simply freed when it finishes.
+ */
+static void radeon_cs_arena_get(struct radeon_cs_parser *p)
+{
+	struct radeon_fpriv *fpriv = p->filp->driver_priv;
+
+	if (fpriv == NULL)
+		return;
+	mtx_lock(&fpriv->cs_lock);
+	if (!fpriv->cs_arena_busy) {
+		p->arena = fpriv->cs_arena;
+		memset(&fpriv->cs_arena, 0, sizeof(fpriv->cs_arena));
+		fpriv->cs_arena_busy = true;
+		p->arena_owned = true;
+	}
+	mtx_unlock(&fpriv->cs_lock);
+	if (!p->arena_owned)
+		atomic_add_long(&p->rdev->cs_stats.contended, 1);
+}
+
+/*
+ * Release the whole arena of a file that has not submitted for
+ * RADEON_CS_ARENA_IDLE seconds. The windowed shrink in
+ * radeon_cs_arena_put() only runs on submission, so it never gets to a
+ * file that stopped submitting.
+ */
+static void radeon_cs_arena_idle(void *arg)
+{
+	struct radeon_fpriv *fpriv = arg;
+	struct radeon_cs_arena *arena = &fpriv->cs_arena;
+	unsigned i, shrinks = 0;
+	int idle;
+
+	mtx_assert(&fpriv->cs_lock, MA_OWNED);
+	/* A parser holds the arena; putting it back re-arms the timer. */
+	if (fpriv->cs_arena_busy)
+		return;
+	idle = ticks - fpriv->cs_arena_used;
+	if (idle < RADEON_CS_ARENA_IDLE * hz) {
+		callout_reset(&fpriv->cs_arena_timer,
+		    RADEON_CS_ARENA_IDLE * hz - idle, radeon_cs_arena_idle,
+		    fpriv);
+		return;
+	}
+	for (i = 0; i < RADEON_CS_ARENA_NUM; i++) {
+		if (arena->buf[i] != NULL)
+			shrinks++;
+		arena->hwm[i] = 0;
+	}
+	radeon_cs_arena_fini(arena);
+	arena->submits = 0;
+	if (shrinks != 0)
+		atomic_add_long(&fpriv->rdev->cs_stats.shrinks, shrinks);
+}
+
+void radeon_cs_arena_init(struct radeon_fpriv *fpriv,
+			  struct radeon_device *rdev)
+{
+	fpriv->rdev = rdev;
+	callout_init_mtx(&fpriv->cs_arena_timer, &fpriv->cs_lock, 0);
+}
+
+static void radeon_cs_arena_put(struct radeon_cs_parser *p)
+{
+	struct radeon_fpriv *fpriv = p->filp->driver_priv;
+	struct radeon_cs_arena *arena = &p->arena;
+	unsigned i, shrinks = 0;
+
+	if (!p->arena_owned) {
+		radeon_cs_arena_fini(arena);
+	} else {
+		/*
+		 * At the end of each window drop the buffers that are more
+		 * than four times larger than anything requested during it;
+		 * the next submission reallocates them at the smaller size.
+		 */
+		if (++arena->submits == RADEON_CS_ARENA_WINDOW) {
+			for (i = 0; i < RADEON_CS_ARENA_NUM; i++) {
+				if (arena->buf[i] != NULL &&
+				    arena->size[i] > arena->hwm[i] * 4) {
+					free(arena->buf[i], DRM_MEM_DRIVER);
+					arena->buf[i] = NULL;
+					arena->size[i] = 0;
+					shrinks++;
+				}
+				arena->hwm[i] = 0;
+			}
+			arena->submits = 0;
+		}
+		mtx_lock(&fpriv->cs_lock);
+		fpriv->cs_arena = *arena;
+		fpriv->cs_arena_busy = false;
+		fpriv->cs_arena_used = ticks;
+		if (!callout_pending(&fpriv->cs_arena_timer))
+			callout_reset(&fpriv->cs_arena_timer,
+			    RADEON_CS_ARENA_IDLE * hz, radeon_cs_arena_idle,
+			    fpriv);
+		mtx_unlock(&fpriv->cs_lock);
+	}
+
+	atomic_add_long(&p->rdev->cs_stats.ioctls, 1);
+	if (p->nallocs != 0) {
+		atomic_add_long(&p->rdev->cs_stats.allocs, p->nallocs);
+		atomic_add_long(&p->rdev->cs_stats.alloc_bytes,
+		    p->alloc_bytes);
+	}
+	if (shrinks != 0)
+		atomic_add_long(&p->rdev->cs_stats.shrinks, shrinks);
+}
+
+/*
+ * Return a buffer of at least size bytes from the arena, growing it to
+ * the next power of two when the retained one is too small.
+ */
+static void *radeon_cs_arena_alloc(struct radeon_cs_parser *p, unsigned idx,
+				   size_t size, bool zero)
+{
+	struct radeon_cs_arena *arena = &p->arena;
+	size_t alloc;
+
+	if (size > arena->size[idx] || arena->buf[idx] == NULL) {
+		alloc = 64;
+		while (alloc < size)
+			alloc <<= 1;
+		free(arena->buf[idx], DRM_MEM_DRIVER);
+		arena->buf[idx] = malloc(alloc, DRM_MEM_DRIVER, M_NOWAIT);
+		if (arena->buf[idx] == NULL) {
+			arena->size[idx] = 0;
+			return NULL;
+		}
+		arena->size[idx] = alloc;
+		p->nallocs++;
+		p->alloc_bytes += alloc;
+	}
+	if (size > arena->hwm[idx])
+		arena->hwm[idx] = size;
+	if (zero)
+		memset(arena->buf[idx], 0, size);
+	return arena->buf[idx];
+}
+
+/*
+ * Frees the buffers of an arena. Before the file's own arena is freed
+ * at close, the idle timer must have been drained.
+ */
+void radeon_cs_arena_fini(struct radeon_cs_arena *arena)
+{
+	unsigned i;
+
+	for (i = 0; i < RADEON_CS_ARENA_NUM; i++) {
+		free(arena->buf[i], DRM_MEM_DRIVER);
+		arena->buf[i] = NULL;
+		arena->size[i] = 0;
+	}
+}
+
+static inline unsigned radeon_cs_reloc_hash_slot(uint32_t handle,
+						 unsigned order)
+{
+	return (handle * 0x9E3779B1U) >> (32 - order);
+}
+
 static int radeon_cs_parser_relocs(struct radeon_cs_parser *p)
 {
 	struct drm_device *ddev = p->rdev->ddev;
 	struct radeon_cs_chunk *chunk;
-	unsigned i, j;
+	uint32_t *hash;
+	unsigned i, j, order, alloc_order, mask;
 	bool duplicate;
+	int ret;
 
 	if (p->chunk_relocs_idx == -1) {
 		return 0;
@@ -50,35 +280,43 @@ static int radeon_cs_parser_relocs(struct radeon_cs_parser *p)
 	p->dma_reloc_idx = 0;
 	/* FIXME: we assume that each relocs use 4 dwords */
 	p->nrelocs = chunk->length_dw / 4;
-	p->relocs_ptr = malloc(p->nrelocs * sizeof(void *),
-	    DRM_MEM_DRIVER, M_NOWAIT | M_ZERO);
+	p->relocs_ptr = radeon_cs_arena_alloc(p, RADEON_CS_ARENA_RELOCS_PTR,
+	    p->nrelocs * sizeof(void *), true);
 	if (p->relocs_ptr == NULL) {
 		return -ENOMEM;
 	}
-	p->relocs = malloc(p->nrelocs * sizeof(struct radeon_cs_reloc),
-	    DRM_MEM_DRIVER, M_NOWAIT | M_ZERO);
+	p->relocs = radeon_cs_arena_alloc(p, RADEON_CS_ARENA_RELOCS,
+	    p->nrelocs * sizeof(struct radeon_cs_reloc), true);
 	if (p->relocs == NULL) {
 		return -ENOMEM;
 	}
+	hash = radeon_cs_reloc_hash_get(p, &order, &alloc_order);
+	if (hash == NULL) {
+		return -ENOMEM;
+	}
+	mask = (1U << order) - 1;
 	for (i = 0; i < p->nrelocs; i++) {
 		struct drm_radeon_cs_reloc *r;
 
 		duplicate = false;
 		r = (struct drm_radeon_cs_reloc *)&chunk->kdata[i*4];
-		for (j = 0; j < i; j++) {
-			if (r->handle == p->relocs[j].handle) {
-				p->relocs_ptr[i] = &p->relocs[j];
+		for (j = radeon_cs_reloc_hash_slot(r->handle, order);
+		     hash[j] != 0; j = (j + 1) & mask) {
+			if (r->handle == p->relocs[hash[j] - 1].handle) {
+				p->relocs_ptr[i] = &p->relocs[hash[j] - 1];
 				duplicate = true;
 				break;
 			}
 		}
 		if (!duplicate) {
+			hash[j] = i + 1;
 			p->relocs[i].gobj = drm_gem_object_lookup(ddev,
 								  p->filp,
 								  r->handle);
 			if (p->relocs[i].gobj == NULL) {
 				DRM_ERROR("gem object lookup failed 0x%x\n",
 					  r->handle);
+				radeon_cs_reloc_hash_put(p, hash, alloc_order);
 				return -ENOENT;
 			}
 			p->relocs_ptr[i] = &p->relocs[i];
@@ -95,7 +333,15 @@ static int radeon_cs_parser_relocs(struct radeon_cs_parser *p)
 		} else
 			p->relocs[i].handle = 0;
 	}
-	return radeon_bo_list_validate(&p->validated);
+	radeon_cs_reloc_hash_put(p, hash, alloc_order);
+	DRM_TRACE(ddev, DRM_TRACE_RELOC, p->ring, p->trace_id, 0);
+	/* one TLB flush for all the buffers bound to the GART */
+	radeon_gart_defer_flush(p->rdev);
+	ret = radeon_bo_list_validate(&p->validated);
+	radeon_gart_commit_flush(p->rdev);
+	if (ret == 0)
+		DRM_TRACE(ddev, DRM_TRACE_VALIDATE, p->ring, p->trace_id, 0);
+	return ret;
 }
 
 static int radeon_cs_get_ring(struct radeon_cs_parser *p, u32 ring, s32 priority)
@@ -163,7 +409,9 @@ int radeon_cs_parser_init(struct radeon_cs_parser *p, void *data)
 {
 	struct drm_radeon_cs *cs = data;
 	uint64_t *chunk_array_ptr;
+	uint64_t kdata_dw;
 	unsigned size, i;
+	uint32_t *kdata;
 	u32 ring = RADEON_CS_RING_GFX;
 	s32 priority = 0;
 
@@ -181,8 +429,10 @@ int radeon_cs_parser_init(struct radeon_cs_parser *p, void *data)
 	p->chunk_relocs_idx = -1;
 	p->chunk_flags_idx = -1;
 	p->chunk_const_ib_idx = -1;
-	p->chunks_array = malloc(cs->num_chunks * sizeof(uint64_t),
-	    DRM_MEM_DRIVER, M_NOWAIT | M_ZERO);
+	radeon_cs_arena_get(p);
+	p->chunks_array = radeon_cs_arena_alloc(p,
+	    RADEON_CS_ARENA_CHUNKS_ARRAY, cs->num_chunks * sizeof(uint64_t),
+	    true);
 	if (p->chunks_array == NULL) {
 		return -ENOMEM;
 	}
@@ -193,15 +443,15 @@ int radeon_cs_parser_init(struct radeon_cs_parser *p, void *data)
 	}
 	p->cs_flags = 0;
 	p->nchunks = cs->num_chunks;
-	p->chunks = malloc(p->nchunks * sizeof(struct radeon_cs_chunk),
-	    DRM_MEM_DRIVER, M_NOWAIT | M_ZERO);
+	p->chunks = radeon_cs_arena_alloc(p, RADEON_CS_ARENA_CHUNKS,
+	    p->nchunks * sizeof(struct radeon_cs_chunk), true);
 	if (p->chunks == NULL) {
 		return -ENOMEM;
 	}
+	kdata_dw = 0;
 	for (i = 0; i < p->nchunks; i++) {
 		struct drm_radeon_cs_chunk __user **chunk_ptr = NULL;
 		struct drm_radeon_cs_chunk user_chunk;
-		uint32_t __user *cdata;
 
 		chunk_ptr = (void __user*)(unsigned long)p->chunks_array[i];
 		if (DRM_COPY_FROM_USER(&user_chunk, chunk_ptr,
@@ -237,14 +487,27 @@ int radeon_cs_parser_init(struct radeon_cs_parser *p, void *data)
 		p->chunks[i].length_dw = user_chunk.length_dw;
 		p->chunks[i].user_ptr = (void __user *)(unsigned long)user_chunk.chunk_data;
 
-		cdata = (uint32_t *)(unsigned long)user_chunk.chunk_data;
+		if ((p->chunks[i].chunk_id == RADEON_CHUNK_ID_RELOCS) ||
+		    (p->chunks[i].chunk_id == RADEON_CHUNK_ID_FLAGS))
+			kdata_dw += p->chunks[i].length_dw;
+	}
+
+	/* copy relocs and flags into a single kdata buffer */
+	if (kdata_dw > UINT_MAX / sizeof(uint32_t))
+		return -EINVAL;
+	kdata = NULL;
+	if (kdata_dw != 0) {
+		kdata = radeon_cs_arena_alloc(p, RADEON_CS_ARENA_KDATA,
+		    kdata_dw * sizeof(uint32_t), false);
+		if (kdata == NULL)
+			return -ENOMEM;
+	}
+	for (i = 0; i < p->nchunks; i++) {
 		if ((p->chunks[i].chunk_id == RADEON_CHUNK_ID_RELOCS) ||
 		    (p->chunks[i].chunk_id == RADEON_CHUNK_ID_FLAGS)) {
 			size = p->chunks[i].length_dw * sizeof(uint32_t);
-			p->chunks[i].kdata = malloc(size, DRM_MEM_DRIVER, M_NOWAIT);
-			if (p->chunks[i].kdata == NULL) {
-				return -ENOMEM;
-			}
+			p->chunks[i].kdata = kdata;
+			kdata += p->chunks[i].length_dw;
 			if (DRM_COPY_FROM_USER(p->chunks[i].kdata,
 					       p->chunks[i].user_ptr, size)) {
 				return -EFAULT;
@@ -288,16 +551,13 @@ int radeon_cs_parser_init(struct radeon_cs_parser *p, void *data)
 			return -EINVAL;
 		}
 		if (p->rdev && (p->rdev->flags & RADEON_IS_AGP)) {
-			p->chunks[p->chunk_ib_idx].kpage[0] = malloc(PAGE_SIZE, DRM_MEM_DRIVER, M_NOWAIT);
-			p->chunks[p->chunk_ib_idx].kpage[1] = malloc(PAGE_SIZE, DRM_MEM_DRIVER, M_NOWAIT);
-			if (p->chunks[p->chunk_ib_idx].kpage[0] == NULL ||
-			    p->chunks[p->chunk_ib_idx].kpage[1] == NULL) {
-				free(p->chunks[p->chunk_ib_idx].kpage[0], DRM_MEM_DRIVER);
-				free(p->chunks[p->chunk_ib_idx].kpage[1], DRM_MEM_DRIVER);
-				p->chunks[p->chunk_ib_idx].kpage[0] = NULL;
-				p->chunks[p->chunk_ib_idx].kpage[1] = NULL;
+			kdata = radeon_cs_arena_alloc(p, RADEON_CS_ARENA_KPAGE,
+			    2 * PAGE_SIZE, false);
+			if (kdata == NULL)
 				return -ENOMEM;
-			}
+			p->chunks[p->chunk_ib_idx].kpage[0] = kdata;
+			p->chunks[p->chunk_ib_idx].kpage[1] =
+			    kdata + (PAGE_SIZE / 4);
 		}
 		p->chunks[p->chunk_ib_idx].kpage_idx[0] = -1;
 		p->chunks[p->chunk_ib_idx].kpage_idx[1] = -1;
@@ -335,17 +595,7 @@ static void radeon_cs_parser_fini(struct radeon_cs_parser *parser, int error)
 		}
 	}
 	free(parser->track, DRM_MEM_DRIVER);
-	free(parser->relocs, DRM_MEM_DRIVER);
-	free(parser->relocs_ptr, DRM_MEM_DRIVER);
-	for (i = 0; i < parser->nchunks; i++) {
-		free(parser->chunks[i].kdata, DRM_MEM_DRIVER);
-		if ((parser->rdev->flags & RADEON_IS_AGP)) {
-			free(parser->chunks[i].kpage[0], DRM_MEM_DRIVER);
-			free(parser->chunks[i].kpage[1], DRM_MEM_DRIVER);
-		}
-	}
-	free(parser->chunks, DRM_MEM_DRIVER);
-	free(parser->chunks_array, DRM_MEM_DRIVER);
+	radeon_cs_arena_put(parser);
 	radeon_ib_free(parser->rdev, &parser->ib);
 	radeon_ib_free(parser->rdev, &parser->const_ib);
 }
@@ -374,6 +624,16 @@ static int radeon_cs_ib_chunk(struct radeon_device *rdev,
 		return r;
 	}
 	parser->ib.length_dw = ib_chunk->length_dw;
+	/* Without AGP the parser reads the IB in place anyway, so copy
+	 * it in one pass instead of page by page.
+	 */
+	if ((rdev->flags & RADEON_IS_AGP) == 0) {
+		if (DRM_COPY_FROM_USER(parser->ib.ptr, ib_chunk->user_ptr,
+				       ib_chunk->length_dw * 4))
+			return -EFAULT;
+		ib_chunk->kdata = parser->ib.ptr;
+		ib_chunk->last_copied_page = ib_chunk->last_page_index;
+	}
 	r = radeon_cs_parse(rdev, parser->ring, parser);
 	if (r || parser->parser_error) {
 		DRM_ERROR("Invalid command stream !\n");
@@ -388,8 +648,11 @@ static int radeon_cs_ib_chunk(struct radeon_device *rdev,
 	r = radeon_ib_schedule(rdev, &parser->ib, NULL);
 	if (r) {
 		DRM_ERROR("Failed to schedule IB !\n");
+		return r;
 	}
-	return r;
+	DRM_TRACE(rdev->ddev, DRM_TRACE_EMIT, parser->ring, parser->trace_id,
+	    parser->ib.fence->seq);
+	return 0;
 }
 
 static int radeon_bo_vm_update_pte(struct radeon_cs_parser *parser,
@@ -498,6 +761,8 @@ static int radeon_cs_ib_vm_chunk(struct radeon_device *rdev,
 
 	if (!r) {
 		radeon_vm_fence(rdev, vm, parser->ib.fence);
+		DRM_TRACE(rdev->ddev, DRM_TRACE_EMIT, parser->ring,
+		    parser->trace_id, parser->ib.fence->seq);
 	}
 
 out:
@@ -530,6 +795,8 @@ int radeon_cs_ioctl(struct drm_device *dev, void *data, struct drm_file *filp)
 	}
 	/* initialize parser */
 	memset(&parser, 0, sizeof(struct radeon_cs_parser));
+	parser.trace_id = DRM_TRACE_ID(dev);
+	DRM_TRACE(dev, DRM_TRACE_SUBMIT, -1, parser.trace_id, 0);
 	parser.filp = filp;
 	parser.rdev = rdev;
 	parser.dev = rdev->dev;
@@ -639,6 +906,9 @@ u32 radeon_get_ib_value(struct radeon_cs_parser *p, int idx)
 	u32 idx_value = 0;
 	int new_page;
 
+	if (ibc->kdata != NULL)
+		return ibc->kdata[idx];
+
 	pg_idx = (idx * 4) / PAGE_SIZE;
 	pg_offset = (idx * 4) % PAGE_SIZE;
 
@@ -656,3 +926,37 @@ u32 radeon_get_ib_value(struct radeon_cs_parser *p, int idx)
 	idx_value = ibc->kpage[new_page][pg_offset/4];
 	return idx_value;
 }
+
+/**
+ * radeon_cs_sysctl_stats - report CS ioctl allocation statistics
+ *
+ * Sysctl handler printing how many CS ioctls were submitted, how many
+ * parser buffers they had to allocate and how often the per-file arena
+ * was shrunk or unavailable. arg1 is the drm_device.
+ */
+int radeon_cs_sysctl_stats(SYSCTL_HANDLER_ARGS)
+{
+	struct drm_device *dev = arg1;
+	struct radeon_device *rdev = dev->dev_private;
+	struct radeon_cs_stats *st;
+	struct sbuf m;
+	int error;
+
+	if (rdev == NULL)
+		return (EBUSY);
+	st = &rdev->cs_stats;
+	error = sysctl_wire_old_buffer(req, 0);
+	if (error != 0)
+		return (error);
+	sbuf_new_for_sysctl(&m, NULL, 128, req);
+	sbuf_printf(&m, "\n%lu ioctls, %lu allocs (%lu bytes), "
+	    "%lu shrinks, %lu contended", st->ioctls, st->allocs,
+	    st->alloc_bytes, st->shrinks, st->contended);
+	if (st->ioctls != 0)
+		sbuf_printf(&m, "\n%lu.%02lu allocs per ioctl",
+		    st->allocs / st->ioctls,
+		    (st->allocs * 100 / st->ioctls) % 100);
+	error = sbuf_finish(&m);
+	sbuf_delete(&m);
+	return (error);
+}
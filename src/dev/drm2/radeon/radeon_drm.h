@@ -798,6 +798,8 @@ struct drm_radeon_gem_info {
 };
 
 #define RADEON_GEM_NO_BACKING_STORE 1
+/* The buffer is written sequentially by the CPU, map it in large runs */
+#define RADEON_GEM_CPU_STREAMING (1 << 5)
 
 struct drm_radeon_gem_create {
 	uint64_t	size;
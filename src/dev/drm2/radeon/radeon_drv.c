@@ -126,6 +126,7 @@ int radeon_hw_i2c = 0;
 int radeon_pcie_gen2 = -1;
 int radeon_msi = -1;
 int radeon_lockup_timeout = 10000;
+int radeon_fence_spin_usecs = 20;
 
 TUNABLE_INT("drm.radeon.no_wb", &radeon_no_wb);
 MODULE_PARM_DESC(no_wb, "Disable AGP writeback for scratch registers");
@@ -195,6 +196,10 @@ TUNABLE_INT("drm.radeon.lockup_timeout", &radeon_lockup_timeout);
 MODULE_PARM_DESC(lockup_timeout, "GPU lockup timeout in ms (defaul 10000 = 10 seconds, 0 = disable)");
 module_param_named(lockup_timeout, radeon_lockup_timeout, int, 0444);
 
+TUNABLE_INT("drm.radeon.fence_spin_usecs", &radeon_fence_spin_usecs);
+MODULE_PARM_DESC(fence_spin_usecs, "Maximum time to busy-wait for a fence before sleeping, in us (default 20, 0 = disable)");
+module_param_named(fence_spin_usecs, radeon_fence_spin_usecs, int, 0444);
+
 static drm_pci_id_list_t pciidlist[] = {
 	radeon_PCI_IDS
 };
@@ -204,7 +209,23 @@ static struct drm_driver kms_driver;
 static int radeon_sysctl_init(struct drm_device *dev, struct sysctl_ctx_list *ctx,
 			      struct sysctl_oid *top)
 {
-	return drm_add_busid_modesetting(dev, ctx, top);
+	struct sysctl_oid *oid;
+	int ret;
+
+	ret = drm_add_busid_modesetting(dev, ctx, top);
+	if (ret != 0)
+		return ret;
+	oid = SYSCTL_ADD_PROC(ctx, SYSCTL_CHILDREN(top), OID_AUTO,
+	    "fence_stats", CTLTYPE_STRING | CTLFLAG_RD | CTLFLAG_MPSAFE, dev,
+	    0, radeon_fence_sysctl_stats, "A", "Fence wait statistics");
+	if (oid == NULL)
+		return -ENOMEM;
+	oid = SYSCTL_ADD_PROC(ctx, SYSCTL_CHILDREN(top), OID_AUTO,
+	    "cs_stats", CTLTYPE_STRING | CTLFLAG_RD | CTLFLAG_MPSAFE, dev,
+	    0, radeon_cs_sysctl_stats, "A", "CS ioctl allocation statistics");
+	if (oid == NULL)
+		return -ENOMEM;
+	return 0;
 }
 
 static struct drm_driver kms_driver = {
@@ -119,6 +119,35 @@ int radeon_fence_emit(struct radeon_device *rdev,
 	return 0;
 }
 
+/**
+ * radeon_fence_wakeup - wake up the waiters of a ring
+ *
+ * @rdev: radeon_device pointer
+ * @ring: ring index whose last_seq advanced
+ *
+ * Wake up the threads sleeping on this ring, and the threads waiting
+ * on several rings at once.  The queues are only locked when they have
+ * sleepers, so the interrupt path stays cheap when everyone is spinning
+ * or nobody waits.  The fence pairs with the one waiters issue between
+ * registering themselves and rechecking last_seq.
+ */
+static void radeon_fence_wakeup(struct radeon_device *rdev, int ring)
+{
+	struct radeon_fence_driver *drv = &rdev->fence_drv[ring];
+
+	atomic_thread_fence_seq_cst();
+	if (atomic_load_acq_int(&drv->waiters) != 0) {
+		mtx_lock(&drv->queue_mtx);
+		cv_broadcast(&drv->queue);
+		mtx_unlock(&drv->queue_mtx);
+	}
+	if (atomic_load_acq_int(&rdev->fence_any_waiters) != 0) {
+		mtx_lock(&rdev->fence_queue_mtx);
+		cv_broadcast(&rdev->fence_queue);
+		mtx_unlock(&rdev->fence_queue_mtx);
+	}
+}
+
 /**
  * radeon_fence_process - process a fence
  *
@@ -186,7 +215,8 @@ void radeon_fence_process(struct radeon_device *rdev, int ring)
 
 	if (wake) {
 		rdev->fence_drv[ring].last_activity = jiffies;
-		cv_broadcast(&rdev->fence_queue);
+		DRM_TRACE(rdev->ddev, DRM_TRACE_SIGNAL, ring, 0, seq);
+		radeon_fence_wakeup(rdev, ring);
 	}
 }
 
@@ -254,6 +284,127 @@ bool radeon_fence_signaled(struct radeon_fence *fence)
 	return false;
 }
 
+/* Waits between probes with the full budget once spinning is off. */
+#define RADEON_FENCE_SPIN_PROBE	16
+
+/**
+ * radeon_fence_spin_adapt - adjust the spin budget of a ring
+ *
+ * @drv: fence driver of the ring
+ * @hit: whether the last spin saw the sequence number pass
+ *
+ * A spin that succeeded restores the configured budget, one that ran out
+ * halves it, so rings running long jobs quickly stop burning CPU before
+ * sleeping.
+ */
+static void radeon_fence_spin_adapt(struct radeon_fence_driver *drv,
+				    bool hit)
+{
+	if (radeon_fence_spin_usecs <= 0)
+		drv->spin_usecs = 0;
+	else if (hit)
+		drv->spin_usecs = radeon_fence_spin_usecs;
+	else
+		drv->spin_usecs /= 2;
+}
+
+/**
+ * radeon_fence_spin - busy-wait briefly for a sequence number
+ *
+ * @rdev: radeon device pointer
+ * @target_seq: sequence number we want to wait for
+ * @ring: ring index the fence is associated with
+ *
+ * Poll the fence for at most the ring's current spin budget.  Short
+ * jobs usually finish before the interrupt could be armed and the
+ * thread put to sleep, so this avoids both for them.  Once the budget
+ * has dropped to zero, every RADEON_FENCE_SPIN_PROBE-th wait still
+ * spins with the full budget so that a ring going back to short jobs
+ * gets it back.
+ * Returns true if the sequence number passed while spinning.
+ */
+static bool radeon_fence_spin(struct radeon_device *rdev, u64 target_seq,
+			      unsigned ring)
+{
+	struct radeon_fence_driver *drv = &rdev->fence_drv[ring];
+	sbintime_t end;
+	u_int usecs;
+
+	usecs = drv->spin_usecs;
+	if (usecs == 0) {
+		if (radeon_fence_spin_usecs <= 0 ||
+		    ++drv->spin_skipped < RADEON_FENCE_SPIN_PROBE)
+			return false;
+		drv->spin_skipped = 0;
+		usecs = radeon_fence_spin_usecs;
+	}
+	end = sbinuptime() + usecs * SBT_1US;
+	do {
+		if (radeon_fence_seq_signaled(rdev, target_seq, ring)) {
+			atomic_add_long(&drv->spin_hits, 1);
+			radeon_fence_spin_adapt(drv, true);
+			return true;
+		}
+		cpu_spinwait();
+	} while (sbinuptime() < end);
+	atomic_add_long(&drv->spin_misses, 1);
+	radeon_fence_spin_adapt(drv, false);
+	return false;
+}
+
+/**
+ * radeon_fence_sleep - sleep until a sequence number passes
+ *
+ * @rdev: radeon device pointer
+ * @target_seq: sequence number we want to wait for
+ * @ring: ring index the fence is associated with
+ * @intr: use interruptable sleep
+ * @timeout: timeout of each sleep, in ticks
+ * @signaled: set to whether the sequence number passed
+ *
+ * Sleep on the ring's wait queue, woken by radeon_fence_process().
+ * The caller must hold a reference on the ring's sw interrupt.
+ * Returns 0 when woken up, ERESTARTSYS when interrupted and
+ * EWOULDBLOCK on timeout.
+ */
+static int radeon_fence_sleep(struct radeon_device *rdev, u64 target_seq,
+			      unsigned ring, bool intr, unsigned long timeout,
+			      bool *signaled)
+{
+	struct radeon_fence_driver *drv = &rdev->fence_drv[ring];
+	int r;
+
+	r = 0;
+	while (!(*signaled = radeon_fence_seq_signaled(rdev, target_seq,
+	    ring))) {
+		mtx_lock(&drv->queue_mtx);
+		atomic_add_int(&drv->waiters, 1);
+		atomic_thread_fence_seq_cst();
+		if (atomic64_read(&drv->last_seq) < target_seq) {
+			atomic_add_long(&drv->sleeps, 1);
+			if (intr) {
+				r = cv_timedwait_sig(&drv->queue,
+				    &drv->queue_mtx, timeout);
+			} else {
+				r = cv_timedwait(&drv->queue,
+				    &drv->queue_mtx, timeout);
+			}
+		}
+		atomic_subtract_int(&drv->waiters, 1);
+		mtx_unlock(&drv->queue_mtx);
+		if (r == EINTR)
+			r = ERESTARTSYS;
+		if (r != 0) {
+			if (r == EWOULDBLOCK) {
+				*signaled = radeon_fence_seq_signaled(rdev,
+				    target_seq, ring);
+			}
+			break;
+		}
+	}
+	return r;
+}
+
 /**
  * radeon_fence_wait_seq - wait for a specific sequence number
  *
@@ -264,6 +415,8 @@ bool radeon_fence_signaled(struct radeon_fence *fence)
  * @lock_ring: whether the ring should be locked or not
  *
  * Wait for the requested sequence number to be written (all asics).
+ * The fence is first polled for a short, adaptive amount of time, then
+ * the thread sleeps on the ring's wait queue until the fence interrupt.
  * @intr selects whether to use interruptable (true) or non-interruptable
  * (false) sleep when waiting for the sequence number.  Helper function
  * for radeon_fence_wait(), et al.
@@ -278,7 +431,7 @@ static int radeon_fence_wait_seq(struct radeon_device *rdev, u64 target_seq,
 	unsigned long timeout, last_activity;
 	uint64_t seq;
 	unsigned i;
-	bool signaled, fence_queue_locked;
+	bool signaled;
 	int r;
 
 	while (target_seq > atomic64_read(&rdev->fence_drv[ring].last_seq)) {
@@ -303,45 +456,20 @@ static int radeon_fence_wait_seq(struct radeon_device *rdev, u64 target_seq,
 		CTR2(KTR_DRM, "radeon fence: wait begin (ring=%d, seq=%d)",
 		    ring, seq);
 
-		radeon_irq_kms_sw_irq_get(rdev, ring);
-		fence_queue_locked = false;
 		r = 0;
-		while (!(signaled = radeon_fence_seq_signaled(rdev,
-		    target_seq, ring))) {
-			if (!fence_queue_locked) {
-				mtx_lock(&rdev->fence_queue_mtx);
-				fence_queue_locked = true;
-			}
-			if (intr) {
-				r = cv_timedwait_sig(&rdev->fence_queue,
-				    &rdev->fence_queue_mtx,
-				    timeout);
-			} else {
-				r = cv_timedwait(&rdev->fence_queue,
-				    &rdev->fence_queue_mtx,
-				    timeout);
-			}
-			if (r == EINTR)
-				r = ERESTARTSYS;
-			if (r != 0) {
-				if (r == EWOULDBLOCK) {
-					signaled =
-					    radeon_fence_seq_signaled(
-						rdev, target_seq, ring);
-				}
-				break;
-			}
-		}
-		if (fence_queue_locked) {
-			mtx_unlock(&rdev->fence_queue_mtx);
+		if (radeon_fence_spin(rdev, target_seq, ring)) {
+			signaled = true;
+		} else {
+			radeon_irq_kms_sw_irq_get(rdev, ring);
+			r = radeon_fence_sleep(rdev, target_seq, ring, intr,
+			    timeout, &signaled);
+			radeon_irq_kms_sw_irq_put(rdev, ring);
 		}
-		radeon_irq_kms_sw_irq_put(rdev, ring);
 		if (unlikely(r == ERESTARTSYS)) {
 			return -r;
 		}
 		CTR2(KTR_DRM, "radeon fence: wait end (ring=%d, seq=%d)",
 		    ring, seq);
-
 		if (unlikely(!signaled)) {
 #ifndef __FreeBSD__
 			/* we were interrupted for some reason and fence
@@ -435,6 +563,20 @@ static bool radeon_fence_any_seq_signaled(struct radeon_device *rdev, u64 *seq)
 	return false;
 }
 
+/* Like radeon_fence_any_seq_signaled() but without polling the hw. */
+static bool radeon_fence_any_seq_passed(struct radeon_device *rdev, u64 *seq)
+{
+	unsigned i;
+
+	for (i = 0; i < RADEON_NUM_RINGS; ++i) {
+		if (seq[i] &&
+		    atomic64_read(&rdev->fence_drv[i].last_seq) >= seq[i]) {
+			return true;
+		}
+	}
+	return false;
+}
+
 /**
  * radeon_fence_wait_any_seq - wait for a sequence number on any ring
  *
@@ -454,7 +596,7 @@ static int radeon_fence_wait_any_seq(struct radeon_device *rdev,
 {
 	unsigned long timeout, last_activity, tmp;
 	unsigned i, ring = RADEON_NUM_RINGS;
-	bool signaled, fence_queue_locked;
+	bool signaled;
 	int r;
 
 	for (i = 0, last_activity = 0; i < RADEON_NUM_RINGS; ++i) {
@@ -499,23 +641,25 @@ static int radeon_fence_wait_any_seq(struct radeon_device *rdev,
 				radeon_irq_kms_sw_irq_get(rdev, i);
 			}
 		}
-		fence_queue_locked = false;
 		r = 0;
 		while (!(signaled = radeon_fence_any_seq_signaled(rdev,
 		    target_seq))) {
-			if (!fence_queue_locked) {
-				mtx_lock(&rdev->fence_queue_mtx);
-				fence_queue_locked = true;
-			}
-			if (intr) {
-				r = cv_timedwait_sig(&rdev->fence_queue,
-				    &rdev->fence_queue_mtx,
-				    timeout);
-			} else {
-				r = cv_timedwait(&rdev->fence_queue,
-				    &rdev->fence_queue_mtx,
-				    timeout);
+			mtx_lock(&rdev->fence_queue_mtx);
+			atomic_add_int(&rdev->fence_any_waiters, 1);
+			atomic_thread_fence_seq_cst();
+			if (!radeon_fence_any_seq_passed(rdev, target_seq)) {
+				if (intr) {
+					r = cv_timedwait_sig(&rdev->fence_queue,
+					    &rdev->fence_queue_mtx,
+					    timeout);
+				} else {
+					r = cv_timedwait(&rdev->fence_queue,
+					    &rdev->fence_queue_mtx,
+					    timeout);
+				}
 			}
+			atomic_subtract_int(&rdev->fence_any_waiters, 1);
+			mtx_unlock(&rdev->fence_queue_mtx);
 			if (r == EINTR)
 				r = ERESTARTSYS;
 			if (r != 0) {
@@ -527,9 +671,6 @@ static int radeon_fence_wait_any_seq(struct radeon_device *rdev,
 				break;
 			}
 		}
-		if (fence_queue_locked) {
-			mtx_unlock(&rdev->fence_queue_mtx);
-		}
 		for (i = 0; i < RADEON_NUM_RINGS; ++i) {
 			if (target_seq[i]) {
 				radeon_irq_kms_sw_irq_put(rdev, i);
@@ -863,6 +1004,15 @@ static void radeon_fence_driver_init_ring(struct radeon_device *rdev, int ring)
 	atomic64_set(&rdev->fence_drv[ring].last_seq, 0);
 	rdev->fence_drv[ring].last_activity = jiffies;
 	rdev->fence_drv[ring].initialized = false;
+	mtx_init(&rdev->fence_drv[ring].queue_mtx,
+	    "drm__radeon_fence_driver__queue_mtx", NULL, MTX_DEF);
+	cv_init(&rdev->fence_drv[ring].queue, "drm__radeon_fence_driver__queue");
+	rdev->fence_drv[ring].waiters = 0;
+	rdev->fence_drv[ring].spin_usecs = max(radeon_fence_spin_usecs, 0);
+	rdev->fence_drv[ring].spin_hits = 0;
+	rdev->fence_drv[ring].spin_misses = 0;
+	rdev->fence_drv[ring].spin_skipped = 0;
+	rdev->fence_drv[ring].sleeps = 0;
 }
 
 /**
@@ -914,12 +1064,17 @@ void radeon_fence_driver_fini(struct radeon_device *rdev)
 			/* no need to trigger GPU reset as we are unloading */
 			radeon_fence_driver_force_completion(rdev);
 		}
-		cv_broadcast(&rdev->fence_queue);
+		radeon_fence_wakeup(rdev, ring);
 		radeon_scratch_free(rdev, rdev->fence_drv[ring].scratch_reg);
 		rdev->fence_drv[ring].initialized = false;
-		cv_destroy(&rdev->fence_queue);
 	}
 	sx_xunlock(&rdev->ring_lock);
+	for (ring = 0; ring < RADEON_NUM_RINGS; ring++) {
+		cv_destroy(&rdev->fence_drv[ring].queue);
+		mtx_destroy(&rdev->fence_drv[ring].queue_mtx);
+	}
+	cv_destroy(&rdev->fence_queue);
+	mtx_destroy(&rdev->fence_queue_mtx);
 }
 
 /**
@@ -941,6 +1096,40 @@ void radeon_fence_driver_force_completion(struct radeon_device *rdev)
 	}
 }
 
+/**
+ * radeon_fence_sysctl_stats - report fence wait statistics
+ *
+ * Sysctl handler printing, for each initialized ring, the current spin
+ * budget and how many waits were satisfied by spinning or had to sleep.
+ * arg1 is the drm_device; the radeon device is looked up at read time
+ * because the sysctl tree is created before the driver is loaded.
+ */
+int radeon_fence_sysctl_stats(SYSCTL_HANDLER_ARGS)
+{
+	struct drm_device *dev = arg1;
+	struct radeon_device *rdev = dev->dev_private;
+	struct radeon_fence_driver *drv;
+	struct sbuf m;
+	int error, i;
+
+	if (rdev == NULL)
+		return (EBUSY);
+	error = sysctl_wire_old_buffer(req, 0);
+	if (error != 0)
+		return (error);
+	sbuf_new_for_sysctl(&m, NULL, 128, req);
+	for (i = 0; i < RADEON_NUM_RINGS; ++i) {
+		drv = &rdev->fence_drv[i];
+		if (!drv->initialized)
+			continue;
+		sbuf_printf(&m, "\nring %d: spin %u us, %lu spin hits, "
+		    "%lu spin misses, %lu sleeps", i, drv->spin_usecs,
+		    drv->spin_hits, drv->spin_misses, drv->sleeps);
+	}
+	error = sbuf_finish(&m);
+	sbuf_delete(&m);
+	return (error);
+}
 
 /*
  * Fence debugfs
@@ -962,6 +1151,11 @@ static int radeon_debugfs_fence_info(struct seq_file *m, void *data)
 			   (unsigned long long)atomic64_read(&rdev->fence_drv[i].last_seq));
 		seq_printf(m, "Last emitted        0x%016llx\n",
 			   rdev->fence_drv[i].sync_seq[i]);
+		seq_printf(m, "Spin budget %u us, %lu spin hits, %lu misses, %lu sleeps\n",
+			   rdev->fence_drv[i].spin_usecs,
+			   rdev->fence_drv[i].spin_hits,
+			   rdev->fence_drv[i].spin_misses,
+			   rdev->fence_drv[i].sleeps);
 
 		for (j = 0; j < RADEON_NUM_RINGS; ++j) {
 			if (i != j && rdev->fence_drv[j].initialized)
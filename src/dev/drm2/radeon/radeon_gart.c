@@ -260,6 +260,124 @@ void radeon_gart_unbind(struct radeon_device *rdev, unsigned offset,
 	radeon_gart_tlb_flush(rdev);
 }
 
+/**
+ * radeon_gart_set_run - write the page table entries of a run of pages
+ *
+ * @rdev: radeon_device pointer
+ * @t: first GPU page table entry
+ * @npages: number of CPU pages in the run
+ * @addr: DMA address of the first page, the others follow it
+ *
+ * Writes the entries with a single call to the asic set_pages
+ * callback, or entry by entry if the asic has none (all asics).
+ */
+static void radeon_gart_set_run(struct radeon_device *rdev, unsigned t,
+				unsigned npages, uint64_t addr)
+{
+	unsigned count;
+
+	count = npages * (PAGE_SIZE / RADEON_GPU_PAGE_SIZE);
+	if (rdev->asic->gart.set_pages != NULL) {
+		radeon_gart_set_pages(rdev, t, count, addr);
+		return;
+	}
+	for (; count > 0; count--, t++, addr += RADEON_GPU_PAGE_SIZE)
+		radeon_gart_set_page(rdev, t, addr);
+}
+
+/**
+ * radeon_gart_set_runs - write the page table entries of a page range
+ *
+ * @rdev: radeon_device pointer
+ * @t: first GPU page table entry
+ * @pages: number of CPU pages
+ * @dma_addr: DMA addresses of the pages
+ *
+ * Coalesces pages with contiguous DMA addresses into runs written
+ * with radeon_gart_set_run() (all asics).
+ */
+static void radeon_gart_set_runs(struct radeon_device *rdev, unsigned t,
+				 int pages, dma_addr_t *dma_addr)
+{
+	int i, j;
+
+	for (i = 0; i < pages; i = j) {
+		for (j = i + 1; j < pages &&
+		     dma_addr[j] == dma_addr[j - 1] + PAGE_SIZE; j++)
+			;
+		radeon_gart_set_run(rdev, t, j - i, dma_addr[i]);
+		t += (j - i) * (PAGE_SIZE / RADEON_GPU_PAGE_SIZE);
+	}
+}
+
+/**
+ * radeon_gart_flush - flush the gart TLB after page table updates
+ *
+ * @rdev: radeon_device pointer
+ *
+ * Flushes the TLB, unless the calling thread batches its flushes
+ * with radeon_gart_defer_flush() (all asics).
+ */
+static void radeon_gart_flush(struct radeon_device *rdev)
+{
+	mb();
+	if (rdev->gart.flush_defer_td == curthread) {
+		rdev->gart.flush_pending = true;
+		return;
+	}
+	radeon_gart_tlb_flush(rdev);
+}
+
+/**
+ * radeon_gart_defer_flush - start batching gart TLB flushes
+ *
+ * @rdev: radeon_device pointer
+ *
+ * Until radeon_gart_commit_flush(), binds done by the calling thread
+ * skip the TLB flush and the commit does a single flush for all of
+ * them.  Only one thread batches at a time, binds done by others
+ * flush as usual (all asics).
+ */
+void radeon_gart_defer_flush(struct radeon_device *rdev)
+{
+	atomic_cmpset_ptr((volatile uintptr_t *)&rdev->gart.flush_defer_td,
+	    (uintptr_t)NULL, (uintptr_t)curthread);
+}
+
+/**
+ * radeon_gart_sync_flush - flush the batched gart TLB flushes
+ *
+ * @rdev: radeon_device pointer
+ *
+ * Must be called by the batching thread before the GPU accesses the
+ * pages bound since radeon_gart_defer_flush(), e.g. for a blit in the
+ * middle of a validation.  Batching continues afterwards (all asics).
+ */
+void radeon_gart_sync_flush(struct radeon_device *rdev)
+{
+	if (rdev->gart.flush_defer_td != curthread ||
+	    !rdev->gart.flush_pending)
+		return;
+	rdev->gart.flush_pending = false;
+	radeon_gart_tlb_flush(rdev);
+}
+
+/**
+ * radeon_gart_commit_flush - stop batching gart TLB flushes
+ *
+ * @rdev: radeon_device pointer
+ *
+ * Does the batched TLB flush, if any bind needed it (all asics).
+ */
+void radeon_gart_commit_flush(struct radeon_device *rdev)
+{
+	if (rdev->gart.flush_defer_td != curthread)
+		return;
+	radeon_gart_sync_flush(rdev);
+	atomic_store_rel_ptr((volatile uintptr_t *)&rdev->gart.flush_defer_td,
+	    (uintptr_t)NULL);
+}
+
 /**
  * radeon_gart_bind - bind pages into the gart page table
  *
@@ -278,8 +396,7 @@ int radeon_gart_bind(struct radeon_device *rdev, unsigned offset,
 {
 	unsigned t;
 	unsigned p;
-	uint64_t page_base;
-	int i, j;
+	int i;
 
 	if (!rdev->gart.ready) {
 		DRM_ERROR("trying to bind memory to uninitialized GART !\n");
@@ -288,19 +405,14 @@ int radeon_gart_bind(struct radeon_device *rdev, unsigned offset,
 	t = offset / RADEON_GPU_PAGE_SIZE;
 	p = t / (PAGE_SIZE / RADEON_GPU_PAGE_SIZE);
 
-	for (i = 0; i < pages; i++, p++) {
-		rdev->gart.pages_addr[p] = dma_addr[i];
-		rdev->gart.pages[p] = pagelist[i];
-		if (rdev->gart.ptr) {
-			page_base = rdev->gart.pages_addr[p];
-			for (j = 0; j < (PAGE_SIZE / RADEON_GPU_PAGE_SIZE); j++, t++) {
-				radeon_gart_set_page(rdev, t, page_base);
-				page_base += RADEON_GPU_PAGE_SIZE;
-			}
-		}
+	for (i = 0; i < pages; i++) {
+		rdev->gart.pages_addr[p + i] = dma_addr[i];
+		rdev->gart.pages[p + i] = pagelist[i];
 	}
-	mb();
-	radeon_gart_tlb_flush(rdev);
+	if (rdev->gart.ptr) {
+		radeon_gart_set_runs(rdev, t, pages, dma_addr);
+	}
+	radeon_gart_flush(rdev);
 	return 0;
 }
 
@@ -314,19 +426,11 @@ int radeon_gart_bind(struct radeon_device *rdev, unsigned offset,
  */
 void radeon_gart_restore(struct radeon_device *rdev)
 {
-	int i, j, t;
-	u64 page_base;
-
 	if (!rdev->gart.ptr) {
 		return;
 	}
-	for (i = 0, t = 0; i < rdev->gart.num_cpu_pages; i++) {
-		page_base = rdev->gart.pages_addr[i];
-		for (j = 0; j < (PAGE_SIZE / RADEON_GPU_PAGE_SIZE); j++, t++) {
-			radeon_gart_set_page(rdev, t, page_base);
-			page_base += RADEON_GPU_PAGE_SIZE;
-		}
-	}
+	radeon_gart_set_runs(rdev, 0, rdev->gart.num_cpu_pages,
+			     rdev->gart.pages_addr);
 	mb();
 	radeon_gart_tlb_flush(rdev);
 }
@@ -274,6 +274,9 @@ int radeon_gem_create_ioctl(struct drm_device *dev, void *data,
 		r = radeon_gem_handle_lockup(rdev, r);
 		return r;
 	}
+	if (args->flags & RADEON_GEM_CPU_STREAMING)
+		set_bit(TTM_BO_PRIV_FLAG_PREFAULT,
+		    &gem_to_radeon_bo(gobj)->tbo.priv_flags);
 	r = drm_gem_handle_create(filp, gobj, &handle);
 	/* drop reference from allocate - handle holds it now */
 	drm_gem_object_unreference_unlocked(gobj);
@@ -261,6 +261,9 @@ static int radeon_move_blit(struct ttm_buffer_object *bo,
 
 	CTASSERT((PAGE_SIZE % RADEON_GPU_PAGE_SIZE) == 0);
 
+	/* the blit may go through pages bound with a batched flush */
+	radeon_gart_sync_flush(rdev);
+
 	/* sync other rings */
 	fence = bo->sync_obj;
 	r = radeon_copy(rdev, old_start, new_start,
@@ -228,6 +228,21 @@ int rs400_gart_set_page(struct radeon_device *rdev, int i, uint64_t addr)
 	return 0;
 }
 
+int rs400_gart_set_pages(struct radeon_device *rdev, int i, unsigned count,
+			 uint64_t addr)
+{
+	u32 *gtt = rdev->gart.ptr;
+
+	if (i < 0 || i + count > rdev->gart.num_gpu_pages) {
+		return -EINVAL;
+	}
+	for (gtt += i; count > 0; count--, addr += RADEON_GPU_PAGE_SIZE)
+		*gtt++ = cpu_to_le32((lower_32_bits(addr) & ~PAGE_MASK) |
+				     ((upper_32_bits(addr) & 0xff) << 4) |
+				     RS400_PTE_WRITEABLE | RS400_PTE_READABLE);
+	return 0;
+}
+
 int rs400_mc_wait_for_idle(struct radeon_device *rdev)
 {
 	unsigned i;
@@ -594,6 +594,25 @@ int rs600_gart_set_page(struct radeon_device *rdev, int i, uint64_t addr)
 	return 0;
 }
 
+int rs600_gart_set_pages(struct radeon_device *rdev, int i, unsigned count,
+			 uint64_t addr)
+{
+	uint64_t *ptr = rdev->gart.ptr;
+	uint64_t flags;
+
+	if (i < 0 || i + count > rdev->gart.num_gpu_pages) {
+		return -EINVAL;
+	}
+	flags = R600_PTE_VALID | R600_PTE_SYSTEM | R600_PTE_SNOOPED |
+		R600_PTE_READABLE | R600_PTE_WRITEABLE;
+	addr &= 0xFFFFFFFFFFFFF000ULL;
+	/* on r600 and later the table is in write-combined VRAM, keep
+	 * the stores sequential so they are merged into full bursts */
+	for (ptr += i; count > 0; count--, addr += RADEON_GPU_PAGE_SIZE)
+		*ptr++ = addr | flags;
+	return 0;
+}
+
 int rs600_irq_set(struct radeon_device *rdev)
 {
 	uint32_t tmp = 0;
@@ -47,6 +47,21 @@ static void ttm_bo_global_kobj_release(struct ttm_bo_global *glob);
 
 MALLOC_DEFINE(M_TTM_BO, "ttm_bo", "TTM Buffer Objects");
 
+static SYSCTL_NODE(_hw_drm, OID_AUTO, ttm_evict, CTLFLAG_RW, NULL,
+    "TTM eviction statistics");
+static u_long ttm_evict_scans;
+SYSCTL_ULONG(_hw_drm_ttm_evict, OID_AUTO, scans, CTLFLAG_RD,
+    &ttm_evict_scans, 0, "Eviction roster scans");
+static u_long ttm_evict_fallbacks;
+SYSCTL_ULONG(_hw_drm_ttm_evict, OID_AUTO, fallbacks, CTLFLAG_RD,
+    &ttm_evict_fallbacks, 0, "Scans that found no usable set of buffers");
+static u_long ttm_evict_batch_bos;
+SYSCTL_ULONG(_hw_drm_ttm_evict, OID_AUTO, batch_bos, CTLFLAG_RD,
+    &ttm_evict_batch_bos, 0, "Buffers evicted in batches");
+static u_long ttm_evict_single;
+SYSCTL_ULONG(_hw_drm_ttm_evict, OID_AUTO, single, CTLFLAG_RD,
+    &ttm_evict_single, 0, "Buffers evicted one at a time from the LRU head");
+
 static inline int ttm_mem_type_from_flags(uint32_t flags, uint32_t *mem_type)
 {
 	int i;
@@ -904,6 +919,91 @@ static int ttm_mem_evict_first(struct ttm_bo_device *bdev,
 	return ret;
 }
 
+/**
+ * Evict, in one go, a set of buffers whose space together forms a range
+ * large enough for @mem, as chosen by the manager's evict_scan hook.
+ * The victims are reserved and taken off the LRU under a single hold of
+ * the lru lock, then evicted one after the other; ttm_bo_evict() still
+ * waits for each victim to go idle before moving it.
+ * Returns the number of buffers evicted, 0 if no such set was found or a
+ * victim is busy, in which case the caller should fall back to evicting
+ * from the head of the LRU, or a negative error code.
+ */
+static int ttm_mem_evict_batch(struct ttm_bo_device *bdev,
+			       uint32_t mem_type,
+			       struct ttm_placement *placement,
+			       struct ttm_mem_reg *mem,
+			       bool interruptible,
+			       bool no_wait_gpu)
+{
+	struct ttm_bo_global *glob = bdev->glob;
+	struct ttm_mem_type_manager *man = &bdev->man[mem_type];
+	struct ttm_buffer_object *bo, *tmp, *busy;
+	struct list_head victims;
+	int count, put_count, ret;
+
+	if (man->func->evict_scan == NULL)
+		return 0;
+
+	INIT_LIST_HEAD(&victims);
+	mtx_lock(&glob->lru_lock);
+	atomic_add_long(&ttm_evict_scans, 1);
+	if (!(*man->func->evict_scan)(man, placement, mem, &victims)) {
+		mtx_unlock(&glob->lru_lock);
+		atomic_add_long(&ttm_evict_fallbacks, 1);
+		return 0;
+	}
+
+	list_for_each_entry(bo, &victims, evict_scan) {
+		if (!list_empty(&bo->ddestroy) ||
+		    ttm_bo_reserve_nolru(bo, false, true, false, 0) != 0) {
+			busy = bo;
+			goto busy;
+		}
+	}
+
+	count = 0;
+	list_for_each_entry(bo, &victims, evict_scan) {
+		refcount_acquire(&bo->list_kref);
+		put_count = ttm_bo_del_from_lru(bo);
+		ttm_bo_list_ref_sub(bo, put_count, true);
+		count++;
+	}
+	mtx_unlock(&glob->lru_lock);
+
+	ret = 0;
+	list_for_each_entry_safe(bo, tmp, &victims, evict_scan) {
+		list_del_init(&bo->evict_scan);
+		if (ret == 0)
+			ret = ttm_bo_evict(bo, interruptible, no_wait_gpu);
+		ttm_bo_unreserve(bo);
+		if (refcount_release(&bo->list_kref))
+			ttm_bo_release_list(bo);
+	}
+	if (ret != 0)
+		return ret;
+
+	atomic_add_long(&ttm_evict_batch_bos, count);
+	return count;
+
+busy:
+	/* Drop the reservations taken so far, leaving the LRU as it was. */
+	list_for_each_entry_safe(bo, tmp, &victims, evict_scan) {
+		list_del_init(&bo->evict_scan);
+		if (busy != NULL) {
+			if (bo == busy) {
+				busy = NULL;
+				continue;
+			}
+			atomic_set(&bo->reserved, 0);
+			wakeup(bo);
+		}
+	}
+	mtx_unlock(&glob->lru_lock);
+	atomic_add_long(&ttm_evict_fallbacks, 1);
+	return 0;
+}
+
 void ttm_bo_mem_put(struct ttm_buffer_object *bo, struct ttm_mem_reg *mem)
 {
 	struct ttm_mem_type_manager *man = &bo->bdev->man[mem->mem_type];
@@ -933,9 +1033,15 @@ static int ttm_bo_mem_force_space(struct ttm_buffer_object *bo,
 			return ret;
 		if (mem->mm_node)
 			break;
-		ret = ttm_mem_evict_first(bdev, mem_type,
+		ret = ttm_mem_evict_batch(bdev, mem_type, placement, mem,
 					  interruptible, no_wait_gpu);
-		if (unlikely(ret != 0))
+		if (ret == 0) {
+			ret = ttm_mem_evict_first(bdev, mem_type,
+						  interruptible, no_wait_gpu);
+			if (ret == 0)
+				atomic_add_long(&ttm_evict_single, 1);
+		}
+		if (unlikely(ret < 0))
 			return ret;
 	} while (1);
 	if (mem->mm_node == NULL)
@@ -1260,6 +1366,7 @@ int ttm_bo_init(struct ttm_bo_device *bdev,
 	INIT_LIST_HEAD(&bo->ddestroy);
 	INIT_LIST_HEAD(&bo->swap);
 	INIT_LIST_HEAD(&bo->io_reserve_lru);
+	INIT_LIST_HEAD(&bo->evict_scan);
 	bo->bdev = bdev;
 	bo->glob = bdev->glob;
 	bo->type = type;
@@ -228,6 +228,7 @@ struct ttm_buffer_object {
 	struct list_head ddestroy;
 	struct list_head swap;
 	struct list_head io_reserve_lru;
+	struct list_head evict_scan;
 	uint32_t val_seq;
 	bool seq_valid;
 
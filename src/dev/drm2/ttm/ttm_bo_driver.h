@@ -230,6 +230,26 @@ struct ttm_mem_type_manager_func {
 	 * It may not be called from within atomic context.
 	 */
 	void (*debug)(struct ttm_mem_type_manager *man, const char *prefix);
+
+	/**
+	 * struct ttm_mem_type_manager member evict_scan
+	 *
+	 * @man: Pointer to a memory type manager.
+	 * @placement: Placement details.
+	 * @mem: The memory region that could not be allocated.
+	 * @victims: List to put the chosen buffer objects on.
+	 *
+	 * Optional.  This function should walk @man::lru from the least
+	 * recently used end and pick the buffer objects whose eviction
+	 * frees a range large enough for @mem, linking them on @victims
+	 * through their evict_scan member.  It returns true if such a set
+	 * was found and false, with @victims empty, otherwise.
+	 * Called with the global lru lock held.
+	 */
+	bool (*evict_scan)(struct ttm_mem_type_manager *man,
+			   struct ttm_placement *placement,
+			   struct ttm_mem_reg *mem,
+			   struct list_head *victims);
 };
 
 /**
@@ -510,7 +530,9 @@ struct ttm_bo_global {
 
 #define TTM_BO_PRIV_FLAG_MOVING  0	/* Buffer object is moving and needs
 					   idling before CPU mapping */
-#define TTM_BO_PRIV_FLAG_MAX 1
+#define TTM_BO_PRIV_FLAG_PREFAULT 1	/* Map as much of the buffer object
+					   as possible on each CPU fault */
+#define TTM_BO_PRIV_FLAG_MAX 2
 /**
  * struct ttm_bo_device - Buffer object driver device-specific data.
  *
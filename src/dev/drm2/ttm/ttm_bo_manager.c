@@ -148,10 +148,58 @@ static void ttm_bo_man_debug(struct ttm_mem_type_manager *man,
 	mtx_unlock(&rman->lock);
 }
 
+static bool ttm_bo_man_evict_scan(struct ttm_mem_type_manager *man,
+				  struct ttm_placement *placement,
+				  struct ttm_mem_reg *mem,
+				  struct list_head *victims)
+{
+	struct ttm_range_manager *rman = (struct ttm_range_manager *) man->priv;
+	struct ttm_buffer_object *bo, *next;
+	struct list_head roster;
+	unsigned long lpfn;
+	bool found;
+
+	lpfn = placement->lpfn;
+	if (!lpfn)
+		lpfn = man->size;
+
+	INIT_LIST_HEAD(&roster);
+	found = false;
+	mtx_lock(&rman->lock);
+	drm_mm_init_scan_with_range(&rman->mm, mem->num_pages,
+				    mem->page_alignment, 0,
+				    placement->fpfn, lpfn);
+	list_for_each_entry(bo, &man->lru, lru) {
+		if (bo->mem.mm_node == NULL)
+			continue;
+		list_add(&bo->evict_scan, &roster);
+		if (drm_mm_scan_add_block(bo->mem.mm_node)) {
+			found = true;
+			break;
+		}
+	}
+
+	/*
+	 * Every scanned block has to be removed again, in reverse order,
+	 * before the allocator may be used; the roster is already in that
+	 * order.  Keep the ones overlapping the hole that was found.
+	 */
+	list_for_each_entry_safe(bo, next, &roster, evict_scan) {
+		if (drm_mm_scan_remove_block(bo->mem.mm_node) && found)
+			list_move_tail(&bo->evict_scan, victims);
+		else
+			list_del_init(&bo->evict_scan);
+	}
+	mtx_unlock(&rman->lock);
+
+	return found;
+}
+
 const struct ttm_mem_type_manager_func ttm_bo_manager_func = {
 	ttm_bo_man_init,
 	ttm_bo_man_takedown,
 	ttm_bo_man_get_node,
 	ttm_bo_man_put_node,
-	ttm_bo_man_debug
+	ttm_bo_man_debug,
+	ttm_bo_man_evict_scan
 };
@@ -50,6 +50,21 @@ __FBSDID("$FreeBSD$");
 #include <vm/vm_pageout.h>
 
 #define TTM_BO_VM_NUM_PREFAULT 16
+#define TTM_BO_VM_MAX_PREFAULT 512
+
+static SYSCTL_NODE(_hw_drm, OID_AUTO, ttm_vm, CTLFLAG_RW, NULL,
+    "TTM CPU mappings");
+static int ttm_bo_vm_prefault = TTM_BO_VM_NUM_PREFAULT;
+TUNABLE_INT("hw.drm.ttm_vm.fault_around", &ttm_bo_vm_prefault);
+SYSCTL_INT(_hw_drm_ttm_vm, OID_AUTO, fault_around, CTLFLAG_RW,
+    &ttm_bo_vm_prefault, 0,
+    "Pages mapped per fault (max 512, 0 or 1 disables)");
+static u_long ttm_bo_vm_faults;
+SYSCTL_ULONG(_hw_drm_ttm_vm, OID_AUTO, faults, CTLFLAG_RD,
+    &ttm_bo_vm_faults, 0, "CPU mapping faults");
+static u_long ttm_bo_vm_fault_pages;
+SYSCTL_ULONG(_hw_drm_ttm_vm, OID_AUTO, fault_pages, CTLFLAG_RD,
+    &ttm_bo_vm_fault_pages, 0, "Pages mapped by CPU mapping faults");
 
 RB_GENERATE(ttm_bo_device_buffer_objects, ttm_buffer_object, vm_rb,
     ttm_bo_cmp_rb_tree_items);
@@ -98,9 +113,96 @@ static struct ttm_buffer_object *ttm_bo_vm_lookup_rb(struct ttm_bo_device *bdev,
 	return best_bo;
 }
 
+/*
+ * Return the page backing index pidx of the buffer object, with the
+ * memory attribute of the current placement applied.
+ */
+static vm_page_t
+ttm_bo_vm_page(struct ttm_buffer_object *bo, vm_pindex_t pidx)
+{
+	vm_page_t m;
+
+	if (bo->mem.bus.is_iomem) {
+		m = PHYS_TO_VM_PAGE(bo->mem.bus.base + bo->mem.bus.offset +
+		    IDX_TO_OFF(pidx));
+		KASSERT((m->flags & PG_FICTITIOUS) != 0,
+		    ("physical address %#jx not fictitious",
+		    (uintmax_t)(bo->mem.bus.base + bo->mem.bus.offset
+		    + IDX_TO_OFF(pidx))));
+		pmap_page_set_memattr(m, ttm_io_prot(bo->mem.placement));
+	} else {
+		m = bo->ttm->pages[pidx];
+		if (unlikely(m == NULL))
+			return (NULL);
+		pmap_page_set_memattr(m,
+		    (bo->mem.placement & TTM_PL_FLAG_CACHED) ?
+		    VM_MEMATTR_WRITE_BACK : ttm_io_prot(bo->mem.placement));
+	}
+	return (m);
+}
+
+/*
+ * Insert and busy a page next to the faulting one.  Give up instead of
+ * sleeping when the page is busy or memory is short; the fault-around
+ * range simply ends there.
+ */
+static bool
+ttm_bo_vm_insert_page(vm_object_t vm_obj, struct ttm_buffer_object *bo,
+    vm_pindex_t pidx)
+{
+	vm_page_t m;
+
+	m = vm_page_lookup(vm_obj, pidx);
+	if (m == NULL) {
+		m = ttm_bo_vm_page(bo, pidx);
+		if (m == NULL || vm_page_busied(m) ||
+		    vm_page_insert(m, vm_obj, pidx))
+			return (false);
+		m->valid = VM_PAGE_BITS_ALL;
+	} else if (vm_page_busied(m))
+		return (false);
+	vm_page_xbusy(m);
+	return (true);
+}
+
+/*
+ * Grow the populated range [*first, *last], which holds the faulting
+ * page, to the aligned window around it.  Buffer objects created with
+ * the prefault flag use the largest window, so that a streaming writer
+ * maps the whole buffer, or large chunks of it, on its first access.
+ */
+static void
+ttm_bo_vm_fault_around(vm_object_t vm_obj, struct ttm_buffer_object *bo,
+    vm_pindex_t pidx, vm_pindex_t *first, vm_pindex_t *last)
+{
+	vm_pindex_t start, end, idx;
+	int window;
+
+	VM_OBJECT_ASSERT_WLOCKED(vm_obj);
+	if (test_bit(TTM_BO_PRIV_FLAG_PREFAULT, &bo->priv_flags))
+		window = TTM_BO_VM_MAX_PREFAULT;
+	else
+		window = min(ttm_bo_vm_prefault, TTM_BO_VM_MAX_PREFAULT);
+	if (window <= 1)
+		return;
+	start = rounddown(pidx, window);
+	end = MIN(start + window, bo->num_pages) - 1;
+
+	for (idx = pidx; idx > start; idx--) {
+		if (!ttm_bo_vm_insert_page(vm_obj, bo, idx - 1))
+			break;
+	}
+	*first = idx;
+	for (idx = pidx; idx < end; idx++) {
+		if (!ttm_bo_vm_insert_page(vm_obj, bo, idx + 1))
+			break;
+	}
+	*last = idx;
+}
+
 static int
-ttm_bo_vm_fault(vm_object_t vm_obj, vm_ooffset_t offset,
-    int prot, vm_page_t *mres)
+ttm_bo_vm_populate(vm_object_t vm_obj, vm_pindex_t pidx, int fault_type,
+    vm_prot_t max_prot, vm_pindex_t *first, vm_pindex_t *last)
 {
 
 	struct ttm_buffer_object *bo = vm_obj->handle;
@@ -109,15 +211,9 @@ ttm_bo_vm_fault(vm_object_t vm_obj, vm_ooffset_t offset,
 	vm_page_t m, m1;
 	int ret;
 	int retval = VM_PAGER_OK;
-	struct ttm_mem_type_manager *man =
-		&bdev->man[bo->mem.mem_type];
+	struct ttm_mem_type_manager *man;
 
 	vm_object_pip_add(vm_obj, 1);
-	if (*mres != NULL) {
-		vm_page_lock(*mres);
-		vm_page_remove(*mres);
-		vm_page_unlock(*mres);
-	}
 retry:
 	VM_OBJECT_WUNLOCK(vm_obj);
 	m = NULL;
@@ -147,6 +243,12 @@ reserve:
 		}
 	}
 
+	/*
+	 * The notify hook may have moved the buffer, so look the
+	 * manager up only now.
+	 */
+	man = &bdev->man[bo->mem.mem_type];
+
 	/*
 	 * Wait for buffer data in transit, due to a pipelined
 	 * move.
@@ -212,24 +314,10 @@ reserve:
 		}
 	}
 
-	if (bo->mem.bus.is_iomem) {
-		m = PHYS_TO_VM_PAGE(bo->mem.bus.base + bo->mem.bus.offset +
-		    offset);
-		KASSERT((m->flags & PG_FICTITIOUS) != 0,
-		    ("physical address %#jx not fictitious",
-		    (uintmax_t)(bo->mem.bus.base + bo->mem.bus.offset
-		    + offset)));
-		pmap_page_set_memattr(m, ttm_io_prot(bo->mem.placement));
-	} else {
-		ttm = bo->ttm;
-		m = ttm->pages[OFF_TO_IDX(offset)];
-		if (unlikely(!m)) {
-			retval = VM_PAGER_ERROR;
-			goto out_io_unlock;
-		}
-		pmap_page_set_memattr(m,
-		    (bo->mem.placement & TTM_PL_FLAG_CACHED) ?
-		    VM_MEMATTR_WRITE_BACK : ttm_io_prot(bo->mem.placement));
+	m = ttm_bo_vm_page(bo, pidx);
+	if (unlikely(m == NULL)) {
+		retval = VM_PAGER_ERROR;
+		goto out_io_unlock;
 	}
 
 	VM_OBJECT_WLOCK(vm_obj);
@@ -242,9 +330,9 @@ reserve:
 		ttm_bo_unreserve(bo);
 		goto retry;
 	}
-	m1 = vm_page_lookup(vm_obj, OFF_TO_IDX(offset));
+	m1 = vm_page_lookup(vm_obj, pidx);
 	if (m1 == NULL) {
-		if (vm_page_insert(m, vm_obj, OFF_TO_IDX(offset))) {
+		if (vm_page_insert(m, vm_obj, pidx)) {
 			VM_OBJECT_WUNLOCK(vm_obj);
 			vm_wait(vm_obj);
 			VM_OBJECT_WLOCK(vm_obj);
@@ -254,18 +342,15 @@ reserve:
 		}
 	} else {
 		KASSERT(m == m1,
-		    ("inconsistent insert bo %p m %p m1 %p offset %jx",
-		    bo, m, m1, (uintmax_t)offset));
+		    ("inconsistent insert bo %p m %p m1 %p pidx %jx",
+		    bo, m, m1, (uintmax_t)pidx));
 	}
 	m->valid = VM_PAGE_BITS_ALL;
 	vm_page_xbusy(m);
-	if (*mres != NULL) {
-		KASSERT(*mres != m, ("losing %p %p", *mres, m));
-		vm_page_lock(*mres);
-		vm_page_free(*mres);
-		vm_page_unlock(*mres);
-	}
-	*mres = m;
+	*first = *last = pidx;
+	ttm_bo_vm_fault_around(vm_obj, bo, pidx, first, last);
+	atomic_add_long(&ttm_bo_vm_faults, 1);
+	atomic_add_long(&ttm_bo_vm_fault_pages, *last - *first + 1);
 
 out_io_unlock1:
 	ttm_mem_io_unlock(man);
@@ -314,7 +399,7 @@ ttm_bo_vm_dtor(void *handle)
 }
 
 static struct cdev_pager_ops ttm_pager_ops = {
-	.cdev_pg_fault = ttm_bo_vm_fault,
+	.cdev_pg_populate = ttm_bo_vm_populate,
 	.cdev_pg_ctor = ttm_bo_vm_ctor,
 	.cdev_pg_dtor = ttm_bo_vm_dtor
 };
@@ -44,6 +44,9 @@ __FBSDID("$FreeBSD$");
 #include <dev/drm2/drmP.h>
 #include <dev/drm2/ttm/ttm_bo_driver.h>
 #include <dev/drm2/ttm/ttm_page_alloc.h>
+#include <sys/counter.h>
+#include <sys/sched.h>
+#include <sys/smp.h>
 #include <vm/vm_pageout.h>
 
 #define NUM_PAGES_TO_ALLOC		(PAGE_SIZE/sizeof(vm_page_t))
@@ -51,6 +54,23 @@ __FBSDID("$FreeBSD$");
 #define FREE_ALL_PAGES			(~0U)
 /* times are in msecs */
 #define PAGE_FREE_INTERVAL		1000
+/* per-CPU cache capacity and the batch moved to/from the shared list */
+#define PCPU_CACHE_PAGES		64
+#define PCPU_CACHE_BATCH		16
+
+/**
+ * struct ttm_page_pool_pcpu - Per-CPU cache in front of a pool.
+ *
+ * Only accessed by its own CPU inside a critical section, or by a thread
+ * bound to that CPU when the caches are drained.
+ *
+ * @pages: Stack of cached pages, the most recently freed on top.
+ * @npages: Number of pages in the cache.
+ */
+struct ttm_page_pool_pcpu {
+	vm_page_t		pages[PCPU_CACHE_PAGES];
+	unsigned		npages;
+} __aligned(CACHE_LINE_SIZE);
 
 /**
  * struct ttm_page_pool - Pool to reuse recently allocated uc/wc pages.
@@ -62,6 +82,10 @@ __FBSDID("$FreeBSD$");
  * @list: Pool of free uc/wc pages for fast reuse.
  * @gfp_flags: Flags to pass for alloc_page.
  * @npages: Number of pages in pool.
+ * @pcpu: Per-CPU caches, indexed by cpuid.
+ * @pcpu_hits: Pages served from or returned to a per-CPU cache.
+ * @pcpu_refills: Batches moved from the shared list to a per-CPU cache.
+ * @pcpu_drains: Batches moved from a full per-CPU cache to the shared list.
  */
 struct ttm_page_pool {
 	struct mtx		lock;
@@ -73,6 +97,10 @@ struct ttm_page_pool {
 	char			*name;
 	unsigned long		nfrees;
 	unsigned long		nrefills;
+	struct ttm_page_pool_pcpu *pcpu;
+	counter_u64_t		pcpu_hits;
+	counter_u64_t		pcpu_refills;
+	counter_u64_t		pcpu_drains;
 };
 
 /**
@@ -106,6 +134,7 @@ struct ttm_pool_manager {
 	unsigned int kobj_ref;
 	eventhandler_tag lowmem_handler;
 	struct ttm_pool_opts	options;
+	struct sysctl_ctx_list	sysctl_ctx;
 
 	union {
 		struct ttm_page_pool	u_pools[NUM_POOLS];
@@ -441,6 +470,46 @@ static int ttm_pool_get_num_unused_pages(void)
 	return total;
 }
 
+/**
+ * Return the pages held in the per-CPU caches of all pools to the shared
+ * lists, so that they can be freed. A cache may only be touched from its
+ * own CPU, so bind to each CPU in turn, like UMA does.
+ */
+static void ttm_pool_pcpu_drain_all(void)
+{
+	vm_page_t pages[PCPU_CACHE_PAGES];
+	struct ttm_page_pool *pool;
+	struct ttm_page_pool_pcpu *pc;
+	unsigned i, j, n;
+	int cpu;
+
+	CPU_FOREACH(cpu) {
+		thread_lock(curthread);
+		sched_bind(curthread, cpu);
+		thread_unlock(curthread);
+		for (i = 0; i < NUM_POOLS; ++i) {
+			pool = &_manager->pools[i];
+			critical_enter();
+			pc = &pool->pcpu[curcpu];
+			n = pc->npages;
+			memcpy(pages, pc->pages, n * sizeof(vm_page_t));
+			pc->npages = 0;
+			critical_exit();
+			if (n == 0)
+				continue;
+			mtx_lock(&pool->lock);
+			for (j = 0; j < n; j++)
+				TAILQ_INSERT_TAIL(&pool->list, pages[j],
+				    plinks.q);
+			pool->npages += n;
+			mtx_unlock(&pool->lock);
+		}
+	}
+	thread_lock(curthread);
+	sched_unbind(curthread);
+	thread_unlock(curthread);
+}
+
 /**
  * Callback for mm to request pool to reduce number of page held.
  */
@@ -452,6 +521,7 @@ static int ttm_pool_mm_shrink(void *arg)
 	struct ttm_page_pool *pool;
 	int shrink_pages = 100; /* XXXKIB */
 
+	ttm_pool_pcpu_drain_all();
 	pool_offset = pool_offset % NUM_POOLS;
 	/* select start pool in round robin fashion */
 	for (i = 0; i < NUM_POOLS; ++i) {
@@ -686,12 +756,138 @@ out:
 	return count;
 }
 
+/**
+ * Number of pages each per-CPU cache may hold. Cached pages count against
+ * options.max_size: together the caches may use up to half of it, and
+ * ttm_put_pages() trims the shared list to what is left.
+ */
+static unsigned ttm_pool_pcpu_limit(unsigned max_size)
+{
+
+	return (min(PCPU_CACHE_PAGES, max_size / (2 * mp_ncpus)));
+}
+
+/**
+ * Take up to npages pages from the current CPU's cache.
+ *
+ * @return number of pages stored at the start of pages.
+ */
+static unsigned ttm_pool_pcpu_get(struct ttm_page_pool *pool,
+				  vm_page_t *pages, unsigned npages)
+{
+	struct ttm_page_pool_pcpu *pc;
+	unsigned i;
+
+	critical_enter();
+	pc = &pool->pcpu[curcpu];
+	for (i = 0; i < npages && pc->npages > 0; i++)
+		pages[i] = pc->pages[--pc->npages];
+	critical_exit();
+	if (i > 0)
+		counter_u64_add(pool->pcpu_hits, i);
+	return i;
+}
+
+/**
+ * Move a batch of pages from the shared list into the current CPU's
+ * cache, filling the shared list first if it is empty. The thread may
+ * migrate while the pool lock is held, so pages which do not fit into the
+ * cache of the CPU we end up on go back to the shared list.
+ */
+static void ttm_pool_pcpu_refill(struct ttm_page_pool *pool, int ttm_flags,
+				 enum ttm_caching_state cstate)
+{
+	vm_page_t pages[PCPU_CACHE_BATCH];
+	struct ttm_page_pool_pcpu *pc;
+	unsigned i, n, limit;
+
+	limit = ttm_pool_pcpu_limit(_manager->options.max_size);
+	if (limit == 0)
+		return;
+	mtx_lock(&pool->lock);
+	ttm_page_pool_fill_locked(pool, ttm_flags, cstate, 1);
+	for (n = 0; n < min(PCPU_CACHE_BATCH, limit) && pool->npages > 0;
+	    n++) {
+		pages[n] = TAILQ_FIRST(&pool->list);
+		TAILQ_REMOVE(&pool->list, pages[n], plinks.q);
+		pool->npages--;
+	}
+	mtx_unlock(&pool->lock);
+	if (n == 0)
+		return;
+
+	counter_u64_add(pool->pcpu_refills, 1);
+	critical_enter();
+	pc = &pool->pcpu[curcpu];
+	for (i = n; i > 0 && pc->npages < limit; i--)
+		pc->pages[pc->npages++] = pages[i - 1];
+	critical_exit();
+
+	if (i > 0) {
+		mtx_lock(&pool->lock);
+		while (i > 0) {
+			TAILQ_INSERT_HEAD(&pool->list, pages[--i], plinks.q);
+			pool->npages++;
+		}
+		mtx_unlock(&pool->lock);
+	}
+}
+
+/**
+ * Put pages into the current CPU's cache. When the cache is full its
+ * oldest PCPU_CACHE_BATCH pages are moved out to drain, and the caller
+ * hands them to the shared list. This is done at most once per call;
+ * *rest is set to the index of the first page that was not cached. A
+ * cache left above the limit by a lowered max_size shrinks by a batch per
+ * call.
+ *
+ * @return number of pages stored in drain.
+ */
+static unsigned ttm_pool_pcpu_put(struct ttm_page_pool *pool,
+				  vm_page_t *pages, unsigned npages,
+				  vm_page_t *drain, unsigned *rest)
+{
+	struct ttm_page_pool_pcpu *pc;
+	unsigned i, ndrain, nput, limit;
+
+	ndrain = nput = 0;
+	limit = ttm_pool_pcpu_limit(_manager->options.max_size);
+	critical_enter();
+	pc = &pool->pcpu[curcpu];
+	for (i = 0; i < npages; i++) {
+		if (pages[i] == NULL)
+			continue;
+		if (pc->npages >= limit) {
+			if (ndrain != 0 || pc->npages == 0)
+				break;
+			ndrain = min(PCPU_CACHE_BATCH, pc->npages);
+			memcpy(drain, pc->pages, ndrain * sizeof(vm_page_t));
+			pc->npages -= ndrain;
+			memmove(pc->pages, pc->pages + ndrain,
+			    pc->npages * sizeof(vm_page_t));
+		}
+		if (pc->npages >= limit)
+			break;
+		pc->pages[pc->npages++] = pages[i];
+		pages[i] = NULL;
+		nput++;
+	}
+	critical_exit();
+	*rest = i;
+	if (nput > 0)
+		counter_u64_add(pool->pcpu_hits, nput);
+	if (ndrain > 0)
+		counter_u64_add(pool->pcpu_drains, 1);
+	return ndrain;
+}
+
 /* Put all pages in pages list to correct pool to wait for reuse */
 static void ttm_put_pages(vm_page_t *pages, unsigned npages, int flags,
 			  enum ttm_caching_state cstate)
 {
 	struct ttm_page_pool *pool = ttm_get_pool(flags, cstate);
-	unsigned i;
+	vm_page_t drain[PCPU_CACHE_BATCH];
+	unsigned i, ndrain, rest, max_size;
 
 	if (pool == NULL) {
 		/* No pool for this memory type so free the pages */
@@ -704,18 +900,28 @@ static void ttm_put_pages(vm_page_t *pages, unsigned npages, int flags,
 		return;
 	}
 
+	ndrain = ttm_pool_pcpu_put(pool, pages, npages, drain, &rest);
+	if (ndrain == 0 && rest == npages)
+		return;
+
 	mtx_lock(&pool->lock);
-	for (i = 0; i < npages; i++) {
+	for (i = 0; i < ndrain; i++)
+		TAILQ_INSERT_TAIL(&pool->list, drain[i], plinks.q);
+	pool->npages += ndrain;
+	for (i = rest; i < npages; i++) {
 		if (pages[i]) {
 			TAILQ_INSERT_TAIL(&pool->list, pages[i], plinks.q);
 			pages[i] = NULL;
 			pool->npages++;
 		}
 	}
-	/* Check that we don't go over the pool limit */
+	/* Check that we don't go over the pool limit, leaving room for the
+	 * pages the per-CPU caches may hold */
 	npages = 0;
-	if (pool->npages > _manager->options.max_size) {
-		npages = pool->npages - _manager->options.max_size;
+	max_size = _manager->options.max_size;
+	max_size -= mp_ncpus * ttm_pool_pcpu_limit(max_size);
+	if (pool->npages > max_size) {
+		npages = pool->npages - max_size;
 		/* free at least NUM_PAGES_TO_ALLOC number of pages
 		 * to reduce calls to set_memory_wb */
 		if (npages < NUM_PAGES_TO_ALLOC)
@@ -756,10 +962,25 @@ static int ttm_get_pages(vm_page_t *pages, unsigned npages, int flags,
 	/* combine zero flag to pool flags */
 	gfp_flags = flags | pool->ttm_page_alloc_flags;
 
-	/* First we take pages from the pool */
+	/* First we take pages from this CPU's cache, refilling it in a
+	 * batch for small requests. */
+	count = ttm_pool_pcpu_get(pool, pages, npages);
+	if (count < npages && npages - count <= PCPU_CACHE_BATCH / 2) {
+		ttm_pool_pcpu_refill(pool, flags, cstate);
+		count += ttm_pool_pcpu_get(pool, pages + count,
+		    npages - count);
+	}
+	if (flags & TTM_PAGE_FLAG_ZERO_ALLOC) {
+		for (r = 0; r < count; ++r)
+			pmap_zero_page(pages[r]);
+	}
+	npages -= count;
+
+	/* Then from the shared pool */
 	TAILQ_INIT(&plist);
-	npages = ttm_page_pool_get_pages(pool, &plist, flags, cstate, npages);
-	count = 0;
+	if (npages > 0)
+		npages = ttm_page_pool_get_pages(pool, &plist, flags, cstate,
+		    npages);
 	TAILQ_FOREACH(p, &plist, plinks.q) {
 		pages[count++] = p;
 	}
@@ -795,18 +1016,63 @@ static int ttm_get_pages(vm_page_t *pages, unsigned npages, int flags,
 }
 
 static void ttm_page_pool_init_locked(struct ttm_page_pool *pool, int flags,
-				      char *name)
+				      char *name, const char *sysctl_name,
+				      struct sysctl_oid *parent)
 {
+	struct sysctl_ctx_list *ctx = &_manager->sysctl_ctx;
+	struct sysctl_oid *node;
+
 	mtx_init(&pool->lock, "ttmpool", NULL, MTX_DEF);
 	pool->fill_lock = false;
 	TAILQ_INIT(&pool->list);
 	pool->npages = pool->nfrees = 0;
 	pool->ttm_page_alloc_flags = flags;
 	pool->name = name;
+	pool->pcpu = malloc((mp_maxid + 1) * sizeof(*pool->pcpu),
+	    M_TTM_POOLMGR, M_WAITOK | M_ZERO);
+	pool->pcpu_hits = counter_u64_alloc(M_WAITOK);
+	pool->pcpu_refills = counter_u64_alloc(M_WAITOK);
+	pool->pcpu_drains = counter_u64_alloc(M_WAITOK);
+
+	if (parent == NULL)
+		return;
+	node = SYSCTL_ADD_NODE(ctx, SYSCTL_CHILDREN(parent), OID_AUTO,
+	    sysctl_name, CTLFLAG_RD, NULL, name);
+	if (node == NULL)
+		return;
+	SYSCTL_ADD_UINT(ctx, SYSCTL_CHILDREN(node), OID_AUTO, "npages",
+	    CTLFLAG_RD, &pool->npages, 0,
+	    "Pages in the shared pool");
+	SYSCTL_ADD_ULONG(ctx, SYSCTL_CHILDREN(node), OID_AUTO, "nrefills",
+	    CTLFLAG_RD, &pool->nrefills,
+	    "Shared pool refills from the VM");
+	SYSCTL_ADD_ULONG(ctx, SYSCTL_CHILDREN(node), OID_AUTO, "nfrees",
+	    CTLFLAG_RD, &pool->nfrees,
+	    "Pages freed from the shared pool");
+	SYSCTL_ADD_COUNTER_U64(ctx, SYSCTL_CHILDREN(node), OID_AUTO,
+	    "pcpu_hits", CTLFLAG_RD, &pool->pcpu_hits,
+	    "Pages allocated from or freed to a per-CPU cache");
+	SYSCTL_ADD_COUNTER_U64(ctx, SYSCTL_CHILDREN(node), OID_AUTO,
+	    "pcpu_refills", CTLFLAG_RD, &pool->pcpu_refills,
+	    "Batches moved from the shared pool to a per-CPU cache");
+	SYSCTL_ADD_COUNTER_U64(ctx, SYSCTL_CHILDREN(node), OID_AUTO,
+	    "pcpu_drains", CTLFLAG_RD, &pool->pcpu_drains,
+	    "Batches moved from a full per-CPU cache to the shared pool");
+}
+
+static void ttm_page_pool_fini(struct ttm_page_pool *pool)
+{
+
+	counter_u64_free(pool->pcpu_hits);
+	counter_u64_free(pool->pcpu_refills);
+	counter_u64_free(pool->pcpu_drains);
+	free(pool->pcpu, M_TTM_POOLMGR);
+	mtx_destroy(&pool->lock);
 }
 
 int ttm_page_alloc_init(struct ttm_mem_global *glob, unsigned max_pages)
 {
+	struct sysctl_oid *top;
 
 	if (_manager != NULL)
 		printf("[TTM] manager != NULL\n");
@@ -814,12 +1080,17 @@ int ttm_page_alloc_init(struct ttm_mem_global *glob, unsigned max_pages)
 
 	_manager = malloc(sizeof(*_manager), M_TTM_POOLMGR, M_WAITOK | M_ZERO);
 
-	ttm_page_pool_init_locked(&_manager->wc_pool, 0, "wc");
-	ttm_page_pool_init_locked(&_manager->uc_pool, 0, "uc");
+	sysctl_ctx_init(&_manager->sysctl_ctx);
+	top = SYSCTL_ADD_NODE(&_manager->sysctl_ctx,
+	    SYSCTL_STATIC_CHILDREN(_hw_drm), OID_AUTO, "ttm_pool", CTLFLAG_RD,
+	    NULL, "TTM page pool allocator");
+
+	ttm_page_pool_init_locked(&_manager->wc_pool, 0, "wc", "wc", top);
+	ttm_page_pool_init_locked(&_manager->uc_pool, 0, "uc", "uc", top);
 	ttm_page_pool_init_locked(&_manager->wc_pool_dma32,
-	    TTM_PAGE_FLAG_DMA32, "wc dma");
+	    TTM_PAGE_FLAG_DMA32, "wc dma", "wc_dma32", top);
 	ttm_page_pool_init_locked(&_manager->uc_pool_dma32,
-	    TTM_PAGE_FLAG_DMA32, "uc dma");
+	    TTM_PAGE_FLAG_DMA32, "uc dma", "uc_dma32", top);
 
 	_manager->options.max_size = max_pages;
 	_manager->options.small = SMALL_ALLOCATION;
@@ -837,9 +1108,13 @@ void ttm_page_alloc_fini(void)
 
 	printf("[TTM] Finalizing pool allocator\n");
 	ttm_pool_mm_shrink_fini(_manager);
+	sysctl_ctx_free(&_manager->sysctl_ctx);
 
-	for (i = 0; i < NUM_POOLS; ++i)
+	ttm_pool_pcpu_drain_all();
+	for (i = 0; i < NUM_POOLS; ++i) {
 		ttm_page_pool_free(&_manager->pools[i], FREE_ALL_PAGES);
+		ttm_page_pool_fini(&_manager->pools[i]);
+	}
 
 	if (refcount_release(&_manager->kobj_ref))
 		ttm_pool_kobj_release(_manager);